@@ -0,0 +1,245 @@
+/*
+ * Counts the AL and ALC calls alure makes for common operations, using the
+ * mock OpenAL library (built with ALURE_USE_MOCK_AL). Unlike timings, the
+ * counts are deterministic, so changes that add or remove calls on hot paths
+ * show up directly when comparing runs.
+ *
+ * Results are printed as a table, or as JSON with -json. With -verbose, the
+ * table also lists the calls made to each function. Each operation has a
+ * budget of calls, and the program fails if any operation goes over its
+ * budget, so it can be run as a test to catch regressions. When a change
+ * intentionally reduces the calls made, the budget should be lowered with it.
+ */
+
+#include <algorithm>
+#include <iostream>
+#include <iomanip>
+#include <functional>
+#include <string>
+#include <chrono>
+#include <thread>
+#include <vector>
+#include <cmath>
+#include <map>
+
+#include "alure2.h"
+#include "mockal.h"
+
+namespace {
+
+constexpr ALCuint LoopbackRate = 48000;
+
+// A decoder generating a second of a mono sine tone, to play without needing
+// a file.
+class ToneDecoder final : public alure::Decoder {
+    static constexpr ALuint sFrequency = 44100;
+    uint64_t mPos{0};
+
+public:
+    ALuint getFrequency() const noexcept override { return sFrequency; }
+    alure::ChannelConfig getChannelConfig() const noexcept override
+    { return alure::ChannelConfig::Mono; }
+    alure::SampleType getSampleType() const noexcept override
+    { return alure::SampleType::Int16; }
+
+    uint64_t getLength() const noexcept override { return sFrequency; }
+    bool seek(uint64_t pos) noexcept override
+    {
+        if(pos > getLength()) return false;
+        mPos = pos;
+        return true;
+    }
+
+    std::pair<uint64_t,uint64_t> getLoopPoints() const noexcept override
+    { return {0, 0}; }
+
+    ALuint read(ALvoid *ptr, ALuint count) noexcept override
+    {
+        count = static_cast<ALuint>(std::min<uint64_t>(count, getLength()-mPos));
+        int16_t *samples = static_cast<int16_t*>(ptr);
+        for(ALuint i = 0;i < count;++i)
+            samples[i] = static_cast<int16_t>(
+                std::sin((mPos+i) * 440.0 * 6.283185307179586 / sFrequency) * 8192.0
+            );
+        mPos += count;
+        return count;
+    }
+};
+
+
+struct Result {
+    std::string mName;
+    size_t mBudget;
+    size_t mTotal;
+    std::map<std::string,size_t> mCounts;
+};
+
+std::vector<Result> gResults;
+
+// Records the calls made by the given operation, which shouldn't make more
+// than budget calls. Setup done beforehand isn't counted.
+void Measure(const std::string &name, size_t budget, const std::function<void()> &func)
+{
+    mockal::ResetCalls();
+    func();
+    gResults.push_back(Result{name, budget, mockal::GetCallCount(), mockal::GetCallCounts()});
+}
+
+// Gives the background streaming thread time to act on a context update.
+void WaitForStreaming()
+{ std::this_thread::sleep_for(std::chrono::milliseconds(100)); }
+
+
+void RunOperations(alure::Device &dev, alure::Context &ctx)
+{
+    alure::Buffer buffer = ctx.createBufferFrom("alure-bench-tone",
+                                                alure::MakeShared<ToneDecoder>());
+    std::vector<float> rendered(LoopbackRate * 2);
+
+    alure::Source source;
+    Measure("createSource", 1, [&]{ source = ctx.createSource(); });
+    Measure("play buffer", 32, [&]{ source.play(buffer); });
+    Measure("setPosition", 1, [&]{ source.setPosition(alure::Vector3(1.0f, 0.0f, -1.0f)); });
+    Measure("setGain", 1, [&]{ source.setGain(0.5f); });
+    Measure("isPlaying", 1, [&]{ source.isPlaying(); });
+    Measure("getSampleOffset", 1, [&]{ source.getSampleOffset(); });
+    Measure("stop", 3, [&]{ source.stop(); });
+    Measure("destroy", 0, [&]{ source.destroy(); });
+
+    alure::SourceGroup group = ctx.createSourceGroup();
+    std::vector<alure::Source> sources(16);
+    for(alure::Source &src : sources)
+    {
+        src = ctx.createSource();
+        src.setGroup(group);
+        src.play(buffer);
+    }
+    Measure("group setGain, 16 sources", 34, [&]{ group.setGain(0.5f); });
+    Measure("group pauseAll, 16 sources", 17, [&]{ group.pauseAll(); });
+    Measure("group resumeAll, 16 sources", 1, [&]{ group.resumeAll(); });
+    for(alure::Source &src : sources)
+        src.destroy();
+    group.destroy();
+
+    sources.resize(100);
+    for(alure::Source &src : sources)
+    {
+        src = ctx.createSource();
+        src.setLooping(true);
+        src.play(buffer);
+    }
+    ctx.update();
+    Measure("update, 100 idle sources", 101, [&]{ ctx.update(); });
+    for(alure::Source &src : sources)
+        src.destroy();
+    sources.clear();
+
+    // Render enough for the stream to finish one of its buffers, so the update
+    // has it refilled.
+    source = ctx.createSource();
+    source.play(alure::MakeShared<ToneDecoder>(), 4096, 4);
+    ctx.update();
+    WaitForStreaming();
+    dev.render(rendered.data(), 5000);
+    Measure("update, stream refill", 8, [&]{ ctx.update(); WaitForStreaming(); });
+    source.destroy();
+
+    ctx.removeBuffer(buffer);
+}
+
+
+void PrintJson()
+{
+    std::cout<< "[\n";
+    for(size_t i = 0;i < gResults.size();++i)
+    {
+        const Result &res = gResults[i];
+        std::cout<< "  {\"operation\": \""<<res.mName<<"\", \"calls\": "<<res.mTotal
+                 << ", \"budget\": "<<res.mBudget<< ", \"functions\": {";
+        size_t j = 0;
+        for(const auto &count : res.mCounts)
+            std::cout<< (j++ ? ", " : "") << "\""<<count.first<<"\": "<<count.second;
+        std::cout<< "}}" << ((i+1 < gResults.size()) ? ",\n" : "\n");
+    }
+    std::cout<< "]" <<std::endl;
+}
+
+void PrintTable(bool verbose)
+{
+    std::cout<< std::left<<std::setw(32)<<"Operation" <<std::right<<std::setw(8)<<"Calls"
+             << std::setw(8)<<"Budget" << std::endl;
+    for(const Result &res : gResults)
+    {
+        std::cout<< std::left<<std::setw(32)<<res.mName <<std::right<<std::setw(8)<<res.mTotal
+                 << std::setw(8)<<res.mBudget << std::endl;
+        if(!verbose) continue;
+        for(const auto &count : res.mCounts)
+            std::cout<< "    "<<std::left<<std::setw(28)<<count.first
+                     << std::right<<std::setw(8)<<count.second <<std::endl;
+    }
+}
+
+// Reports the operations that made more calls than their budget, returning
+// false if there were any.
+bool CheckBudgets()
+{
+    bool ok = true;
+    for(const Result &res : gResults)
+    {
+        if(res.mTotal <= res.mBudget)
+            continue;
+        std::cerr<< "Over budget: "<<res.mName<<" made "<<res.mTotal<<" calls, budget "
+                 << res.mBudget<<" (+"<<(res.mTotal-res.mBudget)<<")" <<std::endl;
+        for(const auto &count : res.mCounts)
+            std::cerr<< "    "<<count.first<<": "<<count.second <<std::endl;
+        ok = false;
+    }
+    return ok;
+}
+
+} // namespace
+
+int main(int argc, char *argv[])
+{
+    alure::ArrayView<const char*> args(argv, argc);
+    args = args.slice(1);
+
+    bool json = false;
+    bool verbose = false;
+    while(!args.empty())
+    {
+        if(args[0] == alure::StringView("-json"))
+        {
+            json = true;
+            args = args.slice(1);
+        }
+        else if(args[0] == alure::StringView("-verbose"))
+        {
+            verbose = true;
+            args = args.slice(1);
+        }
+        else
+        {
+            std::cerr<< "Usage: "<<argv[0]<<" [-json] [-verbose]" <<std::endl;
+            return 1;
+        }
+    }
+
+    alure::DeviceManager devMgr = alure::DeviceManager::getInstance();
+    alure::Device dev = devMgr.openLoopback(alure::ChannelConfig::Stereo,
+                                            alure::SampleType::Float32, LoopbackRate);
+    alure::Context ctx = dev.createContext();
+    alure::Context::MakeCurrent(ctx);
+
+    RunOperations(dev, ctx);
+
+    alure::Context::MakeCurrent(nullptr);
+    ctx.destroy();
+    dev.close();
+
+    if(json)
+        PrintJson();
+    else
+        PrintTable(verbose);
+    return CheckBudgets() ? 0 : 1;
+}
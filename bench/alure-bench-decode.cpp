@@ -0,0 +1,409 @@
+/*
+ * A benchmark for the built-in decoders. Each decoder is given a generated
+ * wave file along with any files named on the command line that it accepts,
+ * and is timed opening the file, reading it through with various chunk sizes,
+ * and seeking. Heap allocations made through operator new are counted too.
+ *
+ * Results are printed as a table, or as JSON with -json for comparing runs.
+ * The decoders are compiled in from the static library, and a loopback device
+ * is opened since they check the current context's supported formats.
+ */
+
+#include "config.h"
+
+#include <algorithm>
+#include <iostream>
+#include <iomanip>
+#include <fstream>
+#include <sstream>
+#include <cstdlib>
+#include <cstring>
+#include <cstdio>
+#include <cmath>
+#include <string>
+#include <chrono>
+#include <random>
+#include <atomic>
+#include <vector>
+#include <new>
+
+#include "alure2.h"
+
+#ifdef HAVE_WAVE
+#include "decoders/wave.hpp"
+#endif
+#ifdef HAVE_VORBISFILE
+#include "decoders/vorbisfile.hpp"
+#endif
+#ifdef HAVE_FLAC
+#include "decoders/flac.hpp"
+#endif
+#ifdef HAVE_OPUSFILE
+#include "decoders/opusfile.hpp"
+#endif
+#ifdef HAVE_LIBSNDFILE
+#include "decoders/sndfile.hpp"
+#endif
+#ifdef HAVE_MINIMP3
+#include "decoders/mp3.hpp"
+#endif
+
+namespace {
+
+std::atomic<size_t> gAllocations{0};
+
+} // namespace
+
+// Count every allocation made through the global operator new. Allocations
+// made by the decoder libraries with malloc aren't seen.
+void *operator new(size_t size)
+{
+    gAllocations.fetch_add(1, std::memory_order_relaxed);
+    if(void *ptr = std::malloc(size ? size : 1))
+        return ptr;
+    throw std::bad_alloc();
+}
+void operator delete(void *ptr) noexcept { std::free(ptr); }
+void operator delete(void *ptr, size_t) noexcept { std::free(ptr); }
+
+namespace {
+
+using clock_type = std::chrono::steady_clock;
+
+constexpr unsigned ChunkSizes[]{64, 1024, 16384};
+constexpr unsigned MaxChunkSize = 16384;
+constexpr size_t NumSeeks = 64;
+
+size_t gIterations = 5;
+
+struct Corpus {
+    std::string mName;
+    std::string mData;
+};
+
+struct Result {
+    std::string mDecoder;
+    std::string mFile;
+    std::string mTest;
+    double mTime{0.0};
+    double mRate{0.0};
+    const char *mRateUnit{""};
+    double mAllocations{0.0};
+};
+
+std::vector<Result> gResults;
+
+
+using FactoryPair = std::pair<const char*,alure::UniquePtr<alure::DecoderFactory>>;
+std::vector<FactoryPair> GetFactories()
+{
+    std::vector<FactoryPair> factories;
+#ifdef HAVE_WAVE
+    factories.emplace_back("wave", alure::MakeUnique<alure::WaveDecoderFactory>());
+#endif
+#ifdef HAVE_VORBISFILE
+    factories.emplace_back("vorbisfile", alure::MakeUnique<alure::VorbisFileDecoderFactory>());
+#endif
+#ifdef HAVE_FLAC
+    factories.emplace_back("flac", alure::MakeUnique<alure::FlacDecoderFactory>());
+#endif
+#ifdef HAVE_OPUSFILE
+    factories.emplace_back("opusfile", alure::MakeUnique<alure::OpusFileDecoderFactory>());
+#endif
+#ifdef HAVE_LIBSNDFILE
+    factories.emplace_back("sndfile", alure::MakeUnique<alure::SndFileDecoderFactory>());
+#endif
+#ifdef HAVE_MINIMP3
+    factories.emplace_back("minimp3", alure::MakeUnique<alure::Mp3DecoderFactory>());
+#endif
+    return factories;
+}
+
+
+void put_le16(std::string &out, uint16_t val)
+{
+    out += static_cast<char>(val&0xff);
+    out += static_cast<char>((val>>8)&0xff);
+}
+void put_le32(std::string &out, uint32_t val)
+{
+    put_le16(out, static_cast<uint16_t>(val&0xffff));
+    put_le16(out, static_cast<uint16_t>((val>>16)&0xffff));
+}
+
+// Generates 30 seconds of a 16-bit stereo 44.1khz wave file, so there's
+// always something to decode.
+Corpus GenerateWave()
+{
+    constexpr uint32_t srate = 44100;
+    constexpr uint32_t frames = srate * 30;
+    constexpr uint32_t datasize = frames * 4;
+
+    std::string data;
+    data.reserve(44 + datasize);
+    data += "RIFF";
+    put_le32(data, 36 + datasize);
+    data += "WAVEfmt ";
+    put_le32(data, 16);
+    put_le16(data, 1);
+    put_le16(data, 2);
+    put_le32(data, srate);
+    put_le32(data, srate * 4);
+    put_le16(data, 4);
+    put_le16(data, 16);
+    data += "data";
+    put_le32(data, datasize);
+
+    std::mt19937 rng(12345);
+    std::uniform_int_distribution<int> noise(-1024, 1024);
+    for(uint32_t i = 0;i < frames;++i)
+    {
+        double s = std::sin(i * 440.0 * 6.283185307179586 / srate) * 16384.0;
+        put_le16(data, static_cast<uint16_t>(static_cast<int16_t>(s + noise(rng))));
+        put_le16(data, static_cast<uint16_t>(static_cast<int16_t>(s - noise(rng))));
+    }
+    return Corpus{"generated.wav", std::move(data)};
+}
+
+bool LoadFile(const char *name, Corpus &corpus)
+{
+    std::ifstream file(name, std::ios::binary);
+    if(!file.is_open()) return false;
+    std::ostringstream ss;
+    ss << file.rdbuf();
+    corpus.mName = name;
+    corpus.mData = ss.str();
+    return true;
+}
+
+alure::SharedPtr<alure::Decoder> OpenDecoder(alure::DecoderFactory &factory,
+                                             const Corpus &corpus)
+{
+    alure::UniquePtr<std::istream> file = alure::MakeUnique<std::istringstream>(corpus.mData);
+    return factory.createDecoder(file);
+}
+
+
+void AddResult(const char *decoder, const Corpus &corpus, std::string test,
+               clock_type::duration elapsed, double count, const char *unit, size_t allocs)
+{
+    std::chrono::duration<double> secs = elapsed;
+    Result result;
+    result.mDecoder = decoder;
+    result.mFile = corpus.mName;
+    result.mTest = std::move(test);
+    result.mTime = secs.count() / gIterations;
+    result.mRate = (secs.count() > 0.0) ? count*gIterations / secs.count() : 0.0;
+    result.mRateUnit = unit;
+    result.mAllocations = static_cast<double>(allocs) / gIterations;
+    gResults.push_back(std::move(result));
+}
+
+void BenchDecoder(const char *name, alure::DecoderFactory &factory, const Corpus &corpus)
+{
+    auto decoder = OpenDecoder(factory, corpus);
+    if(!decoder) return;
+
+    const uint64_t length = decoder->getLength();
+    const ALuint framesize = alure::FramesToBytes(1, decoder->getChannelConfig(),
+                                                  decoder->getSampleType());
+    std::vector<char> buffer(framesize * MaxChunkSize);
+
+    {
+        // The corpus copy into the stream is counted, but it's the same for
+        // every decoder.
+        size_t allocs = gAllocations.load();
+        auto start = clock_type::now();
+        for(size_t i = 0;i < gIterations;++i)
+            decoder = OpenDecoder(factory, corpus);
+        AddResult(name, corpus, "open", clock_type::now()-start, 1.0, "opens/s",
+                  gAllocations.load()-allocs);
+    }
+    {
+        auto start = clock_type::now();
+        uint64_t total = 0;
+        for(size_t i = 0;i < gIterations;++i)
+            total += decoder->getLength();
+        AddResult(name, corpus, "getLength", clock_type::now()-start, 1.0, "calls/s", 0);
+        if(total != length*gIterations)
+            std::cerr<< name<<": inconsistent length for "<<corpus.mName <<std::endl;
+    }
+
+    for(unsigned chunk : ChunkSizes)
+    {
+        uint64_t frames = 0;
+        size_t allocs = gAllocations.load();
+        auto start = clock_type::now();
+        for(size_t i = 0;i < gIterations;++i)
+        {
+            decoder->seek(0);
+            while(ALuint got = decoder->read(buffer.data(), chunk))
+                frames += got;
+        }
+        auto elapsed = clock_type::now() - start;
+        AddResult(name, corpus, "read " + std::to_string(chunk), elapsed,
+                  static_cast<double>(frames) / gIterations, "frames/s",
+                  gAllocations.load()-allocs);
+    }
+
+    if(length > 0)
+    {
+        // Random seeks, each followed by a short read as a stream would do.
+        std::mt19937_64 rng(54321);
+        std::uniform_int_distribution<uint64_t> dist(0, length-1);
+        std::vector<uint64_t> positions(NumSeeks);
+        for(uint64_t &pos : positions)
+            pos = dist(rng);
+
+        size_t failed = 0;
+        size_t allocs = gAllocations.load();
+        auto start = clock_type::now();
+        for(size_t i = 0;i < gIterations;++i)
+        {
+            for(uint64_t pos : positions)
+            {
+                if(!decoder->seek(pos)) ++failed;
+                decoder->read(buffer.data(), ChunkSizes[0]);
+            }
+        }
+        auto elapsed = clock_type::now() - start;
+        AddResult(name, corpus, "seek random", elapsed, static_cast<double>(NumSeeks),
+                  "seeks/s", gAllocations.load()-allocs);
+        if(failed > 0)
+            std::cerr<< name<<": "<<failed<<" seeks failed for "<<corpus.mName <<std::endl;
+
+        // Seeking back to the start, as when looping.
+        allocs = gAllocations.load();
+        start = clock_type::now();
+        for(size_t i = 0;i < gIterations;++i)
+        {
+            for(size_t j = 0;j < NumSeeks;++j)
+            {
+                decoder->seek(0);
+                decoder->read(buffer.data(), ChunkSizes[0]);
+            }
+        }
+        elapsed = clock_type::now() - start;
+        AddResult(name, corpus, "seek start", elapsed, static_cast<double>(NumSeeks),
+                  "seeks/s", gAllocations.load()-allocs);
+    }
+}
+
+
+std::string JsonEscape(const std::string &str)
+{
+    std::string out;
+    for(char ch : str)
+    {
+        if(ch == '"' || ch == '\\')
+        {
+            out += '\\';
+            out += ch;
+        }
+        else if(static_cast<unsigned char>(ch) < 0x20)
+        {
+            char buf[8];
+            snprintf(buf, sizeof(buf), "\\u%04x", ch);
+            out += buf;
+        }
+        else
+            out += ch;
+    }
+    return out;
+}
+
+void PrintJson()
+{
+    std::cout<< "[\n";
+    for(size_t i = 0;i < gResults.size();++i)
+    {
+        const Result &res = gResults[i];
+        std::cout<< "  {\"decoder\": \""<<JsonEscape(res.mDecoder)<<"\", "
+                 << "\"file\": \""<<JsonEscape(res.mFile)<<"\", "
+                 << "\"test\": \""<<JsonEscape(res.mTest)<<"\", "
+                 << "\"seconds\": "<<std::scientific<<std::setprecision(6)<<res.mTime<<", "
+                 << "\"rate\": "<<res.mRate<<", "
+                 << "\"unit\": \""<<res.mRateUnit<<"\", "
+                 << "\"allocations\": "<<std::fixed<<std::setprecision(1)<<res.mAllocations
+                 << "}" << ((i+1 < gResults.size()) ? ",\n" : "\n");
+    }
+    std::cout<< "]" <<std::endl;
+}
+
+void PrintTable()
+{
+    std::cout<< std::left<<std::setw(12)<<"Decoder" <<std::setw(24)<<"File"
+             << std::setw(14)<<"Test" <<std::right<<std::setw(16)<<"Rate"
+             << std::setw(12)<<"Allocs" <<std::endl;
+    for(const Result &res : gResults)
+    {
+        std::string file = res.mFile;
+        if(file.length() > 23)
+            file = "..." + file.substr(file.length()-20);
+        std::cout<< std::left<<std::setw(12)<<res.mDecoder <<std::setw(24)<<file
+                 << std::setw(14)<<res.mTest <<std::right<<std::fixed<<std::setprecision(0)
+                 << std::setw(16)<<res.mRate<<" "<<std::left<<std::setw(10)<<res.mRateUnit
+                 << std::right<<std::setprecision(1)<<std::setw(8)<<res.mAllocations
+                 << std::endl;
+    }
+}
+
+} // namespace
+
+int main(int argc, char *argv[])
+{
+    bool json = false;
+    std::vector<Corpus> corpora;
+    corpora.push_back(GenerateWave());
+
+    for(int i = 1;i < argc;++i)
+    {
+        if(std::strcmp(argv[i], "-json") == 0)
+            json = true;
+        else if(std::strcmp(argv[i], "-iterations") == 0 && i+1 < argc)
+            gIterations = std::max(1l, std::strtol(argv[++i], nullptr, 0));
+        else
+        {
+            Corpus corpus;
+            if(!LoadFile(argv[i], corpus))
+            {
+                std::cerr<< "Failed to load "<<argv[i] <<std::endl;
+                return 1;
+            }
+            corpora.push_back(std::move(corpus));
+        }
+    }
+
+    // The decoders check the current context for the sample types it
+    // supports. A loopback device avoids needing audio hardware.
+    alure::DeviceManager devMgr = alure::DeviceManager::getInstance();
+    alure::Device dev = devMgr.openLoopback(alure::ChannelConfig::Stereo,
+                                            alure::SampleType::Float32, 48000);
+    alure::Context ctx = dev.createContext();
+    alure::Context::MakeCurrent(ctx);
+
+    std::vector<FactoryPair> factories = GetFactories();
+    for(const Corpus &corpus : corpora)
+    {
+        bool decoded = false;
+        for(FactoryPair &factory : factories)
+        {
+            size_t count = gResults.size();
+            BenchDecoder(factory.first, *factory.second, corpus);
+            decoded |= (gResults.size() > count);
+        }
+        if(!decoded)
+            std::cerr<< "No decoder accepted "<<corpus.mName <<std::endl;
+    }
+
+    factories.clear();
+    alure::Context::MakeCurrent(nullptr);
+    ctx.destroy();
+    dev.close();
+
+    if(json)
+        PrintJson();
+    else
+        PrintTable();
+    return 0;
+}
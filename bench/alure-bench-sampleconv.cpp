@@ -0,0 +1,217 @@
+/*
+ * A micro-benchmark for the internal sample conversion kernels, comparing
+ * each optimized kernel against its scalar reference and checking that they
+ * produce the same output.
+ */
+
+#include <algorithm>
+#include <iostream>
+#include <iomanip>
+#include <cstdlib>
+#include <string>
+#include <chrono>
+#include <random>
+#include <vector>
+
+#include "sampleconv.h"
+
+namespace {
+
+using clock_type = std::chrono::steady_clock;
+
+constexpr size_t NumSamples = 65536;
+constexpr size_t NumChannels = 6;
+
+size_t gIterations = 2000;
+bool gFailed = false;
+
+template<typename F>
+double time_it(F&& func)
+{
+    // Run once to warm up the caches.
+    func();
+    auto start = clock_type::now();
+    for(size_t i = 0;i < gIterations;++i)
+        func();
+    std::chrono::duration<double,std::micro> elapsed = clock_type::now() - start;
+    return elapsed.count() / gIterations;
+}
+
+template<typename T>
+void report(const char *name, double scalar, double optimized, const std::vector<T> &ref,
+            const std::vector<T> &test)
+{
+    bool match = (ref == test);
+    if(!match) gFailed = true;
+    std::cout<< std::left<<std::setw(18)<<name<<std::right<<std::fixed<<std::setprecision(2)
+             << std::setw(10)<<scalar<<"us" <<std::setw(10)<<optimized<<"us"
+             << std::setw(8)<<(scalar/optimized)<<"x"
+             << (match ? "" : "  MISMATCH") <<std::endl;
+}
+
+} // namespace
+
+int main(int argc, char *argv[])
+{
+    if(argc > 1)
+        gIterations = std::max(1l, std::strtol(argv[1], nullptr, 0));
+
+    std::mt19937 rng(12345);
+    std::uniform_real_distribution<float> fdist(-1.25f, 1.25f);
+    std::uniform_int_distribution<int> idist(-32768, 32767);
+
+    std::vector<float> fsamples(NumSamples);
+    std::vector<int16_t> ssamples(NumSamples);
+    std::vector<uint8_t> bsamples(NumSamples);
+    for(size_t i = 0;i < NumSamples;++i)
+    {
+        fsamples[i] = fdist(rng);
+        ssamples[i] = static_cast<int16_t>(idist(rng));
+        bsamples[i] = static_cast<uint8_t>(idist(rng)&0xff);
+    }
+
+    std::cout<< "Samples: "<<NumSamples<<", iterations: "<<gIterations <<"\n"<<std::endl;
+    std::cout<< std::left<<std::setw(18)<<"Kernel"<<std::right
+             << std::setw(12)<<"Scalar" <<std::setw(12)<<"Optimized" <<std::setw(9)<<"Speedup"
+             <<std::endl;
+
+    {
+        std::vector<int16_t> ref(NumSamples), test(NumSamples);
+        double s = time_it([&]{ alure::Scalar::ConvertF32ToS16(ref.data(), fsamples.data(), NumSamples); });
+        double o = time_it([&]{ alure::ConvertF32ToS16(test.data(), fsamples.data(), NumSamples); });
+        report("f32 -> s16", s, o, ref, test);
+    }
+    {
+        std::vector<float> ref(NumSamples), test(NumSamples);
+        double s = time_it([&]{ alure::Scalar::ConvertS16ToF32(ref.data(), ssamples.data(), NumSamples); });
+        double o = time_it([&]{ alure::ConvertS16ToF32(test.data(), ssamples.data(), NumSamples); });
+        report("s16 -> f32", s, o, ref, test);
+    }
+    {
+        std::vector<int16_t> ref(NumSamples), test(NumSamples);
+        double s = time_it([&]{ alure::Scalar::ConvertU8ToS16(ref.data(), bsamples.data(), NumSamples); });
+        double o = time_it([&]{ alure::ConvertU8ToS16(test.data(), bsamples.data(), NumSamples); });
+        report("u8 -> s16", s, o, ref, test);
+    }
+    {
+        std::vector<int16_t> ref(NumSamples), test(NumSamples);
+        double s = time_it([&]{ alure::Scalar::DecodeMulaw(ref.data(), bsamples.data(), NumSamples); });
+        double o = time_it([&]{ alure::DecodeMulaw(test.data(), bsamples.data(), NumSamples); });
+        report("mulaw decode", s, o, ref, test);
+    }
+    {
+        std::vector<uint8_t> ref(NumSamples), test(NumSamples);
+        double s = time_it([&]{ alure::Scalar::EncodeMulaw(ref.data(), ssamples.data(), NumSamples); });
+        double o = time_it([&]{ alure::EncodeMulaw(test.data(), ssamples.data(), NumSamples); });
+        report("mulaw encode", s, o, ref, test);
+    }
+
+    const size_t frames = NumSamples / NumChannels;
+    std::vector<std::vector<float>> planar(NumChannels, std::vector<float>(frames));
+    const float *srcptrs[NumChannels];
+    for(size_t c = 0;c < NumChannels;++c)
+    {
+        std::copy_n(fsamples.begin() + c*frames, frames, planar[c].begin());
+        srcptrs[c] = planar[c].data();
+    }
+    for(size_t chans : {size_t{1}, size_t{2}, NumChannels})
+    {
+        std::vector<float> ref(frames*chans), test(frames*chans);
+        double s = time_it([&]{ alure::Scalar::InterleaveF32(ref.data(), srcptrs, chans, frames); });
+        double o = time_it([&]{ alure::InterleaveF32(test.data(), srcptrs, chans, frames); });
+        std::string name = "interleave x" + std::to_string(chans);
+        report(name.c_str(), s, o, ref, test);
+    }
+    {
+        std::vector<std::vector<float>> ref(NumChannels, std::vector<float>(frames));
+        std::vector<std::vector<float>> test(NumChannels, std::vector<float>(frames));
+        float *refptrs[NumChannels], *testptrs[NumChannels];
+        for(size_t c = 0;c < NumChannels;++c)
+        {
+            refptrs[c] = ref[c].data();
+            testptrs[c] = test[c].data();
+        }
+        double s = time_it([&]{ alure::Scalar::DeinterleaveF32(refptrs, fsamples.data(), NumChannels, frames); });
+        double o = time_it([&]{ alure::DeinterleaveF32(testptrs, fsamples.data(), NumChannels, frames); });
+        std::vector<float> refflat, testflat;
+        for(size_t c = 0;c < NumChannels;++c)
+        {
+            refflat.insert(refflat.end(), ref[c].begin(), ref[c].end());
+            testflat.insert(testflat.end(), test[c].begin(), test[c].end());
+        }
+        report("deinterleave", s, o, refflat, testflat);
+    }
+    {
+        // Apply the gain to a fresh copy each time so repeated iterations
+        // don't drift into silence or clipping.
+        std::vector<float> ref(fsamples), test(fsamples);
+        double s = time_it([&]{
+            std::copy(fsamples.begin(), fsamples.end(), ref.begin());
+            alure::Scalar::ApplyGainF32(ref.data(), NumSamples, 0.7f);
+        });
+        double o = time_it([&]{
+            std::copy(fsamples.begin(), fsamples.end(), test.begin());
+            alure::ApplyGainF32(test.data(), NumSamples, 0.7f);
+        });
+        report("gain f32", s, o, ref, test);
+    }
+    {
+        std::vector<int16_t> ref(ssamples), test(ssamples);
+        double s = time_it([&]{
+            std::copy(ssamples.begin(), ssamples.end(), ref.begin());
+            alure::Scalar::ApplyGainS16(ref.data(), NumSamples, 1.5f);
+        });
+        double o = time_it([&]{
+            std::copy(ssamples.begin(), ssamples.end(), test.begin());
+            alure::ApplyGainS16(test.data(), NumSamples, 1.5f);
+        });
+        report("gain s16", s, o, ref, test);
+    }
+    {
+        std::vector<float> ref(NumSamples/2), test(NumSamples/2);
+        double s = time_it([&]{
+            std::fill(ref.begin(), ref.end(), 0.0f);
+            alure::Scalar::MixF32(ref.data(), fsamples.data(), NumSamples/2, 0.5f);
+            alure::Scalar::MixF32(ref.data(), fsamples.data()+NumSamples/2, NumSamples/2, 0.5f);
+        });
+        double o = time_it([&]{
+            std::fill(test.begin(), test.end(), 0.0f);
+            alure::MixF32(test.data(), fsamples.data(), NumSamples/2, 0.5f);
+            alure::MixF32(test.data(), fsamples.data()+NumSamples/2, NumSamples/2, 0.5f);
+        });
+        report("mix f32", s, o, ref, test);
+    }
+    {
+        // Trial encode 64-frame blocks of mono noise, and of a slow ramp that
+        // the predictors can follow.
+        constexpr size_t BlockFrames = 64;
+        const size_t numblocks = NumSamples / BlockFrames;
+        std::vector<int16_t> ramp(NumSamples);
+        for(size_t i = 0;i < NumSamples;++i)
+            ramp[i] = static_cast<int16_t>(static_cast<int>(i*7 % 65536) - 32768);
+        const int32_t deltas[7]{16, 64, 256, 1024, 4096, 16384, 65536};
+
+        for(const std::vector<int16_t> *input : {&ssamples, &ramp})
+        {
+            std::vector<uint32_t> ref(numblocks*7), test(numblocks*7);
+            double s = time_it([&]{
+                for(size_t b = 0;b < numblocks;++b)
+                    alure::Scalar::MSADPCMTrialErrors(&ref[b*7], &(*input)[b*BlockFrames], 1,
+                                                      BlockFrames, deltas);
+            });
+            double o = time_it([&]{
+                for(size_t b = 0;b < numblocks;++b)
+                    alure::MSADPCMTrialErrors(&test[b*7], &(*input)[b*BlockFrames], 1,
+                                              BlockFrames, deltas);
+            });
+            report((input == &ramp) ? "msadpcm ramp" : "msadpcm noise", s, o, ref, test);
+        }
+    }
+
+    if(gFailed)
+    {
+        std::cerr<< "\nOptimized kernels do not match the scalar reference!" <<std::endl;
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,367 @@
+/*
+ * A stress benchmark for scenes with many sources. For each scene size, a set
+ * of sources is played from a shared buffer and every frame some are moved,
+ * faded out, stopped, or destroyed and recreated, while a source group's gain
+ * changes. The time taken by Context::update and by each whole frame is
+ * reported as percentiles.
+ *
+ * Results are printed as a table, or as JSON with -json for comparing runs.
+ * With -loopback, a loopback device renders a 60th of a second after each
+ * frame, running without audio hardware and as fast as possible. Otherwise,
+ * use -device to pick a playback device.
+ *
+ * When built against the mock OpenAL library (ALURE_USE_MOCK_AL), the number
+ * of AL calls made by each Context::update is also reported. The times then
+ * include the mock's call recording, so only the call counts are meaningful.
+ */
+
+#include <algorithm>
+#include <iostream>
+#include <iomanip>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <chrono>
+#include <random>
+#include <vector>
+#include <cmath>
+
+#include "alure2.h"
+#ifdef ALURE_USE_MOCK_AL
+#include "mockal.h"
+#endif
+
+namespace {
+
+using clock_type = std::chrono::steady_clock;
+using microseconds = std::chrono::duration<double,std::micro>;
+
+constexpr size_t NumGroups = 8;
+
+size_t gNumFrames = 300;
+
+// The loopback rendering format, and the amount rendered per frame.
+constexpr ALCuint LoopbackRate = 48000;
+constexpr ALCsizei LoopbackFrameSamples = LoopbackRate / 60;
+
+
+// A decoder generating a second of a mono sine tone, to play without needing
+// a file.
+class ToneDecoder final : public alure::Decoder {
+    static constexpr ALuint sFrequency = 44100;
+    uint64_t mPos{0};
+
+public:
+    ALuint getFrequency() const noexcept override { return sFrequency; }
+    alure::ChannelConfig getChannelConfig() const noexcept override
+    { return alure::ChannelConfig::Mono; }
+    alure::SampleType getSampleType() const noexcept override
+    { return alure::SampleType::Int16; }
+
+    uint64_t getLength() const noexcept override { return sFrequency; }
+    bool seek(uint64_t pos) noexcept override
+    {
+        if(pos > getLength()) return false;
+        mPos = pos;
+        return true;
+    }
+
+    std::pair<uint64_t,uint64_t> getLoopPoints() const noexcept override
+    { return {0, 0}; }
+
+    ALuint read(ALvoid *ptr, ALuint count) noexcept override
+    {
+        count = static_cast<ALuint>(std::min<uint64_t>(count, getLength()-mPos));
+        int16_t *samples = static_cast<int16_t*>(ptr);
+        for(ALuint i = 0;i < count;++i)
+            samples[i] = static_cast<int16_t>(
+                std::sin((mPos+i) * 440.0 * 6.283185307179586 / sFrequency) * 8192.0
+            );
+        mPos += count;
+        return count;
+    }
+};
+
+class CountingHandler final : public alure::MessageHandler {
+public:
+    size_t mForceStopped{0};
+
+    void sourceForceStopped(alure::Source) noexcept override { ++mForceStopped; }
+};
+
+
+struct Percentiles {
+    double mP50, mP90, mP99, mMax;
+};
+
+Percentiles GetPercentiles(std::vector<double> times)
+{
+    std::sort(times.begin(), times.end());
+    auto at = [&times](double p) -> double
+    { return times[std::min(times.size()-1, static_cast<size_t>(p * times.size()))]; };
+    return Percentiles{at(0.5), at(0.9), at(0.99), times.back()};
+}
+
+struct Result {
+    size_t mNumSources;
+    Percentiles mUpdate;
+    Percentiles mFrame;
+    Percentiles mUpdateCalls;
+    size_t mPlays;
+    size_t mPlayFailures;
+    size_t mForceStopped;
+};
+
+
+Result RunScene(alure::Device &dev, size_t numsources)
+{
+    alure::AttributePair attrs[]{
+        {ALC_MONO_SOURCES, static_cast<ALCint>(numsources)}, alure::AttributesEnd()
+    };
+    alure::Context ctx = dev.createContext(attrs);
+    alure::Context::MakeCurrent(ctx);
+    CountingHandler *handler = new CountingHandler;
+    ctx.setMessageHandler(alure::SharedPtr<alure::MessageHandler>(handler));
+
+    alure::Buffer buffer = ctx.createBufferFrom("alure-bench-tone",
+                                                alure::MakeShared<ToneDecoder>());
+
+    std::mt19937 rng(12345);
+    std::uniform_real_distribution<float> posdist(-50.0f, 50.0f);
+    std::uniform_int_distribution<ALuint> priodist(0, 3);
+
+    std::vector<alure::SourceGroup> groups(NumGroups);
+    for(alure::SourceGroup &group : groups)
+        group = ctx.createSourceGroup();
+
+    Result result{numsources, {}, {}, {}, 0, 0, 0};
+    auto play = [&](alure::Source source)
+    {
+        try {
+            source.play(buffer);
+            ++result.mPlays;
+        }
+        catch(std::exception&) {
+            ++result.mPlayFailures;
+        }
+    };
+
+    std::vector<alure::Source> sources(numsources);
+    for(size_t i = 0;i < numsources;++i)
+    {
+        sources[i] = ctx.createSource();
+        sources[i].setGroup(groups[i%NumGroups]);
+        sources[i].setPriority(priodist(rng));
+        sources[i].setLooping(true);
+        sources[i].setPosition(alure::Vector3(posdist(rng), posdist(rng), posdist(rng)));
+        play(sources[i]);
+    }
+
+    // Per frame, a quarter of the sources move, 1% fade out, 0.5% stop, and
+    // 0.5% are destroyed and recreated. Stopped sources are restarted.
+    const size_t nummove = std::max<size_t>(numsources/4, 1);
+    const size_t numfade = std::max<size_t>(numsources/100, 1);
+    const size_t numchurn = std::max<size_t>(numsources/200, 1);
+    std::uniform_int_distribution<size_t> srcdist(0, numsources-1);
+
+    std::vector<float> rendered;
+    if(dev.isLoopback())
+        rendered.resize(LoopbackFrameSamples * 2);
+
+    std::vector<double> updatetimes, frametimes, updatecalls;
+    updatetimes.reserve(gNumFrames);
+    frametimes.reserve(gNumFrames);
+    updatecalls.reserve(gNumFrames);
+    for(size_t frame = 0;frame < gNumFrames;++frame)
+    {
+        auto framestart = clock_type::now();
+
+        for(size_t i = 0;i < nummove;++i)
+        {
+            alure::Source &source = sources[srcdist(rng)];
+            source.setPosition(alure::Vector3(posdist(rng), posdist(rng), posdist(rng)));
+        }
+        for(size_t i = 0;i < numfade;++i)
+            sources[srcdist(rng)].fadeOutToStop(0.0f, std::chrono::milliseconds(100));
+        for(size_t i = 0;i < numchurn;++i)
+            sources[srcdist(rng)].stop();
+        for(size_t i = 0;i < numchurn;++i)
+        {
+            alure::Source &source = sources[srcdist(rng)];
+            alure::SourceGroup group = source.getGroup();
+            source.destroy();
+            source = ctx.createSource();
+            source.setGroup(group);
+            source.setPriority(priodist(rng));
+            source.setLooping(true);
+            source.setPosition(alure::Vector3(posdist(rng), posdist(rng), posdist(rng)));
+        }
+        groups[frame%NumGroups].setGain(((frame/NumGroups)&1) ? 1.0f : 0.5f);
+        for(alure::Source &source : sources)
+        {
+            if(!source.isPlaying() && !source.isPending())
+                play(source);
+        }
+
+#ifdef ALURE_USE_MOCK_AL
+        mockal::ResetCalls();
+#endif
+        auto updatestart = clock_type::now();
+        ctx.update();
+        auto frameend = clock_type::now();
+#ifdef ALURE_USE_MOCK_AL
+        updatecalls.push_back(static_cast<double>(mockal::GetCallCount()));
+#endif
+
+        if(dev.isLoopback())
+            dev.render(rendered.data(), LoopbackFrameSamples);
+
+        updatetimes.push_back(microseconds(frameend - updatestart).count());
+        frametimes.push_back(microseconds(frameend - framestart).count());
+    }
+    result.mUpdate = GetPercentiles(std::move(updatetimes));
+    result.mFrame = GetPercentiles(std::move(frametimes));
+    if(!updatecalls.empty())
+        result.mUpdateCalls = GetPercentiles(std::move(updatecalls));
+    result.mForceStopped = handler->mForceStopped;
+
+    for(alure::Source &source : sources)
+        source.destroy();
+    for(alure::SourceGroup &group : groups)
+        group.destroy();
+    ctx.removeBuffer(buffer);
+    alure::Context::MakeCurrent(nullptr);
+    ctx.destroy();
+
+    return result;
+}
+
+
+void PrintJson(const std::vector<Result> &results)
+{
+    auto print_pct = [](const char *name, const Percentiles &pct)
+    {
+        std::cout<< "\""<<name<<"\": {\"p50\": "<<pct.mP50<<", \"p90\": "<<pct.mP90
+                 << ", \"p99\": "<<pct.mP99<<", \"max\": "<<pct.mMax<<"}";
+    };
+
+    std::cout<< std::fixed<<std::setprecision(3) << "[\n";
+    for(size_t i = 0;i < results.size();++i)
+    {
+        const Result &res = results[i];
+        std::cout<< "  {\"sources\": "<<res.mNumSources<<", \"frames\": "<<gNumFrames<<", ";
+        print_pct("update_us", res.mUpdate);
+        std::cout<< ", ";
+        print_pct("frame_us", res.mFrame);
+#ifdef ALURE_USE_MOCK_AL
+        std::cout<< ", ";
+        print_pct("update_al_calls", res.mUpdateCalls);
+#endif
+        std::cout<< ", \"plays\": "<<res.mPlays<<", \"play_failures\": "<<res.mPlayFailures
+                 << ", \"force_stopped\": "<<res.mForceStopped<<"}"
+                 << ((i+1 < results.size()) ? ",\n" : "\n");
+    }
+    std::cout<< "]" <<std::endl;
+}
+
+void PrintTable(const std::vector<Result> &results)
+{
+    std::cout<< std::setw(8)<<"Sources" <<std::setw(30)<<"update p50/p90/p99/max (us)"
+             << std::setw(30)<<"frame p50/p90/p99/max (us)"
+#ifdef ALURE_USE_MOCK_AL
+             << std::setw(20)<<"AL calls p50/p99"
+#endif
+             << std::setw(9)<<"Plays" <<std::setw(9)<<"Failed" <<std::setw(9)<<"Stolen"
+             << std::endl;
+    for(const Result &res : results)
+    {
+        auto format_pct = [](const Percentiles &pct) -> std::string
+        {
+            char str[64];
+            snprintf(str, sizeof(str), "%.0f/%.0f/%.0f/%.0f", pct.mP50, pct.mP90, pct.mP99,
+                     pct.mMax);
+            return str;
+        };
+        std::cout<< std::setw(8)<<res.mNumSources <<std::setw(30)<<format_pct(res.mUpdate)
+                 << std::setw(30)<<format_pct(res.mFrame)
+#ifdef ALURE_USE_MOCK_AL
+                 << std::setw(20)<<(std::to_string(static_cast<size_t>(res.mUpdateCalls.mP50))+"/"+
+                                    std::to_string(static_cast<size_t>(res.mUpdateCalls.mP99)))
+#endif
+                 << std::setw(9)<<res.mPlays <<std::setw(9)<<res.mPlayFailures
+                 << std::setw(9)<<res.mForceStopped <<std::endl;
+    }
+}
+
+} // namespace
+
+int main(int argc, char *argv[])
+{
+    alure::ArrayView<const char*> args(argv, argc);
+    args = args.slice(1);
+
+    bool json = false;
+    const char *devname = nullptr;
+    bool loopback = false;
+    std::vector<size_t> sizes;
+    while(!args.empty())
+    {
+        if(args[0] == alure::StringView("-json"))
+        {
+            json = true;
+            args = args.slice(1);
+        }
+        else if(args[0] == alure::StringView("-loopback"))
+        {
+            loopback = true;
+            args = args.slice(1);
+        }
+        else if(args.size() > 1 && args[0] == alure::StringView("-device"))
+        {
+            devname = args[1];
+            args = args.slice(2);
+        }
+        else if(args.size() > 1 && args[0] == alure::StringView("-frames"))
+        {
+            gNumFrames = std::max(1l, std::strtol(args[1], nullptr, 0));
+            args = args.slice(2);
+        }
+        else if(args.size() > 1 && args[0] == alure::StringView("-sources"))
+        {
+            sizes.push_back(std::max(1l, std::strtol(args[1], nullptr, 0)));
+            args = args.slice(2);
+        }
+        else
+        {
+            std::cerr<< "Usage: "<<argv[0]<<" [-json] [-loopback | -device \"device name\"] "
+                        "[-frames count] [-sources count]..." <<std::endl;
+            return 1;
+        }
+    }
+    if(sizes.empty())
+        sizes = {100, 1000, 10000};
+
+    alure::DeviceManager devMgr = alure::DeviceManager::getInstance();
+    alure::Device dev;
+    if(loopback)
+        dev = devMgr.openLoopback(alure::ChannelConfig::Stereo, alure::SampleType::Float32,
+                                  LoopbackRate);
+    else if(devname)
+    {
+        dev = devMgr.openPlayback(devname, std::nothrow);
+        if(!dev) std::cerr<< "Failed to open \""<<devname<<"\" - trying default" <<std::endl;
+    }
+    if(!dev) dev = devMgr.openPlayback();
+    std::cerr<< "Opened \""<<dev.getName()<<"\"" <<std::endl;
+
+    std::vector<Result> results;
+    for(size_t numsources : sizes)
+        results.push_back(RunScene(dev, numsources));
+    dev.close();
+
+    if(json)
+        PrintJson(results);
+    else
+        PrintTable(results);
+    return 0;
+}
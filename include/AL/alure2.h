@@ -453,6 +453,16 @@ public:
 
     /** Opens the default playback device. Returns an empty Device on error. */
     Device openPlayback(const std::nothrow_t&) noexcept;
+
+    /**
+     * Opens a loopback device, which renders audio into buffers given to
+     * Device::render rather than playing it, as fast as it's asked for. The
+     * device's contexts use the given output format. Only mono, stereo, quad,
+     * 5.1, 6.1, and 7.1 channel configurations with 8-bit, 16-bit, or float
+     * samples are allowed. Throws an exception if the ALC_SOFT_loopback
+     * extension is unavailable or the format is unsupported.
+     */
+    Device openLoopback(ChannelConfig chans, SampleType type, ALCuint frequency);
 };
 
 
@@ -584,6 +594,16 @@ public:
      */
     void resumeDSP();
 
+    /** Returns true if this is a loopback device. */
+    bool isLoopback() const;
+
+    /**
+     * Renders the given number of sample frames into buffer, in the format the
+     * loopback device was opened with. The device must be a loopback device
+     * with a context.
+     */
+    void render(ALvoid *buffer, ALCsizei frames);
+
     /**
      * Retrieves the current clock time for the device. This starts relative to
      * the device being opened, and does not increment while there are no
@@ -592,6 +612,8 @@ public:
      * sources play at. In the future it may utilize an OpenAL extension to
      * retrieve the audio device's real clock which may tic at a subtly
      * different rate than the main clock(s).
+     *
+     * For loopback devices, this is the amount of audio rendered.
      */
     std::chrono::nanoseconds getClockTime();
 
@@ -613,6 +635,81 @@ enum class DistanceModel {
     None = AL_NONE,
 };
 
+/**
+ * Storage formats for the sample data of buffers loaded by a context. Formats
+ * the device doesn't support fall back to Native.
+ */
+enum class BufferStorage {
+    /** Stores samples as the decoder provides them. */
+    Native,
+    /** Encodes samples to 8-bit mu-law. Requires AL_EXT_MULAW. */
+    Mulaw,
+    /**
+     * Encodes samples to 4-bit MS-ADPCM. Requires AL_SOFT_MSADPCM, and only
+     * applies to mono and stereo buffers.
+     */
+    MSADPCM
+};
+
+/**
+ * Policies for the sample type decoders provide, and buffers are stored with.
+ */
+enum class SampleTypePolicy {
+    /** Decoders pick the sample type best suited for the data. */
+    Native,
+    /**
+     * Decoders provide 16-bit samples where they can, and buffers loaded from
+     * decoders that can only provide float samples are converted to 16-bit.
+     */
+    PreferInt16,
+    /** Decoders provide float samples where they can, if supported. */
+    PreferFloat32
+};
+
+/**
+ * A snapshot of a context's runtime statistics, from Context::getStatistics.
+ * Counts of events are totals since the context was created.
+ */
+struct ContextStatistics {
+    /**
+     * The number of buckets in the decode time histograms. Bucket i counts
+     * decodes that took less than 2^i microseconds (and at least 2^(i-1)),
+     * except the last, which counts all longer ones.
+     */
+    static constexpr size_t NumDecodeTimeBuckets = 20;
+
+    /** OpenAL sources in use by playing or paused sources. */
+    ALuint mSourcesUsed{0};
+    /** OpenAL sources allocated and waiting to be reused. */
+    ALuint mSourcesFree{0};
+    /** Sources currently streaming. */
+    ALuint mStreamsActive{0};
+    /** Buffers waiting to be loaded by the background thread. */
+    ALuint mPendingBuffers{0};
+
+    /** Times a stream ran out of queued audio before it was refilled. */
+    uint64_t mStreamUnderruns{0};
+    /**
+     * Estimated sample frames lost to stream underruns, at each stream's
+     * sample rate.
+     */
+    uint64_t mStreamFramesLost{0};
+    /**
+     * Times a playing source was stopped to give its OpenAL source to one with
+     * a higher priority.
+     */
+    uint64_t mForceStops{0};
+    /** Bytes of samples read from decoders, for buffers and streams. */
+    uint64_t mBytesDecoded{0};
+    /** Bytes of sample data in the context's buffers, as stored by OpenAL. */
+    uint64_t mBufferMemory{0};
+
+    /** Times taken to decode buffers as they're loaded. */
+    Array<uint64_t,NumDecodeTimeBuckets> mBufferDecodeTimes{};
+    /** Times taken to decode each chunk of a stream. */
+    Array<uint64_t,NumDecodeTimeBuckets> mStreamDecodeTimes{};
+};
+
 class ALURE_API Context {
     MAKE_PIMPL(Context, ContextImpl)
 
@@ -681,7 +778,9 @@ public:
 
     /**
      * Queries if the channel configuration and sample type are supported by
-     * the context.
+     * the context. Buffers and streams in an unsupported format are converted
+     * to the closest supported one when loaded, e.g. 32-bit float to 16-bit,
+     * or 5.1 downmixed to quad or stereo.
      */
     bool isSupported(ChannelConfig channels, SampleType type) const;
 
@@ -793,6 +892,128 @@ public:
      */
     void removeBuffer(Buffer buffer);
 
+    /**
+     * Decodes and keeps the first duration of audio from the named file, so
+     * that Source::play(StringView,ALsizei,ALsizei) can start playing it
+     * immediately, while the background thread opens the decoder and skips
+     * past the cached audio. Any existing preroll for the name is replaced.
+     */
+    void precacheStreamPreroll(StringView name, std::chrono::milliseconds duration);
+
+    /**
+     * Like precacheStreamPreroll, but the cached audio is kept in an OpenAL
+     * buffer. Playing the file with Source::play(StringView,ALsizei,ALsizei)
+     * queues that buffer first and streams the rest of the file after it,
+     * which is useful for long one-shot sounds that need to start instantly
+     * without being fully resident. The head is freed with
+     * removeStreamPreroll.
+     */
+    void precacheStreamHead(StringView name, std::chrono::milliseconds duration);
+
+    /** Frees the stream preroll cached for the given name, if any. */
+    void removeStreamPreroll(StringView name);
+
+    /**
+     * Reads the named file into memory as-is, without decoding it. Decoders
+     * subsequently created for the name (including through getBuffer and
+     * Source::play(StringView,ALsizei,ALsizei)) read from the in-memory copy
+     * instead of opening the file again.
+     *
+     * This keeps rarely played sounds in their compressed form. Playing one
+     * with Source::play(StringView,ALsizei,ALsizei) decodes it as it plays,
+     * into stream buffers the context reuses between plays, regardless of the
+     * streaming threshold. Loading it with getBuffer still decodes the whole
+     * sound into a resident buffer, as usual.
+     */
+    void precacheFileData(StringView name);
+
+    /**
+     * Frees the in-memory copy of the named file. Decoders already using it
+     * keep it alive until they're destroyed.
+     */
+    void removeFileData(StringView name);
+
+    /**
+     * Specifies a directory to cache decoded audio in, so buffers loaded in
+     * later runs can skip decoding. Entries are keyed by the file's name,
+     * size and modification time, a hash of its first and last 64KB, and the
+     * format it's loaded as, and are memory-mapped when loaded. Files that
+     * aren't on the filesystem, such as ones opened by a FileIOFactory from
+     * an archive, have all of their data hashed instead. The directory must
+     * already exist, and is never cleaned up by Alure. This applies to
+     * buffers created after this call. The default is empty, which disables
+     * the cache.
+     */
+    void setDecodeCacheDirectory(StringView path);
+    String getDecodeCacheDirectory() const;
+
+    /**
+     * Enables sharing OpenAL buffers between cached buffers loaded with
+     * identical sample data, format, frequency, and loop points, such as
+     * localized copies of a sound under different names. Each name still
+     * gets its own Buffer through getBuffer and findBuffer, but the memory is
+     * only used once. Shared buffers can't have their loop points changed.
+     * Data is matched by a 64-bit hash along with its size and format, without
+     * comparing the samples themselves, so a hash collision would have one
+     * sound play in place of another; this is extremely unlikely, but
+     * deduplication should be left off where it's unacceptable.
+     * This applies to buffers loaded synchronously after this call. The
+     * default is false.
+     */
+    void setBufferDeduplication(bool enable);
+    bool getBufferDeduplication() const;
+
+    /**
+     * Specifies if the named file is downmixed to mono when loaded into a
+     * buffer (including through createBufferFrom with the name) or streamed
+     * with Source::play(StringView,ALsizei,ALsizei). Multichannel audio is
+     * not spatialized by OpenAL, so this is intended for sounds played by 3D
+     * sources, and also halves the memory and mixing cost of stereo sounds.
+     * Buffers already cached are not affected, and stream prerolls keep the
+     * setting as of when they were cached.
+     */
+    void setDownmixToMono(StringView name, bool enable);
+    bool getDownmixToMono(StringView name) const;
+
+    /**
+     * Specifies how the sample data of buffers loaded after this call is
+     * stored. Encoding to Mulaw or MSADPCM is lossy, but reduces buffer memory
+     * by 2x or more for 16-bit data. A buffer's reported sample type remains
+     * that of the decoder. The default is BufferStorage::Native.
+     */
+    void setBufferStorage(BufferStorage storage);
+    BufferStorage getBufferStorage() const;
+
+    /**
+     * Specifies the sample type policy for decoders and buffers created after
+     * this call. Custom decoders should check it when choosing between float
+     * and integer output. The default is SampleTypePolicy::Native.
+     */
+    void setSampleTypePolicy(SampleTypePolicy policy);
+    SampleTypePolicy getSampleTypePolicy() const;
+
+    /**
+     * Specifies the largest decoded size, in bytes, of a file played with
+     * Source::play(StringView,ALsizei,ALsizei) to be loaded into a cached
+     * buffer (as with getBuffer). Larger files, and files of unknown length,
+     * are streamed instead. The default is 0, meaning such files are always
+     * streamed unless already cached.
+     */
+    void setStreamingThreshold(uint64_t size);
+    uint64_t getStreamingThreshold() const;
+
+    /**
+     * Enables resampling decoded audio to the device's frequency as buffers
+     * are loaded and streams are decoded, so OpenAL can mix it without
+     * resampling. This applies to buffers and streams created after this call,
+     * except streams started from a resident head (see precacheStreamHead),
+     * which play at the file's frequency. Resampled buffers report the
+     * device's frequency, and their lengths and offsets are in frames at that
+     * frequency. The default is false.
+     */
+    void setLoadResampling(bool enable);
+    bool getLoadResampling() const;
+
     /**
      * Creates a new Source for playing audio. There is no practical limit to
      * the number of sources you may create. You must call Source::destroy when
@@ -832,6 +1053,13 @@ public:
 
     /** Updates the context and all sources belonging to this context. */
     void update();
+
+    /**
+     * Retrieves a snapshot of the context's runtime statistics. Counters the
+     * background thread updates aren't synchronized with each other, so they
+     * may be off by an update from the others.
+     */
+    ContextStatistics getStatistics() const;
 };
 
 class ALURE_API Listener {
@@ -963,6 +1191,19 @@ public:
      *        protection against underruns.
      */
     void play(SharedPtr<Decoder> decoder, ALsizei chunk_len, ALsizei queue_size);
+    /**
+     * Plays the named file, picking between a buffer and a stream. If a
+     * buffer with the name is already cached, it's played. Otherwise if a
+     * preroll for the name was cached with Context::precacheStreamPreroll,
+     * playback starts from the cached audio right away and the decoder is
+     * opened by the background thread, without asking the MessageHandler for
+     * a substitute if the file can't be opened. Otherwise the file is loaded
+     * into a cached buffer if its decoded size is within
+     * Context::getStreamingThreshold, or streamed as with
+     * play(context.createDecoder(name), chunk_len, queue_size). Files kept
+     * with Context::precacheFileData are always streamed.
+     */
+    void play(StringView name, ALsizei chunk_len, ALsizei queue_size);
 
     /**
      * Prepares to play a source using a future buffer. The method will return
@@ -1052,6 +1293,12 @@ public:
      * Sets the source's offset, in sample frames. If the source is playing or
      * paused, it will go to that offset immediately, otherwise the source will
      * start at the specified offset the next time it's played.
+     *
+     * For streaming sources, the seek is carried out asynchronously by the
+     * background thread. The currently queued audio continues playing until
+     * data at the new offset is ready, and the offset queries report the
+     * requested offset in the mean time. If the decoder fails to seek, the
+     * source continues from its current position.
      */
     void setOffset(uint64_t offset);
     /**
@@ -1081,6 +1328,17 @@ public:
     void setLooping(bool looping);
     bool getLooping() const;
 
+    /**
+     * Specifies the number of sample frames, starting at the loop start, to
+     * keep decoded in memory for streaming sources. When a looping stream
+     * wraps around, it plays from this cache instead of seeking the decoder,
+     * and if the whole loop fits in the cache the decoder isn't touched again
+     * after the first pass. The default, 0, disables the cache. Takes effect
+     * the next time the source is played with a decoder.
+     */
+    void setLoopCacheLength(ALsizei length);
+    ALsizei getLoopCacheLength() const;
+
     /**
      * Specifies a linear pitch shift base. A value of 1.0 is the default
      * normal speed.
@@ -1477,7 +1735,9 @@ public:
     /**
      * Creates and returns a Decoder instance for the given resource file. If
      * the decoder needs to retain the file handle for reading as-needed, it
-     * should move the UniquePtr to internal storage.
+     * should move the UniquePtr to internal storage. This may be called from
+     * the background thread, though never concurrently with itself or with a
+     * FileIOFactory.
      *
      * \return nullptr if a decoder can't be created from the file.
      */
@@ -1534,11 +1794,118 @@ public:
 
     virtual ~FileIOFactory();
 
-    /** Opens a read-only binary file for the given name. */
+    /**
+     * Opens a read-only binary file for the given name. This may be called
+     * from the background thread, though never concurrently with itself or
+     * with a DecoderFactory.
+     */
     virtual UniquePtr<std::istream> openFile(const String &name) noexcept = 0;
 };
 
 
+/**
+ * A memory allocator interface. Applications may derive from this and set an
+ * instance to be used for the library's audio data, including samples being
+ * decoded, converted, resampled and encoded for buffers, stream chunks,
+ * stream prerolls, files kept with Context::precacheFileData, and pending
+ * buffer loads. By default, the library uses the global operator new.
+ */
+class ALURE_API MemoryAllocator {
+public:
+    /**
+     * Sets the allocator instance to be used for audio data. If a previous
+     * allocator was set, it's returned to the application. Passing in a
+     * nullptr reverts to the default.
+     *
+     * Memory is given back to whichever allocator is current when it's freed,
+     * so this should be set before any device is opened, and not changed
+     * while any are open.
+     */
+    static UniquePtr<MemoryAllocator> set(UniquePtr<MemoryAllocator> allocator) noexcept;
+
+    /** Gets the current MemoryAllocator instance. */
+    static MemoryAllocator &get() noexcept;
+
+    virtual ~MemoryAllocator();
+
+    /**
+     * Allocates size bytes, aligned to at least alignment, which is a power of
+     * two. It's no greater than alignof(std::max_align_t), except for large
+     * blocks used to decode buffers, which ask for 2MB so the system can back
+     * them with huge pages. Called from the background thread as well as
+     * application threads. Returns nullptr on failure.
+     */
+    virtual void *allocate(size_t size, size_t alignment) noexcept = 0;
+
+    /**
+     * Frees memory from allocate, given the same size and alignment it was
+     * allocated with.
+     */
+    virtual void deallocate(void *ptr, size_t size, size_t alignment) noexcept = 0;
+};
+
+
+/** How an entry's audio is stored in a pack file. */
+enum class PackCodec {
+    /** The original file data, handled by the decoders when opened. */
+    Encoded,
+    /** Decoded sample frames, which are read without further decoding. */
+    PCM
+};
+
+/**
+ * An entry to write into a pack file. For PCM entries, mData holds the sample
+ * frames in the given format. For Encoded entries, mData holds the file data
+ * and the format is ignored.
+ */
+struct PackFileEntry {
+    String mName;
+    PackCodec mCodec{PackCodec::Encoded};
+    Vector<ALbyte> mData;
+
+    ChannelConfig mChannels{ChannelConfig::Mono};
+    SampleType mSampleType{SampleType::Int16};
+    ALuint mFrequency{0};
+    std::pair<uint64_t,uint64_t> mLoopPoints{0, 0};
+};
+
+/**
+ * Writes the given entries into a single pack file, indexed by name. Pack
+ * files are written in the host's byte order and can only be read on hosts
+ * with the same byte order. Throws an exception if the file can't be written,
+ * or if a name is used more than once.
+ */
+ALURE_API void WritePackFile(StringView filename, ArrayView<PackFileEntry> entries);
+
+/**
+ * Creates a FileIOFactory that opens files from the given pack file, which is
+ * memory-mapped for as long as the factory or any file opened from it exists.
+ * Names are looked up in the pack's hash index, and names not in the pack are
+ * opened with the fallback factory if one is given. PCM entries are read by
+ * a built-in decoder. Throws an exception if the pack file can't be opened or
+ * is invalid.
+ */
+ALURE_API UniquePtr<FileIOFactory> CreatePackFileIOFactory(StringView filename,
+    UniquePtr<FileIOFactory> fallback=nullptr);
+
+
+/**
+ * Starts tracing Alure's activity on all threads, including context updates,
+ * background thread iterations, stream refills, buffer loads, file opens, and
+ * decoder reads and seeks. Spans are kept in memory until StopTrace writes
+ * them to the given file as Chrome trace event JSON, which can be viewed with
+ * chrome://tracing or Perfetto. Any trace already running is discarded.
+ * Throws an exception if the file can't be created.
+ */
+ALURE_API void StartTrace(StringView filename);
+
+/**
+ * Stops tracing and writes the trace file. Does nothing if no trace is
+ * running. Throws an exception if the file can't be written.
+ */
+ALURE_API void StopTrace();
+
+
 /**
  * A message handler interface. Applications may derive from this and set an
  * instance on a context to receive messages. The base methods are no-ops, so
@@ -1583,15 +1950,37 @@ public:
      */
     virtual void sourceForceStopped(Source source) noexcept;
 
+    /**
+     * Called when the given streaming source ran out of queued audio before
+     * the background thread could refill it, causing an audible gap. The
+     * source is restarted automatically.
+     *
+     * Underruns are detected in the background, and reported upon a call to
+     * Context::update. Multiple underruns between updates are reported
+     * together.
+     *
+     * \param source The source that underran.
+     * \param frames_lost The estimated number of sample frames, at the
+     *        stream's sample rate, that should have played during the gap.
+     */
+    virtual void sourceUnderrun(Source source, uint64_t frames_lost) noexcept;
+
     /**
      * Called when a new buffer is about to be created and loaded. May be
      * called asynchronously for buffers being loaded asynchronously.
      *
+     * Large sounds that are stored as decoded may be decoded and uploaded in
+     * pieces, with AL_SOFT_buffer_sub_data, rather than all at once. This is
+     * then called once for each piece, in order, given only that piece's
+     * samples. A handler that needs the whole sound at once has to collect
+     * the pieces itself.
+     *
      * \param name The resource name, as passed to Context::getBuffer.
      * \param channels Channel configuration of the given audio data.
      * \param type Sample type of the given audio data.
      * \param samplerate Sample rate of the given audio data.
-     * \param data The audio data that is about to be fed to the OpenAL buffer.
+     * \param data The audio data that is about to be fed to the OpenAL buffer,
+     *        or the next piece of it.
      */
     virtual void bufferLoading(StringView name, ChannelConfig channels, SampleType type, ALuint samplerate, ArrayView<ALbyte> data) noexcept;
 
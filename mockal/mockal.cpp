@@ -0,0 +1,1801 @@
+#include "mockal.h"
+
+#include <algorithm>
+#include <sstream>
+#include <cstring>
+#include <cctype>
+#include <mutex>
+#include <map>
+#include <set>
+
+#ifndef AL_ALEXT_PROTOTYPES
+#define AL_ALEXT_PROTOTYPES
+#endif
+#include "AL/alure2-alext.h"
+#include "AL/efx.h"
+
+namespace {
+
+using clock_type = std::chrono::steady_clock;
+
+const char DeviceName[] = "Mock Device";
+// Device lists are double-null terminated.
+const char DeviceList[] = "Mock Device\0";
+const char CaptureDeviceList[] = "\0";
+
+const char ALCExtensions[] = "ALC_ENUMERATE_ALL_EXT ALC_EXT_disconnect ALC_EXT_EFX "
+    "ALC_EXT_thread_local_context ALC_SOFT_loopback ALC_SOFT_pause_device";
+const char ALExtensions[] = "AL_EXT_FLOAT32 AL_EXT_MCFORMATS AL_EXT_SOURCE_RADIUS "
+    "AL_EXT_STEREO_ANGLES AL_SOFT_block_alignment AL_SOFT_buffer_sub_data AL_SOFT_loop_points "
+    "AL_SOFT_source_latency AL_SOFT_source_spatialize";
+
+constexpr ALCint DefaultFrequency = 48000;
+constexpr ALCint DefaultMonoSources = 256;
+constexpr ALCint DefaultStereoSources = 1;
+constexpr ALCint MaxAuxSends = 2;
+
+struct FormatInfo {
+    const char *mName;
+    ALenum mFormat;
+    ALint mChannels;
+    ALint mBits;
+};
+const FormatInfo FormatList[] = {
+    { "AL_FORMAT_MONO8",          AL_FORMAT_MONO8,          1,  8 },
+    { "AL_FORMAT_MONO16",         AL_FORMAT_MONO16,         1, 16 },
+    { "AL_FORMAT_MONO_FLOAT32",   AL_FORMAT_MONO_FLOAT32,   1, 32 },
+    { "AL_FORMAT_STEREO8",        AL_FORMAT_STEREO8,        2,  8 },
+    { "AL_FORMAT_STEREO16",       AL_FORMAT_STEREO16,       2, 16 },
+    { "AL_FORMAT_STEREO_FLOAT32", AL_FORMAT_STEREO_FLOAT32, 2, 32 },
+    { "AL_FORMAT_REAR8",          AL_FORMAT_REAR8,          2,  8 },
+    { "AL_FORMAT_REAR16",         AL_FORMAT_REAR16,         2, 16 },
+    { "AL_FORMAT_REAR32",         AL_FORMAT_REAR32,         2, 32 },
+    { "AL_FORMAT_QUAD8",          AL_FORMAT_QUAD8,          4,  8 },
+    { "AL_FORMAT_QUAD16",         AL_FORMAT_QUAD16,         4, 16 },
+    { "AL_FORMAT_QUAD32",         AL_FORMAT_QUAD32,         4, 32 },
+    { "AL_FORMAT_51CHN8",         AL_FORMAT_51CHN8,         6,  8 },
+    { "AL_FORMAT_51CHN16",        AL_FORMAT_51CHN16,        6, 16 },
+    { "AL_FORMAT_51CHN32",        AL_FORMAT_51CHN32,        6, 32 },
+    { "AL_FORMAT_61CHN8",         AL_FORMAT_61CHN8,         7,  8 },
+    { "AL_FORMAT_61CHN16",        AL_FORMAT_61CHN16,        7, 16 },
+    { "AL_FORMAT_61CHN32",        AL_FORMAT_61CHN32,        7, 32 },
+    { "AL_FORMAT_71CHN8",         AL_FORMAT_71CHN8,         8,  8 },
+    { "AL_FORMAT_71CHN16",        AL_FORMAT_71CHN16,        8, 16 },
+    { "AL_FORMAT_71CHN32",        AL_FORMAT_71CHN32,        8, 32 },
+};
+
+const FormatInfo *GetFormatInfo(ALenum format)
+{
+    for(const FormatInfo &info : FormatList)
+    {
+        if(info.mFormat == format)
+            return &info;
+    }
+    return nullptr;
+}
+
+
+bool HasExtension(const char *list, const char *name)
+{
+    if(!name) return false;
+    size_t len = strlen(name);
+    while(*list)
+    {
+        size_t toklen = strcspn(list, " ");
+        if(toklen == len && std::equal(name, name+len, list,
+            [](char a, char b) -> bool
+            { return std::tolower(static_cast<unsigned char>(a)) ==
+                     std::tolower(static_cast<unsigned char>(b)); }))
+            return true;
+        list += toklen;
+        while(*list == ' ') ++list;
+    }
+    return false;
+}
+
+
+struct MockBuffer {
+    ALsizei mSize{0};
+    ALint mChannels{1};
+    ALint mBits{16};
+    ALsizei mFrequency{DefaultFrequency};
+    ALint mLoopStart{0};
+    ALint mLoopEnd{0};
+    std::vector<char> mData;
+
+    ALint getFrames() const { return mSize / (mChannels*mBits/8); }
+};
+
+struct MockSource {
+    ALint mState{AL_INITIAL};
+    ALint mType{AL_UNDETERMINED};
+    bool mLooping{false};
+
+    std::vector<ALuint> mQueue;
+    // The queue entry being played, and the position in it, in the buffer's
+    // sample frames.
+    size_t mCurrent{0};
+    double mFrame{0.0};
+};
+
+} // namespace
+
+struct ALCdevice_struct {
+    bool mLoopback{false};
+    bool mPaused{false};
+    ALCint mFrequency{DefaultFrequency};
+    ALCint mChannels{ALC_STEREO_SOFT};
+    ALCint mType{ALC_FLOAT_SOFT};
+    ALCenum mError{ALC_NO_ERROR};
+
+    std::map<ALuint,MockBuffer> mBuffers;
+    ALuint mNextBuffer{1};
+};
+
+struct ALCcontext_struct {
+    ALCdevice *mDevice{nullptr};
+    ALCint mMonoSources{DefaultMonoSources};
+    ALCint mStereoSources{DefaultStereoSources};
+    ALenum mError{AL_NO_ERROR};
+
+    std::map<ALuint,MockSource> mSources;
+    ALuint mNextSource{1};
+
+    std::set<ALuint> mEffects;
+    std::set<ALuint> mFilters;
+    std::set<ALuint> mSlots;
+    ALuint mNextObject{1};
+};
+
+namespace {
+
+// Guards all of the following state. AL calls are serialized, which a real
+// implementation doesn't do, but keeps the recorded order meaningful.
+std::mutex gLock;
+
+bool gRecording{true};
+clock_type::time_point gStartTime{clock_type::now()};
+std::vector<mockal::Call> gCalls;
+std::map<std::string,size_t> gCallCounts;
+
+std::vector<ALCdevice*> gDevices;
+std::vector<ALCcontext*> gContexts;
+ALCcontext *gCurrentContext{nullptr};
+thread_local ALCcontext *gThreadContext{nullptr};
+ALCenum gNullDeviceError{ALC_NO_ERROR};
+
+
+// Wrappers to format arguments that don't print well on their own.
+struct Hex { ALenum mValue; };
+std::ostream &operator<<(std::ostream &out, const Hex &hex)
+{
+    std::ios::fmtflags flags = out.flags();
+    out<< "0x"<<std::hex<<hex.mValue;
+    out.flags(flags);
+    return out;
+}
+
+struct Str { const char *mValue; };
+std::ostream &operator<<(std::ostream &out, const Str &str)
+{
+    if(!str.mValue) return out << "null";
+    return out << '"'<<str.mValue<<'"';
+}
+
+template<typename T>
+struct List { const T *mValues; size_t mCount; };
+template<typename T>
+List<T> MakeList(const T *values, ALsizei count)
+{ return List<T>{values, values ? static_cast<size_t>(std::max(count, 0)) : 0}; }
+template<typename T>
+std::ostream &operator<<(std::ostream &out, const List<T> &list)
+{
+    if(!list.mValues) return out << "null";
+    out<< '{';
+    for(size_t i = 0;i < list.mCount;++i)
+        out<< (i ? ", " : "") << list.mValues[i];
+    return out << '}';
+}
+
+struct Ptr { const void *mValue; };
+std::ostream &operator<<(std::ostream &out, const Ptr &ptr)
+{
+    if(!ptr.mValue) return out << "null";
+    return out << ptr.mValue;
+}
+
+inline void FormatArgs(std::ostream&) { }
+template<typename T, typename ...Rest>
+inline void FormatArgs(std::ostream &out, const T &arg, const Rest&... rest)
+{
+    out<< arg;
+    if(sizeof...(rest) > 0) out << ", ";
+    FormatArgs(out, rest...);
+}
+
+// Records a call. The lock must be held.
+template<typename ...Args>
+void Record(const char *name, const Args&... args)
+{
+    if(!gRecording) return;
+
+    std::ostringstream out;
+    FormatArgs(out, args...);
+    gCalls.push_back(mockal::Call{
+        name, out.str(), std::chrono::duration_cast<std::chrono::nanoseconds>(
+            clock_type::now() - gStartTime
+        )
+    });
+    ++gCallCounts[name];
+}
+
+#define MOCK_CALL(...)                                                        \
+    std::lock_guard<std::mutex> lock(gLock);                                  \
+    Record(__func__, ##__VA_ARGS__)
+
+
+ALCcontext *GetContext()
+{ return gThreadContext ? gThreadContext : gCurrentContext; }
+
+bool IsDevice(ALCdevice *device)
+{ return std::find(gDevices.begin(), gDevices.end(), device) != gDevices.end(); }
+
+bool IsContext(ALCcontext *context)
+{ return std::find(gContexts.begin(), gContexts.end(), context) != gContexts.end(); }
+
+void SetError(ALCcontext *context, ALenum error)
+{
+    if(context && context->mError == AL_NO_ERROR)
+        context->mError = error;
+}
+
+void SetDeviceError(ALCdevice *device, ALCenum error)
+{
+    ALCenum &dst = IsDevice(device) ? device->mError : gNullDeviceError;
+    if(dst == ALC_NO_ERROR) dst = error;
+}
+
+// Gets the source with the given ID on the current context, setting an error
+// if it doesn't exist.
+MockSource *GetSource(ALCcontext *context, ALuint id)
+{
+    if(!context) return nullptr;
+    auto iter = context->mSources.find(id);
+    if(iter == context->mSources.end())
+    {
+        SetError(context, AL_INVALID_NAME);
+        return nullptr;
+    }
+    return &iter->second;
+}
+
+MockBuffer *GetBuffer(ALCcontext *context, ALuint id)
+{
+    if(!context) return nullptr;
+    auto iter = context->mDevice->mBuffers.find(id);
+    if(iter == context->mDevice->mBuffers.end())
+    {
+        SetError(context, AL_INVALID_NAME);
+        return nullptr;
+    }
+    return &iter->second;
+}
+
+
+// The number of queue entries that have finished playing.
+size_t GetProcessed(const MockSource &source)
+{
+    if(source.mType != AL_STREAMING)
+        return 0;
+    if(source.mState == AL_STOPPED)
+        return source.mQueue.size();
+    if(source.mState == AL_INITIAL)
+        return 0;
+    return source.mCurrent;
+}
+
+// The source's offset from the start of its queue, in sample frames.
+ALint64SOFT GetSampleOffset(ALCcontext *context, const MockSource &source)
+{
+    if(source.mState != AL_PLAYING && source.mState != AL_PAUSED)
+        return 0;
+    ALint64SOFT offset = 0;
+    for(size_t i = 0;i < source.mCurrent && i < source.mQueue.size();++i)
+    {
+        auto iter = context->mDevice->mBuffers.find(source.mQueue[i]);
+        if(iter != context->mDevice->mBuffers.end())
+            offset += iter->second.getFrames();
+    }
+    return offset + static_cast<ALint64SOFT>(source.mFrame);
+}
+
+ALsizei GetQueueFrequency(ALCcontext *context, const MockSource &source)
+{
+    for(ALuint id : source.mQueue)
+    {
+        auto iter = context->mDevice->mBuffers.find(id);
+        if(iter != context->mDevice->mBuffers.end())
+            return iter->second.mFrequency;
+    }
+    return context->mDevice->mFrequency;
+}
+
+void SetSampleOffset(ALCcontext *context, MockSource &source, ALint64SOFT offset)
+{
+    size_t idx = 0;
+    for(;idx < source.mQueue.size();++idx)
+    {
+        auto iter = context->mDevice->mBuffers.find(source.mQueue[idx]);
+        ALint frames = (iter != context->mDevice->mBuffers.end()) ?
+                       iter->second.getFrames() : 0;
+        if(offset < frames) break;
+        offset -= frames;
+    }
+    if(idx >= source.mQueue.size())
+    {
+        SetError(context, AL_INVALID_VALUE);
+        return;
+    }
+    source.mCurrent = idx;
+    source.mFrame = static_cast<double>(offset);
+}
+
+// Advances a playing source by the given number of device sample frames.
+void AdvanceSource(ALCcontext *context, MockSource &source, ALCsizei samples)
+{
+    if(source.mState != AL_PLAYING)
+        return;
+
+    const ALCdevice *device = context->mDevice;
+    double remaining = samples * static_cast<double>(GetQueueFrequency(context, source)) /
+                       device->mFrequency;
+    while(source.mCurrent < source.mQueue.size())
+    {
+        auto iter = device->mBuffers.find(source.mQueue[source.mCurrent]);
+        const MockBuffer *buffer = (iter != device->mBuffers.end()) ? &iter->second : nullptr;
+        ALint end = buffer ? buffer->getFrames() : 0;
+        if(buffer && source.mLooping && source.mType == AL_STATIC &&
+           buffer->mLoopEnd > buffer->mLoopStart)
+            end = std::min(end, buffer->mLoopEnd);
+
+        double avail = end - source.mFrame;
+        if(remaining < avail)
+        {
+            source.mFrame += remaining;
+            return;
+        }
+        remaining -= std::max(avail, 0.0);
+        source.mFrame = 0.0;
+
+        if(source.mType == AL_STATIC && source.mLooping)
+        {
+            if(buffer && buffer->mLoopEnd > buffer->mLoopStart)
+                source.mFrame = buffer->mLoopStart;
+            if(end <= source.mFrame) return;
+            continue;
+        }
+        if(++source.mCurrent >= source.mQueue.size() && source.mLooping)
+            source.mCurrent = 0;
+    }
+    source.mState = AL_STOPPED;
+    source.mCurrent = source.mQueue.size();
+    source.mFrame = 0.0;
+}
+
+ALCint ChannelCount(ALCenum channels)
+{
+    switch(channels)
+    {
+        case ALC_MONO_SOFT: return 1;
+        case ALC_STEREO_SOFT: return 2;
+        case ALC_QUAD_SOFT: return 4;
+        case ALC_5POINT1_SOFT: return 6;
+        case ALC_6POINT1_SOFT: return 7;
+        case ALC_7POINT1_SOFT: return 8;
+    }
+    return 0;
+}
+
+ALCint TypeSize(ALCenum type)
+{
+    switch(type)
+    {
+        case ALC_BYTE_SOFT: case ALC_UNSIGNED_BYTE_SOFT: return 1;
+        case ALC_SHORT_SOFT: case ALC_UNSIGNED_SHORT_SOFT: return 2;
+        case ALC_INT_SOFT: case ALC_UNSIGNED_INT_SOFT: case ALC_FLOAT_SOFT: return 4;
+    }
+    return 0;
+}
+
+
+// Generates, deletes, and checks the simple EFX object IDs.
+void GenObjects(ALCcontext *context, std::set<ALuint> ALCcontext::*objects, ALsizei n,
+                ALuint *ids)
+{
+    if(!context) return;
+    if(n < 0) return SetError(context, AL_INVALID_VALUE);
+    for(ALsizei i = 0;i < n;++i)
+    {
+        ids[i] = context->mNextObject++;
+        (context->*objects).insert(ids[i]);
+    }
+}
+
+void DeleteObjects(ALCcontext *context, std::set<ALuint> ALCcontext::*objects, ALsizei n,
+                   const ALuint *ids)
+{
+    if(!context) return;
+    if(n < 0) return SetError(context, AL_INVALID_VALUE);
+    for(ALsizei i = 0;i < n;++i)
+    {
+        if(ids[i] && (context->*objects).find(ids[i]) == (context->*objects).end())
+            return SetError(context, AL_INVALID_NAME);
+    }
+    for(ALsizei i = 0;i < n;++i)
+        (context->*objects).erase(ids[i]);
+}
+
+bool IsObject(ALCcontext *context, std::set<ALuint> ALCcontext::*objects, ALuint id)
+{ return context && (context->*objects).find(id) != (context->*objects).end(); }
+
+void CheckObject(ALCcontext *context, std::set<ALuint> ALCcontext::*objects, ALuint id)
+{
+    // Object 0 is valid for effect slot and source properties, referring to
+    // no object.
+    if(context && id != 0 && !IsObject(context, objects, id))
+        SetError(context, AL_INVALID_NAME);
+}
+
+
+struct FuncEntry {
+    const char *mName;
+    void *mAddress;
+};
+#define FUNC(f) { #f, reinterpret_cast<void*>(f) }
+const FuncEntry ExtFunctions[] = {
+    FUNC(alcSetThreadContext),
+    FUNC(alcGetThreadContext),
+    FUNC(alcLoopbackOpenDeviceSOFT),
+    FUNC(alcIsRenderFormatSupportedSOFT),
+    FUNC(alcRenderSamplesSOFT),
+    FUNC(alcDevicePauseSOFT),
+    FUNC(alcDeviceResumeSOFT),
+
+    FUNC(alGetSourcei64vSOFT),
+    FUNC(alGetSourcedvSOFT),
+    FUNC(alBufferSubDataSOFT),
+
+    FUNC(alGenEffects),
+    FUNC(alDeleteEffects),
+    FUNC(alIsEffect),
+    FUNC(alEffecti),
+    FUNC(alEffectiv),
+    FUNC(alEffectf),
+    FUNC(alEffectfv),
+    FUNC(alGetEffecti),
+    FUNC(alGetEffectiv),
+    FUNC(alGetEffectf),
+    FUNC(alGetEffectfv),
+
+    FUNC(alGenFilters),
+    FUNC(alDeleteFilters),
+    FUNC(alIsFilter),
+    FUNC(alFilteri),
+    FUNC(alFilteriv),
+    FUNC(alFilterf),
+    FUNC(alFilterfv),
+    FUNC(alGetFilteri),
+    FUNC(alGetFilteriv),
+    FUNC(alGetFilterf),
+    FUNC(alGetFilterfv),
+
+    FUNC(alGenAuxiliaryEffectSlots),
+    FUNC(alDeleteAuxiliaryEffectSlots),
+    FUNC(alIsAuxiliaryEffectSlot),
+    FUNC(alAuxiliaryEffectSloti),
+    FUNC(alAuxiliaryEffectSlotiv),
+    FUNC(alAuxiliaryEffectSlotf),
+    FUNC(alAuxiliaryEffectSlotfv),
+    FUNC(alGetAuxiliaryEffectSloti),
+    FUNC(alGetAuxiliaryEffectSlotiv),
+    FUNC(alGetAuxiliaryEffectSlotf),
+    FUNC(alGetAuxiliaryEffectSlotfv),
+};
+#undef FUNC
+
+void *GetFunction(const char *name)
+{
+    if(!name) return nullptr;
+    for(const FuncEntry &entry : ExtFunctions)
+    {
+        if(strcmp(entry.mName, name) == 0)
+            return entry.mAddress;
+    }
+    return nullptr;
+}
+
+} // namespace
+
+
+namespace mockal {
+
+void ResetCalls()
+{
+    std::lock_guard<std::mutex> lock(gLock);
+    gCalls.clear();
+    gCallCounts.clear();
+    gStartTime = clock_type::now();
+}
+
+void SetRecording(bool enable)
+{
+    std::lock_guard<std::mutex> lock(gLock);
+    gRecording = enable;
+}
+
+std::vector<Call> GetCalls()
+{
+    std::lock_guard<std::mutex> lock(gLock);
+    return gCalls;
+}
+
+std::map<std::string,size_t> GetCallCounts()
+{
+    std::lock_guard<std::mutex> lock(gLock);
+    return gCallCounts;
+}
+
+size_t GetCallCount(const char *name)
+{
+    std::lock_guard<std::mutex> lock(gLock);
+    if(!name) return gCalls.size();
+    auto iter = gCallCounts.find(name);
+    return (iter != gCallCounts.end()) ? iter->second : 0;
+}
+
+std::vector<char> GetBufferData(unsigned int buffer)
+{
+    std::lock_guard<std::mutex> lock(gLock);
+    ALCcontext *context = GetContext();
+    if(!context) return {};
+    auto iter = context->mDevice->mBuffers.find(buffer);
+    if(iter == context->mDevice->mBuffers.end()) return {};
+    return iter->second.mData;
+}
+
+std::vector<unsigned int> GetSourceQueue(unsigned int source)
+{
+    std::lock_guard<std::mutex> lock(gLock);
+    ALCcontext *context = GetContext();
+    if(!context) return {};
+    auto iter = context->mSources.find(source);
+    if(iter == context->mSources.end()) return {};
+    return std::vector<unsigned int>(iter->second.mQueue.begin(), iter->second.mQueue.end());
+}
+
+} // namespace mockal
+
+
+/*** ALC ***/
+
+ALC_API ALCdevice* ALC_APIENTRY alcOpenDevice(const ALCchar *devicename)
+{
+    MOCK_CALL(Str{devicename});
+    if(devicename && strcmp(devicename, DeviceName) != 0)
+    {
+        SetDeviceError(nullptr, ALC_INVALID_VALUE);
+        return nullptr;
+    }
+    gDevices.push_back(new ALCdevice);
+    return gDevices.back();
+}
+
+ALC_API ALCdevice* ALC_APIENTRY alcLoopbackOpenDeviceSOFT(const ALCchar *deviceName)
+{
+    MOCK_CALL(Str{deviceName});
+    if(deviceName && strcmp(deviceName, DeviceName) != 0)
+    {
+        SetDeviceError(nullptr, ALC_INVALID_VALUE);
+        return nullptr;
+    }
+    gDevices.push_back(new ALCdevice);
+    gDevices.back()->mLoopback = true;
+    return gDevices.back();
+}
+
+ALC_API ALCboolean ALC_APIENTRY alcCloseDevice(ALCdevice *device)
+{
+    MOCK_CALL(Ptr{device});
+    if(!IsDevice(device))
+    {
+        SetDeviceError(nullptr, ALC_INVALID_DEVICE);
+        return ALC_FALSE;
+    }
+    for(ALCcontext *context : gContexts)
+    {
+        if(context->mDevice == device)
+        {
+            SetDeviceError(device, ALC_INVALID_DEVICE);
+            return ALC_FALSE;
+        }
+    }
+    gDevices.erase(std::find(gDevices.begin(), gDevices.end(), device));
+    delete device;
+    return ALC_TRUE;
+}
+
+ALC_API ALCcontext* ALC_APIENTRY alcCreateContext(ALCdevice *device, const ALCint *attrlist)
+{
+    MOCK_CALL(Ptr{device}, Ptr{attrlist});
+    if(!IsDevice(device))
+    {
+        SetDeviceError(nullptr, ALC_INVALID_DEVICE);
+        return nullptr;
+    }
+
+    ALCint monosources = DefaultMonoSources;
+    ALCint stereosources = DefaultStereoSources;
+    ALCint frequency = device->mFrequency;
+    ALCint channels = 0, type = 0;
+    for(size_t i = 0;attrlist && attrlist[i];i += 2)
+    {
+        switch(attrlist[i])
+        {
+            case ALC_MONO_SOURCES: monosources = attrlist[i+1]; break;
+            case ALC_STEREO_SOURCES: stereosources = attrlist[i+1]; break;
+            case ALC_FREQUENCY: frequency = attrlist[i+1]; break;
+            case ALC_FORMAT_CHANNELS_SOFT: channels = attrlist[i+1]; break;
+            case ALC_FORMAT_TYPE_SOFT: type = attrlist[i+1]; break;
+        }
+    }
+    if(device->mLoopback)
+    {
+        // Loopback devices require the full render format.
+        if(ChannelCount(channels) == 0 || TypeSize(type) == 0 || frequency <= 0)
+        {
+            SetDeviceError(device, ALC_INVALID_VALUE);
+            return nullptr;
+        }
+        device->mChannels = channels;
+        device->mType = type;
+        device->mFrequency = frequency;
+    }
+
+    ALCcontext *context = new ALCcontext;
+    context->mDevice = device;
+    context->mMonoSources = std::max(monosources, 0);
+    context->mStereoSources = std::max(stereosources, 0);
+    gContexts.push_back(context);
+    return context;
+}
+
+ALC_API ALCboolean ALC_APIENTRY alcMakeContextCurrent(ALCcontext *context)
+{
+    MOCK_CALL(Ptr{context});
+    if(context && !IsContext(context))
+    {
+        SetDeviceError(nullptr, ALC_INVALID_CONTEXT);
+        return ALC_FALSE;
+    }
+    gCurrentContext = context;
+    gThreadContext = nullptr;
+    return ALC_TRUE;
+}
+
+ALC_API void ALC_APIENTRY alcProcessContext(ALCcontext *context)
+{
+    MOCK_CALL(Ptr{context});
+    if(!IsContext(context))
+        SetDeviceError(nullptr, ALC_INVALID_CONTEXT);
+}
+
+ALC_API void ALC_APIENTRY alcSuspendContext(ALCcontext *context)
+{
+    MOCK_CALL(Ptr{context});
+    if(!IsContext(context))
+        SetDeviceError(nullptr, ALC_INVALID_CONTEXT);
+}
+
+ALC_API void ALC_APIENTRY alcDestroyContext(ALCcontext *context)
+{
+    MOCK_CALL(Ptr{context});
+    if(!IsContext(context))
+    {
+        SetDeviceError(nullptr, ALC_INVALID_CONTEXT);
+        return;
+    }
+    if(gCurrentContext == context) gCurrentContext = nullptr;
+    if(gThreadContext == context) gThreadContext = nullptr;
+    gContexts.erase(std::find(gContexts.begin(), gContexts.end(), context));
+    delete context;
+}
+
+ALC_API ALCcontext* ALC_APIENTRY alcGetCurrentContext(void)
+{
+    MOCK_CALL();
+    return GetContext();
+}
+
+ALC_API ALCdevice* ALC_APIENTRY alcGetContextsDevice(ALCcontext *context)
+{
+    MOCK_CALL(Ptr{context});
+    if(!IsContext(context))
+    {
+        SetDeviceError(nullptr, ALC_INVALID_CONTEXT);
+        return nullptr;
+    }
+    return context->mDevice;
+}
+
+ALC_API ALCboolean ALC_APIENTRY alcSetThreadContext(ALCcontext *context)
+{
+    MOCK_CALL(Ptr{context});
+    if(context && !IsContext(context))
+    {
+        SetDeviceError(nullptr, ALC_INVALID_CONTEXT);
+        return ALC_FALSE;
+    }
+    gThreadContext = context;
+    return ALC_TRUE;
+}
+
+ALC_API ALCcontext* ALC_APIENTRY alcGetThreadContext(void)
+{
+    MOCK_CALL();
+    return gThreadContext;
+}
+
+ALC_API ALCenum ALC_APIENTRY alcGetError(ALCdevice *device)
+{
+    MOCK_CALL(Ptr{device});
+    ALCenum &error = IsDevice(device) ? device->mError : gNullDeviceError;
+    ALCenum ret = error;
+    error = ALC_NO_ERROR;
+    return ret;
+}
+
+ALC_API ALCboolean ALC_APIENTRY alcIsExtensionPresent(ALCdevice *device, const ALCchar *extname)
+{
+    MOCK_CALL(Ptr{device}, Str{extname});
+    if(!extname)
+    {
+        SetDeviceError(device, ALC_INVALID_VALUE);
+        return ALC_FALSE;
+    }
+    return HasExtension(ALCExtensions, extname) ? ALC_TRUE : ALC_FALSE;
+}
+
+ALC_API void* ALC_APIENTRY alcGetProcAddress(ALCdevice *device, const ALCchar *funcname)
+{
+    MOCK_CALL(Ptr{device}, Str{funcname});
+    return GetFunction(funcname);
+}
+
+ALC_API ALCenum ALC_APIENTRY alcGetEnumValue(ALCdevice *device, const ALCchar *enumname)
+{
+    MOCK_CALL(Ptr{device}, Str{enumname});
+    return 0;
+}
+
+ALC_API const ALCchar* ALC_APIENTRY alcGetString(ALCdevice *device, ALCenum param)
+{
+    MOCK_CALL(Ptr{device}, Hex{param});
+    switch(param)
+    {
+        case ALC_NO_ERROR: return "No Error";
+        case ALC_INVALID_DEVICE: return "Invalid Device";
+        case ALC_INVALID_CONTEXT: return "Invalid Context";
+        case ALC_INVALID_ENUM: return "Invalid Enum";
+        case ALC_INVALID_VALUE: return "Invalid Value";
+        case ALC_OUT_OF_MEMORY: return "Out of Memory";
+
+        case ALC_DEFAULT_DEVICE_SPECIFIER:
+        case ALC_DEFAULT_ALL_DEVICES_SPECIFIER:
+            return DeviceName;
+
+        case ALC_DEVICE_SPECIFIER:
+        case ALC_ALL_DEVICES_SPECIFIER:
+            return IsDevice(device) ? DeviceName : DeviceList;
+
+        case ALC_CAPTURE_DEVICE_SPECIFIER:
+        case ALC_CAPTURE_DEFAULT_DEVICE_SPECIFIER:
+            return CaptureDeviceList;
+
+        case ALC_EXTENSIONS:
+            return ALCExtensions;
+    }
+    SetDeviceError(device, ALC_INVALID_ENUM);
+    return nullptr;
+}
+
+ALC_API void ALC_APIENTRY alcGetIntegerv(ALCdevice *device, ALCenum param, ALCsizei size, ALCint *values)
+{
+    MOCK_CALL(Ptr{device}, Hex{param}, size, Ptr{values});
+    if(size <= 0 || !values)
+    {
+        SetDeviceError(device, ALC_INVALID_VALUE);
+        return;
+    }
+
+    switch(param)
+    {
+        case ALC_MAJOR_VERSION: *values = 1; return;
+        case ALC_MINOR_VERSION: *values = 1; return;
+        case ALC_EFX_MAJOR_VERSION: *values = 1; return;
+        case ALC_EFX_MINOR_VERSION: *values = 0; return;
+    }
+    if(!IsDevice(device))
+    {
+        SetDeviceError(nullptr, ALC_INVALID_DEVICE);
+        return;
+    }
+
+    ALCcontext *context = nullptr;
+    for(ALCcontext *ctx : gContexts)
+    {
+        if(ctx->mDevice == device)
+        {
+            context = ctx;
+            break;
+        }
+    }
+    switch(param)
+    {
+        case ALC_FREQUENCY: *values = device->mFrequency; return;
+        case ALC_REFRESH: *values = 50; return;
+        case ALC_SYNC: *values = ALC_FALSE; return;
+        case ALC_CONNECTED: *values = ALC_TRUE; return;
+        case ALC_MAX_AUXILIARY_SENDS: *values = MaxAuxSends; return;
+        case ALC_MONO_SOURCES:
+            *values = context ? context->mMonoSources : DefaultMonoSources;
+            return;
+        case ALC_STEREO_SOURCES:
+            *values = context ? context->mStereoSources : DefaultStereoSources;
+            return;
+    }
+    SetDeviceError(device, ALC_INVALID_ENUM);
+}
+
+ALC_API ALCdevice* ALC_APIENTRY alcCaptureOpenDevice(const ALCchar *devicename, ALCuint frequency, ALCenum format, ALCsizei buffersize)
+{
+    MOCK_CALL(Str{devicename}, frequency, Hex{format}, buffersize);
+    SetDeviceError(nullptr, ALC_INVALID_VALUE);
+    return nullptr;
+}
+
+ALC_API ALCboolean ALC_APIENTRY alcCaptureCloseDevice(ALCdevice *device)
+{
+    MOCK_CALL(Ptr{device});
+    SetDeviceError(nullptr, ALC_INVALID_DEVICE);
+    return ALC_FALSE;
+}
+
+ALC_API void ALC_APIENTRY alcCaptureStart(ALCdevice *device)
+{
+    MOCK_CALL(Ptr{device});
+    SetDeviceError(nullptr, ALC_INVALID_DEVICE);
+}
+
+ALC_API void ALC_APIENTRY alcCaptureStop(ALCdevice *device)
+{
+    MOCK_CALL(Ptr{device});
+    SetDeviceError(nullptr, ALC_INVALID_DEVICE);
+}
+
+ALC_API void ALC_APIENTRY alcCaptureSamples(ALCdevice *device, ALCvoid *buffer, ALCsizei samples)
+{
+    MOCK_CALL(Ptr{device}, Ptr{buffer}, samples);
+    SetDeviceError(nullptr, ALC_INVALID_DEVICE);
+}
+
+ALC_API ALCboolean ALC_APIENTRY alcIsRenderFormatSupportedSOFT(ALCdevice *device, ALCsizei freq, ALCenum channels, ALCenum type)
+{
+    MOCK_CALL(Ptr{device}, freq, Hex{channels}, Hex{type});
+    if(!IsDevice(device) || !device->mLoopback)
+    {
+        SetDeviceError(device, ALC_INVALID_DEVICE);
+        return ALC_FALSE;
+    }
+    if(freq <= 0)
+    {
+        SetDeviceError(device, ALC_INVALID_VALUE);
+        return ALC_FALSE;
+    }
+    return (ChannelCount(channels) > 0 && TypeSize(type) > 0) ? ALC_TRUE : ALC_FALSE;
+}
+
+ALC_API void ALC_APIENTRY alcRenderSamplesSOFT(ALCdevice *device, ALCvoid *buffer, ALCsizei samples)
+{
+    MOCK_CALL(Ptr{device}, Ptr{buffer}, samples);
+    if(!IsDevice(device) || !device->mLoopback)
+    {
+        SetDeviceError(device, ALC_INVALID_DEVICE);
+        return;
+    }
+    if(samples < 0 || (samples > 0 && !buffer))
+    {
+        SetDeviceError(device, ALC_INVALID_VALUE);
+        return;
+    }
+
+    // Output silence, which is the midpoint for unsigned types.
+    size_t count = static_cast<size_t>(samples) * ChannelCount(device->mChannels);
+    switch(device->mType)
+    {
+        case ALC_UNSIGNED_BYTE_SOFT:
+            std::fill_n(static_cast<ALCubyte*>(buffer), count, 0x80);
+            break;
+        case ALC_UNSIGNED_SHORT_SOFT:
+            std::fill_n(static_cast<ALCushort*>(buffer), count, 0x8000);
+            break;
+        case ALC_UNSIGNED_INT_SOFT:
+            std::fill_n(static_cast<ALCuint*>(buffer), count, 0x80000000u);
+            break;
+        default:
+            memset(buffer, 0, count * TypeSize(device->mType));
+            break;
+    }
+
+    if(device->mPaused)
+        return;
+    for(ALCcontext *context : gContexts)
+    {
+        if(context->mDevice != device)
+            continue;
+        for(auto &source : context->mSources)
+            AdvanceSource(context, source.second, samples);
+    }
+}
+
+ALC_API void ALC_APIENTRY alcDevicePauseSOFT(ALCdevice *device)
+{
+    MOCK_CALL(Ptr{device});
+    if(!IsDevice(device))
+        SetDeviceError(nullptr, ALC_INVALID_DEVICE);
+    else
+        device->mPaused = true;
+}
+
+ALC_API void ALC_APIENTRY alcDeviceResumeSOFT(ALCdevice *device)
+{
+    MOCK_CALL(Ptr{device});
+    if(!IsDevice(device))
+        SetDeviceError(nullptr, ALC_INVALID_DEVICE);
+    else
+        device->mPaused = false;
+}
+
+
+/*** AL state ***/
+
+AL_API void AL_APIENTRY alEnable(ALenum capability)
+{
+    MOCK_CALL(Hex{capability});
+    SetError(GetContext(), AL_INVALID_ENUM);
+}
+
+AL_API void AL_APIENTRY alDisable(ALenum capability)
+{
+    MOCK_CALL(Hex{capability});
+    SetError(GetContext(), AL_INVALID_ENUM);
+}
+
+AL_API ALboolean AL_APIENTRY alIsEnabled(ALenum capability)
+{
+    MOCK_CALL(Hex{capability});
+    SetError(GetContext(), AL_INVALID_ENUM);
+    return AL_FALSE;
+}
+
+AL_API const ALchar* AL_APIENTRY alGetString(ALenum param)
+{
+    MOCK_CALL(Hex{param});
+    switch(param)
+    {
+        case AL_VENDOR: return "alure";
+        case AL_VERSION: return "1.1 mock";
+        case AL_RENDERER: return "Mock";
+        case AL_EXTENSIONS: return ALExtensions;
+        case AL_NO_ERROR: return "No Error";
+        case AL_INVALID_NAME: return "Invalid Name";
+        case AL_INVALID_ENUM: return "Invalid Enum";
+        case AL_INVALID_VALUE: return "Invalid Value";
+        case AL_INVALID_OPERATION: return "Invalid Operation";
+        case AL_OUT_OF_MEMORY: return "Out of Memory";
+    }
+    SetError(GetContext(), AL_INVALID_ENUM);
+    return nullptr;
+}
+
+// Global state is accepted and otherwise ignored, with queries returning 0.
+AL_API void AL_APIENTRY alGetBooleanv(ALenum param, ALboolean *values)
+{
+    MOCK_CALL(Hex{param}, Ptr{values});
+    if(values) *values = AL_FALSE;
+}
+
+AL_API void AL_APIENTRY alGetIntegerv(ALenum param, ALint *values)
+{
+    MOCK_CALL(Hex{param}, Ptr{values});
+    if(values) *values = 0;
+}
+
+AL_API void AL_APIENTRY alGetFloatv(ALenum param, ALfloat *values)
+{
+    MOCK_CALL(Hex{param}, Ptr{values});
+    if(values) *values = 0.0f;
+}
+
+AL_API void AL_APIENTRY alGetDoublev(ALenum param, ALdouble *values)
+{
+    MOCK_CALL(Hex{param}, Ptr{values});
+    if(values) *values = 0.0;
+}
+
+AL_API ALboolean AL_APIENTRY alGetBoolean(ALenum param)
+{
+    MOCK_CALL(Hex{param});
+    return AL_FALSE;
+}
+
+AL_API ALint AL_APIENTRY alGetInteger(ALenum param)
+{
+    MOCK_CALL(Hex{param});
+    return 0;
+}
+
+AL_API ALfloat AL_APIENTRY alGetFloat(ALenum param)
+{
+    MOCK_CALL(Hex{param});
+    return 0.0f;
+}
+
+AL_API ALdouble AL_APIENTRY alGetDouble(ALenum param)
+{
+    MOCK_CALL(Hex{param});
+    return 0.0;
+}
+
+AL_API ALenum AL_APIENTRY alGetError(void)
+{
+    MOCK_CALL();
+    ALCcontext *context = GetContext();
+    if(!context) return AL_INVALID_OPERATION;
+    ALenum ret = context->mError;
+    context->mError = AL_NO_ERROR;
+    return ret;
+}
+
+AL_API ALboolean AL_APIENTRY alIsExtensionPresent(const ALchar *extname)
+{
+    MOCK_CALL(Str{extname});
+    return HasExtension(ALExtensions, extname) ? AL_TRUE : AL_FALSE;
+}
+
+AL_API void* AL_APIENTRY alGetProcAddress(const ALchar *fname)
+{
+    MOCK_CALL(Str{fname});
+    return GetFunction(fname);
+}
+
+AL_API ALenum AL_APIENTRY alGetEnumValue(const ALchar *ename)
+{
+    MOCK_CALL(Str{ename});
+    if(!ename) return 0;
+    for(const FormatInfo &info : FormatList)
+    {
+        if(strcmp(info.mName, ename) == 0)
+            return info.mFormat;
+    }
+    return 0;
+}
+
+AL_API void AL_APIENTRY alDopplerFactor(ALfloat value)
+{ MOCK_CALL(value); }
+
+AL_API void AL_APIENTRY alDopplerVelocity(ALfloat value)
+{ MOCK_CALL(value); }
+
+AL_API void AL_APIENTRY alSpeedOfSound(ALfloat value)
+{ MOCK_CALL(value); }
+
+AL_API void AL_APIENTRY alDistanceModel(ALenum distanceModel)
+{ MOCK_CALL(Hex{distanceModel}); }
+
+
+/*** Listener ***/
+
+// Listener properties are accepted and otherwise ignored, with queries
+// returning 0.
+AL_API void AL_APIENTRY alListenerf(ALenum param, ALfloat value)
+{ MOCK_CALL(Hex{param}, value); }
+
+AL_API void AL_APIENTRY alListener3f(ALenum param, ALfloat value1, ALfloat value2, ALfloat value3)
+{ MOCK_CALL(Hex{param}, value1, value2, value3); }
+
+AL_API void AL_APIENTRY alListenerfv(ALenum param, const ALfloat *values)
+{ MOCK_CALL(Hex{param}, MakeList(values, (param == AL_ORIENTATION) ? 6 : 3)); }
+
+AL_API void AL_APIENTRY alListeneri(ALenum param, ALint value)
+{ MOCK_CALL(Hex{param}, value); }
+
+AL_API void AL_APIENTRY alListener3i(ALenum param, ALint value1, ALint value2, ALint value3)
+{ MOCK_CALL(Hex{param}, value1, value2, value3); }
+
+AL_API void AL_APIENTRY alListeneriv(ALenum param, const ALint *values)
+{ MOCK_CALL(Hex{param}, MakeList(values, (param == AL_ORIENTATION) ? 6 : 3)); }
+
+AL_API void AL_APIENTRY alGetListenerf(ALenum param, ALfloat *value)
+{
+    MOCK_CALL(Hex{param}, Ptr{value});
+    if(value) *value = 0.0f;
+}
+
+AL_API void AL_APIENTRY alGetListener3f(ALenum param, ALfloat *value1, ALfloat *value2, ALfloat *value3)
+{
+    MOCK_CALL(Hex{param}, Ptr{value1}, Ptr{value2}, Ptr{value3});
+    *value1 = *value2 = *value3 = 0.0f;
+}
+
+AL_API void AL_APIENTRY alGetListenerfv(ALenum param, ALfloat *values)
+{
+    MOCK_CALL(Hex{param}, Ptr{values});
+    std::fill_n(values, (param == AL_ORIENTATION) ? 6 : 3, 0.0f);
+}
+
+AL_API void AL_APIENTRY alGetListeneri(ALenum param, ALint *value)
+{
+    MOCK_CALL(Hex{param}, Ptr{value});
+    if(value) *value = 0;
+}
+
+AL_API void AL_APIENTRY alGetListener3i(ALenum param, ALint *value1, ALint *value2, ALint *value3)
+{
+    MOCK_CALL(Hex{param}, Ptr{value1}, Ptr{value2}, Ptr{value3});
+    *value1 = *value2 = *value3 = 0;
+}
+
+AL_API void AL_APIENTRY alGetListeneriv(ALenum param, ALint *values)
+{
+    MOCK_CALL(Hex{param}, Ptr{values});
+    std::fill_n(values, (param == AL_ORIENTATION) ? 6 : 3, 0);
+}
+
+
+/*** Sources ***/
+
+AL_API void AL_APIENTRY alGenSources(ALsizei n, ALuint *sources)
+{
+    MOCK_CALL(n, Ptr{sources});
+    ALCcontext *context = GetContext();
+    if(!context) return;
+    if(n < 0 || context->mSources.size()+n >
+                static_cast<size_t>(context->mMonoSources + context->mStereoSources))
+    {
+        SetError(context, AL_INVALID_VALUE);
+        return;
+    }
+    for(ALsizei i = 0;i < n;++i)
+    {
+        sources[i] = context->mNextSource++;
+        context->mSources.emplace(sources[i], MockSource());
+    }
+}
+
+AL_API void AL_APIENTRY alDeleteSources(ALsizei n, const ALuint *sources)
+{
+    MOCK_CALL(n, MakeList(sources, n));
+    ALCcontext *context = GetContext();
+    if(!context) return;
+    if(n < 0) return SetError(context, AL_INVALID_VALUE);
+    for(ALsizei i = 0;i < n;++i)
+    {
+        if(context->mSources.find(sources[i]) == context->mSources.end())
+            return SetError(context, AL_INVALID_NAME);
+    }
+    for(ALsizei i = 0;i < n;++i)
+        context->mSources.erase(sources[i]);
+}
+
+AL_API ALboolean AL_APIENTRY alIsSource(ALuint source)
+{
+    MOCK_CALL(source);
+    ALCcontext *context = GetContext();
+    return (context && context->mSources.find(source) != context->mSources.end()) ?
+           AL_TRUE : AL_FALSE;
+}
+
+AL_API void AL_APIENTRY alSourcef(ALuint source, ALenum param, ALfloat value)
+{
+    MOCK_CALL(source, Hex{param}, value);
+    ALCcontext *context = GetContext();
+    MockSource *src = GetSource(context, source);
+    if(!src) return;
+    if(param == AL_SEC_OFFSET)
+        SetSampleOffset(context, *src, static_cast<ALint64SOFT>(
+            value * GetQueueFrequency(context, *src)
+        ));
+}
+
+AL_API void AL_APIENTRY alSource3f(ALuint source, ALenum param, ALfloat value1, ALfloat value2, ALfloat value3)
+{
+    MOCK_CALL(source, Hex{param}, value1, value2, value3);
+    GetSource(GetContext(), source);
+}
+
+AL_API void AL_APIENTRY alSourcefv(ALuint source, ALenum param, const ALfloat *values)
+{
+    MOCK_CALL(source, Hex{param}, MakeList(values, (param == AL_ORIENTATION) ? 6 :
+                                                   (param == AL_STEREO_ANGLES) ? 2 : 3));
+    GetSource(GetContext(), source);
+}
+
+AL_API void AL_APIENTRY alSourcei(ALuint source, ALenum param, ALint value)
+{
+    MOCK_CALL(source, Hex{param}, value);
+    ALCcontext *context = GetContext();
+    MockSource *src = GetSource(context, source);
+    if(!src) return;
+
+    switch(param)
+    {
+        case AL_BUFFER:
+            if(src->mState == AL_PLAYING || src->mState == AL_PAUSED)
+                return SetError(context, AL_INVALID_OPERATION);
+            if(value && !GetBuffer(context, value))
+                return;
+            src->mQueue.clear();
+            if(value) src->mQueue.push_back(value);
+            src->mType = value ? AL_STATIC : AL_UNDETERMINED;
+            src->mState = AL_INITIAL;
+            src->mCurrent = 0;
+            src->mFrame = 0.0;
+            break;
+
+        case AL_LOOPING:
+            src->mLooping = (value != AL_FALSE);
+            break;
+
+        case AL_SAMPLE_OFFSET:
+            SetSampleOffset(context, *src, value);
+            break;
+
+        case AL_DIRECT_FILTER:
+            CheckObject(context, &ALCcontext::mFilters, value);
+            break;
+    }
+}
+
+AL_API void AL_APIENTRY alSource3i(ALuint source, ALenum param, ALint value1, ALint value2, ALint value3)
+{
+    MOCK_CALL(source, Hex{param}, value1, value2, value3);
+    ALCcontext *context = GetContext();
+    if(!GetSource(context, source)) return;
+    if(param == AL_AUXILIARY_SEND_FILTER)
+    {
+        if(value2 < 0 || value2 >= MaxAuxSends)
+            return SetError(context, AL_INVALID_VALUE);
+        CheckObject(context, &ALCcontext::mSlots, value1);
+        CheckObject(context, &ALCcontext::mFilters, value3);
+    }
+}
+
+AL_API void AL_APIENTRY alSourceiv(ALuint source, ALenum param, const ALint *values)
+{
+    MOCK_CALL(source, Hex{param}, Ptr{values});
+    GetSource(GetContext(), source);
+}
+
+AL_API void AL_APIENTRY alGetSourcef(ALuint source, ALenum param, ALfloat *value)
+{
+    MOCK_CALL(source, Hex{param}, Ptr{value});
+    ALCcontext *context = GetContext();
+    MockSource *src = GetSource(context, source);
+    if(!src) return;
+    if(param == AL_SEC_OFFSET)
+        *value = static_cast<ALfloat>(
+            static_cast<double>(GetSampleOffset(context, *src)) /
+            GetQueueFrequency(context, *src)
+        );
+    else
+        *value = 0.0f;
+}
+
+AL_API void AL_APIENTRY alGetSource3f(ALuint source, ALenum param, ALfloat *value1, ALfloat *value2, ALfloat *value3)
+{
+    MOCK_CALL(source, Hex{param}, Ptr{value1}, Ptr{value2}, Ptr{value3});
+    if(GetSource(GetContext(), source))
+        *value1 = *value2 = *value3 = 0.0f;
+}
+
+AL_API void AL_APIENTRY alGetSourcefv(ALuint source, ALenum param, ALfloat *values)
+{
+    MOCK_CALL(source, Hex{param}, Ptr{values});
+    if(GetSource(GetContext(), source))
+        std::fill_n(values, (param == AL_ORIENTATION) ? 6 : (param == AL_STEREO_ANGLES) ? 2 : 3,
+                    0.0f);
+}
+
+AL_API void AL_APIENTRY alGetSourcei(ALuint source, ALenum param, ALint *value)
+{
+    MOCK_CALL(source, Hex{param}, Ptr{value});
+    ALCcontext *context = GetContext();
+    MockSource *src = GetSource(context, source);
+    if(!src) return;
+
+    switch(param)
+    {
+        case AL_SOURCE_STATE: *value = src->mState; break;
+        case AL_SOURCE_TYPE: *value = src->mType; break;
+        case AL_LOOPING: *value = src->mLooping; break;
+        case AL_BUFFER:
+            *value = (src->mType == AL_STATIC) ? static_cast<ALint>(src->mQueue[0]) : 0;
+            break;
+        case AL_BUFFERS_QUEUED: *value = static_cast<ALint>(src->mQueue.size()); break;
+        case AL_BUFFERS_PROCESSED: *value = static_cast<ALint>(GetProcessed(*src)); break;
+        case AL_SAMPLE_OFFSET:
+            *value = static_cast<ALint>(GetSampleOffset(context, *src));
+            break;
+        default: *value = 0; break;
+    }
+}
+
+AL_API void AL_APIENTRY alGetSource3i(ALuint source, ALenum param, ALint *value1, ALint *value2, ALint *value3)
+{
+    MOCK_CALL(source, Hex{param}, Ptr{value1}, Ptr{value2}, Ptr{value3});
+    if(GetSource(GetContext(), source))
+        *value1 = *value2 = *value3 = 0;
+}
+
+AL_API void AL_APIENTRY alGetSourceiv(ALuint source, ALenum param, ALint *values)
+{
+    MOCK_CALL(source, Hex{param}, Ptr{values});
+    ALCcontext *context = GetContext();
+    MockSource *src = GetSource(context, source);
+    if(!src) return;
+    if(param == AL_POSITION || param == AL_VELOCITY || param == AL_DIRECTION)
+        std::fill_n(values, 3, 0);
+    else if(param == AL_ORIENTATION)
+        std::fill_n(values, 6, 0);
+    else
+        *values = 0;
+}
+
+AL_API void AL_APIENTRY alGetSourcei64vSOFT(ALuint source, ALenum param, ALint64SOFT *values)
+{
+    MOCK_CALL(source, Hex{param}, Ptr{values});
+    ALCcontext *context = GetContext();
+    MockSource *src = GetSource(context, source);
+    if(!src) return;
+    if(param == AL_SAMPLE_OFFSET_LATENCY_SOFT)
+    {
+        // 32.32 fixed-point offset, and the latency in nanoseconds.
+        values[0] = GetSampleOffset(context, *src) << 32;
+        values[1] = 0;
+    }
+    else
+        values[0] = 0;
+}
+
+AL_API void AL_APIENTRY alGetSourcedvSOFT(ALuint source, ALenum param, ALdouble *values)
+{
+    MOCK_CALL(source, Hex{param}, Ptr{values});
+    ALCcontext *context = GetContext();
+    MockSource *src = GetSource(context, source);
+    if(!src) return;
+    if(param == AL_SEC_OFFSET_LATENCY_SOFT)
+    {
+        values[0] = static_cast<double>(GetSampleOffset(context, *src)) /
+                    GetQueueFrequency(context, *src);
+        values[1] = 0.0;
+    }
+    else
+        values[0] = 0.0;
+}
+
+static void PlaySource(ALCcontext*, MockSource &source)
+{
+    if(source.mQueue.empty())
+    {
+        source.mState = AL_STOPPED;
+        return;
+    }
+    if(source.mState != AL_PAUSED)
+    {
+        source.mCurrent = 0;
+        source.mFrame = 0.0;
+    }
+    source.mState = AL_PLAYING;
+}
+
+static void StopSource(MockSource &source)
+{
+    if(source.mState == AL_INITIAL)
+        return;
+    source.mState = AL_STOPPED;
+    source.mCurrent = source.mQueue.size();
+    source.mFrame = 0.0;
+}
+
+static void RewindSource(MockSource &source)
+{
+    source.mState = AL_INITIAL;
+    source.mCurrent = 0;
+    source.mFrame = 0.0;
+}
+
+static void PauseSource(MockSource &source)
+{
+    if(source.mState == AL_PLAYING)
+        source.mState = AL_PAUSED;
+}
+
+// Applies a state change to a list of sources, only if all are valid.
+template<typename F>
+static void ForEachSource(ALsizei n, const ALuint *sources, F func)
+{
+    ALCcontext *context = GetContext();
+    if(!context) return;
+    if(n < 0) return SetError(context, AL_INVALID_VALUE);
+    for(ALsizei i = 0;i < n;++i)
+    {
+        if(context->mSources.find(sources[i]) == context->mSources.end())
+            return SetError(context, AL_INVALID_NAME);
+    }
+    for(ALsizei i = 0;i < n;++i)
+        func(context, context->mSources[sources[i]]);
+}
+
+AL_API void AL_APIENTRY alSourcePlayv(ALsizei n, const ALuint *sources)
+{
+    MOCK_CALL(n, MakeList(sources, n));
+    ForEachSource(n, sources, PlaySource);
+}
+
+AL_API void AL_APIENTRY alSourceStopv(ALsizei n, const ALuint *sources)
+{
+    MOCK_CALL(n, MakeList(sources, n));
+    ForEachSource(n, sources, [](ALCcontext*, MockSource &src) { StopSource(src); });
+}
+
+AL_API void AL_APIENTRY alSourceRewindv(ALsizei n, const ALuint *sources)
+{
+    MOCK_CALL(n, MakeList(sources, n));
+    ForEachSource(n, sources, [](ALCcontext*, MockSource &src) { RewindSource(src); });
+}
+
+AL_API void AL_APIENTRY alSourcePausev(ALsizei n, const ALuint *sources)
+{
+    MOCK_CALL(n, MakeList(sources, n));
+    ForEachSource(n, sources, [](ALCcontext*, MockSource &src) { PauseSource(src); });
+}
+
+AL_API void AL_APIENTRY alSourcePlay(ALuint source)
+{
+    MOCK_CALL(source);
+    ForEachSource(1, &source, PlaySource);
+}
+
+AL_API void AL_APIENTRY alSourceStop(ALuint source)
+{
+    MOCK_CALL(source);
+    ForEachSource(1, &source, [](ALCcontext*, MockSource &src) { StopSource(src); });
+}
+
+AL_API void AL_APIENTRY alSourceRewind(ALuint source)
+{
+    MOCK_CALL(source);
+    ForEachSource(1, &source, [](ALCcontext*, MockSource &src) { RewindSource(src); });
+}
+
+AL_API void AL_APIENTRY alSourcePause(ALuint source)
+{
+    MOCK_CALL(source);
+    ForEachSource(1, &source, [](ALCcontext*, MockSource &src) { PauseSource(src); });
+}
+
+AL_API void AL_APIENTRY alSourceQueueBuffers(ALuint source, ALsizei nb, const ALuint *buffers)
+{
+    MOCK_CALL(source, nb, MakeList(buffers, nb));
+    ALCcontext *context = GetContext();
+    MockSource *src = GetSource(context, source);
+    if(!src) return;
+    if(nb < 0) return SetError(context, AL_INVALID_VALUE);
+    if(src->mType == AL_STATIC) return SetError(context, AL_INVALID_OPERATION);
+    for(ALsizei i = 0;i < nb;++i)
+    {
+        if(buffers[i] && !GetBuffer(context, buffers[i]))
+            return;
+    }
+    src->mQueue.insert(src->mQueue.end(), buffers, buffers+nb);
+    if(!src->mQueue.empty())
+        src->mType = AL_STREAMING;
+}
+
+AL_API void AL_APIENTRY alSourceUnqueueBuffers(ALuint source, ALsizei nb, ALuint *buffers)
+{
+    MOCK_CALL(source, nb, Ptr{buffers});
+    ALCcontext *context = GetContext();
+    MockSource *src = GetSource(context, source);
+    if(!src) return;
+    if(nb < 0 || static_cast<size_t>(nb) > GetProcessed(*src))
+        return SetError(context, AL_INVALID_VALUE);
+
+    std::copy_n(src->mQueue.begin(), nb, buffers);
+    src->mQueue.erase(src->mQueue.begin(), src->mQueue.begin()+nb);
+    src->mCurrent -= std::min<size_t>(src->mCurrent, nb);
+    if(src->mQueue.empty())
+        src->mType = AL_UNDETERMINED;
+}
+
+
+/*** Buffers ***/
+
+AL_API void AL_APIENTRY alGenBuffers(ALsizei n, ALuint *buffers)
+{
+    MOCK_CALL(n, Ptr{buffers});
+    ALCcontext *context = GetContext();
+    if(!context) return;
+    if(n < 0) return SetError(context, AL_INVALID_VALUE);
+    ALCdevice *device = context->mDevice;
+    for(ALsizei i = 0;i < n;++i)
+    {
+        buffers[i] = device->mNextBuffer++;
+        device->mBuffers.emplace(buffers[i], MockBuffer());
+    }
+}
+
+AL_API void AL_APIENTRY alDeleteBuffers(ALsizei n, const ALuint *buffers)
+{
+    MOCK_CALL(n, MakeList(buffers, n));
+    ALCcontext *context = GetContext();
+    if(!context) return;
+    if(n < 0) return SetError(context, AL_INVALID_VALUE);
+    ALCdevice *device = context->mDevice;
+    for(ALsizei i = 0;i < n;++i)
+    {
+        if(buffers[i] && device->mBuffers.find(buffers[i]) == device->mBuffers.end())
+            return SetError(context, AL_INVALID_NAME);
+    }
+    // Buffers that are still queued on a source can't be deleted.
+    for(ALCcontext *ctx : gContexts)
+    {
+        if(ctx->mDevice != device) continue;
+        for(const auto &source : ctx->mSources)
+        {
+            for(ALuint id : source.second.mQueue)
+            {
+                if(std::find(buffers, buffers+n, id) != buffers+n)
+                    return SetError(context, AL_INVALID_OPERATION);
+            }
+        }
+    }
+    for(ALsizei i = 0;i < n;++i)
+        device->mBuffers.erase(buffers[i]);
+}
+
+AL_API ALboolean AL_APIENTRY alIsBuffer(ALuint buffer)
+{
+    MOCK_CALL(buffer);
+    ALCcontext *context = GetContext();
+    if(!context) return AL_FALSE;
+    return (buffer == 0 || context->mDevice->mBuffers.find(buffer) !=
+                           context->mDevice->mBuffers.end()) ? AL_TRUE : AL_FALSE;
+}
+
+AL_API void AL_APIENTRY alBufferData(ALuint buffer, ALenum format, const ALvoid *data, ALsizei size, ALsizei freq)
+{
+    MOCK_CALL(buffer, Hex{format}, Ptr{data}, size, freq);
+    ALCcontext *context = GetContext();
+    MockBuffer *buf = GetBuffer(context, buffer);
+    if(!buf) return;
+
+    const FormatInfo *info = GetFormatInfo(format);
+    if(!info) return SetError(context, AL_INVALID_ENUM);
+    if(size < 0 || freq < 1 || (size%(info->mChannels*info->mBits/8)) != 0)
+        return SetError(context, AL_INVALID_VALUE);
+
+    buf->mSize = size;
+    if(data)
+        buf->mData.assign(static_cast<const char*>(data), static_cast<const char*>(data)+size);
+    else
+        buf->mData.assign(size, 0);
+    buf->mChannels = info->mChannels;
+    buf->mBits = info->mBits;
+    buf->mFrequency = freq;
+    buf->mLoopStart = 0;
+    buf->mLoopEnd = buf->getFrames();
+}
+
+AL_API ALvoid AL_APIENTRY alBufferSubDataSOFT(ALuint buffer, ALenum format, const ALvoid *data, ALsizei offset, ALsizei length)
+{
+    MOCK_CALL(buffer, Hex{format}, Ptr{data}, offset, length);
+    ALCcontext *context = GetContext();
+    MockBuffer *buf = GetBuffer(context, buffer);
+    if(!buf) return;
+
+    const FormatInfo *info = GetFormatInfo(format);
+    if(!info) return SetError(context, AL_INVALID_ENUM);
+    if(info->mChannels != buf->mChannels || info->mBits != buf->mBits)
+        return SetError(context, AL_INVALID_ENUM);
+    const ALsizei frame_size = info->mChannels*info->mBits/8;
+    if(!data || offset < 0 || length < 0 || offset > buf->mSize ||
+       length > buf->mSize-offset || (offset%frame_size) != 0 || (length%frame_size) != 0)
+        return SetError(context, AL_INVALID_VALUE);
+    std::copy_n(static_cast<const char*>(data), length, buf->mData.begin()+offset);
+}
+
+AL_API void AL_APIENTRY alBufferf(ALuint buffer, ALenum param, ALfloat value)
+{
+    MOCK_CALL(buffer, Hex{param}, value);
+    GetBuffer(GetContext(), buffer);
+}
+
+AL_API void AL_APIENTRY alBuffer3f(ALuint buffer, ALenum param, ALfloat value1, ALfloat value2, ALfloat value3)
+{
+    MOCK_CALL(buffer, Hex{param}, value1, value2, value3);
+    GetBuffer(GetContext(), buffer);
+}
+
+AL_API void AL_APIENTRY alBufferfv(ALuint buffer, ALenum param, const ALfloat *values)
+{
+    MOCK_CALL(buffer, Hex{param}, Ptr{values});
+    GetBuffer(GetContext(), buffer);
+}
+
+AL_API void AL_APIENTRY alBufferi(ALuint buffer, ALenum param, ALint value)
+{
+    MOCK_CALL(buffer, Hex{param}, value);
+    GetBuffer(GetContext(), buffer);
+}
+
+AL_API void AL_APIENTRY alBuffer3i(ALuint buffer, ALenum param, ALint value1, ALint value2, ALint value3)
+{
+    MOCK_CALL(buffer, Hex{param}, value1, value2, value3);
+    GetBuffer(GetContext(), buffer);
+}
+
+AL_API void AL_APIENTRY alBufferiv(ALuint buffer, ALenum param, const ALint *values)
+{
+    MOCK_CALL(buffer, Hex{param}, MakeList(values, (param == AL_LOOP_POINTS_SOFT) ? 2 : 1));
+    ALCcontext *context = GetContext();
+    MockBuffer *buf = GetBuffer(context, buffer);
+    if(!buf) return;
+    if(param == AL_LOOP_POINTS_SOFT)
+    {
+        if(values[0] < 0 || values[0] >= values[1] || values[1] > buf->getFrames())
+            return SetError(context, AL_INVALID_VALUE);
+        buf->mLoopStart = values[0];
+        buf->mLoopEnd = values[1];
+    }
+}
+
+AL_API void AL_APIENTRY alGetBufferf(ALuint buffer, ALenum param, ALfloat *value)
+{
+    MOCK_CALL(buffer, Hex{param}, Ptr{value});
+    if(GetBuffer(GetContext(), buffer))
+        *value = 0.0f;
+}
+
+AL_API void AL_APIENTRY alGetBuffer3f(ALuint buffer, ALenum param, ALfloat *value1, ALfloat *value2, ALfloat *value3)
+{
+    MOCK_CALL(buffer, Hex{param}, Ptr{value1}, Ptr{value2}, Ptr{value3});
+    if(GetBuffer(GetContext(), buffer))
+        *value1 = *value2 = *value3 = 0.0f;
+}
+
+AL_API void AL_APIENTRY alGetBufferfv(ALuint buffer, ALenum param, ALfloat *values)
+{
+    MOCK_CALL(buffer, Hex{param}, Ptr{values});
+    if(GetBuffer(GetContext(), buffer))
+        *values = 0.0f;
+}
+
+AL_API void AL_APIENTRY alGetBufferi(ALuint buffer, ALenum param, ALint *value)
+{
+    MOCK_CALL(buffer, Hex{param}, Ptr{value});
+    MockBuffer *buf = GetBuffer(GetContext(), buffer);
+    if(!buf) return;
+    switch(param)
+    {
+        case AL_FREQUENCY: *value = buf->mFrequency; break;
+        case AL_BITS: *value = buf->mBits; break;
+        case AL_CHANNELS: *value = buf->mChannels; break;
+        case AL_SIZE: *value = buf->mSize; break;
+        default: *value = 0; break;
+    }
+}
+
+AL_API void AL_APIENTRY alGetBuffer3i(ALuint buffer, ALenum param, ALint *value1, ALint *value2, ALint *value3)
+{
+    MOCK_CALL(buffer, Hex{param}, Ptr{value1}, Ptr{value2}, Ptr{value3});
+    if(GetBuffer(GetContext(), buffer))
+        *value1 = *value2 = *value3 = 0;
+}
+
+AL_API void AL_APIENTRY alGetBufferiv(ALuint buffer, ALenum param, ALint *values)
+{
+    MOCK_CALL(buffer, Hex{param}, Ptr{values});
+    MockBuffer *buf = GetBuffer(GetContext(), buffer);
+    if(!buf) return;
+    if(param == AL_LOOP_POINTS_SOFT)
+    {
+        values[0] = buf->mLoopStart;
+        values[1] = buf->mLoopEnd;
+    }
+    else
+        *values = 0;
+}
+
+
+/*** EFX ***/
+
+// Effects, filters, and auxiliary effect slots only track their IDs, with
+// properties accepted and queries returning 0.
+#define DECL_EFX_OBJECT(Name, Names, member)                                  \
+AL_API ALvoid AL_APIENTRY alGen##Names(ALsizei n, ALuint *ids)                \
+{                                                                             \
+    MOCK_CALL(n, Ptr{ids});                                                   \
+    GenObjects(GetContext(), &ALCcontext::member, n, ids);                    \
+}                                                                             \
+AL_API ALvoid AL_APIENTRY alDelete##Names(ALsizei n, const ALuint *ids)       \
+{                                                                             \
+    MOCK_CALL(n, MakeList(ids, n));                                           \
+    DeleteObjects(GetContext(), &ALCcontext::member, n, ids);                 \
+}                                                                             \
+AL_API ALboolean AL_APIENTRY alIs##Name(ALuint id)                            \
+{                                                                             \
+    MOCK_CALL(id);                                                            \
+    return (id == 0 || IsObject(GetContext(), &ALCcontext::member, id)) ?     \
+           AL_TRUE : AL_FALSE;                                                \
+}                                                                             \
+AL_API ALvoid AL_APIENTRY al##Name##i(ALuint id, ALenum param, ALint value)   \
+{                                                                             \
+    MOCK_CALL(id, Hex{param}, value);                                         \
+    CheckObject(GetContext(), &ALCcontext::member, id);                       \
+}                                                                             \
+AL_API ALvoid AL_APIENTRY al##Name##iv(ALuint id, ALenum param, const ALint *values) \
+{                                                                             \
+    MOCK_CALL(id, Hex{param}, Ptr{values});                                   \
+    CheckObject(GetContext(), &ALCcontext::member, id);                       \
+}                                                                             \
+AL_API ALvoid AL_APIENTRY al##Name##f(ALuint id, ALenum param, ALfloat value) \
+{                                                                             \
+    MOCK_CALL(id, Hex{param}, value);                                         \
+    CheckObject(GetContext(), &ALCcontext::member, id);                       \
+}                                                                             \
+AL_API ALvoid AL_APIENTRY al##Name##fv(ALuint id, ALenum param, const ALfloat *values) \
+{                                                                             \
+    MOCK_CALL(id, Hex{param}, Ptr{values});                                   \
+    CheckObject(GetContext(), &ALCcontext::member, id);                       \
+}                                                                             \
+AL_API ALvoid AL_APIENTRY alGet##Name##i(ALuint id, ALenum param, ALint *value) \
+{                                                                             \
+    MOCK_CALL(id, Hex{param}, Ptr{value});                                    \
+    CheckObject(GetContext(), &ALCcontext::member, id);                       \
+    *value = 0;                                                               \
+}                                                                             \
+AL_API ALvoid AL_APIENTRY alGet##Name##iv(ALuint id, ALenum param, ALint *values) \
+{                                                                             \
+    MOCK_CALL(id, Hex{param}, Ptr{values});                                   \
+    CheckObject(GetContext(), &ALCcontext::member, id);                       \
+    *values = 0;                                                              \
+}                                                                             \
+AL_API ALvoid AL_APIENTRY alGet##Name##f(ALuint id, ALenum param, ALfloat *value) \
+{                                                                             \
+    MOCK_CALL(id, Hex{param}, Ptr{value});                                    \
+    CheckObject(GetContext(), &ALCcontext::member, id);                       \
+    *value = 0.0f;                                                            \
+}                                                                             \
+AL_API ALvoid AL_APIENTRY alGet##Name##fv(ALuint id, ALenum param, ALfloat *values) \
+{                                                                             \
+    MOCK_CALL(id, Hex{param}, Ptr{values});                                   \
+    CheckObject(GetContext(), &ALCcontext::member, id);                       \
+    *values = 0.0f;                                                           \
+}
+
+DECL_EFX_OBJECT(Effect, Effects, mEffects)
+DECL_EFX_OBJECT(Filter, Filters, mFilters)
+DECL_EFX_OBJECT(AuxiliaryEffectSlot, AuxiliaryEffectSlots, mSlots)
+
+#undef DECL_EFX_OBJECT
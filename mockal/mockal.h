@@ -0,0 +1,70 @@
+#ifndef MOCKAL_H
+#define MOCKAL_H
+
+#include <chrono>
+#include <string>
+#include <vector>
+#include <map>
+
+#ifndef MOCKAL_API
+ #if defined(_WIN32)
+  #define MOCKAL_API __declspec(dllimport)
+ #else
+  #define MOCKAL_API
+ #endif
+#endif
+
+/*
+ * A stand-in OpenAL implementation that records every AL and ALC call made to
+ * it. It keeps enough state for the library to work (object names, source
+ * states, buffer queues, and loopback rendering), but produces no sound, and
+ * sources only advance when a loopback device is rendered. These functions
+ * inspect and control the recording.
+ */
+namespace mockal {
+
+struct Call {
+    /** The name of the AL or ALC function. */
+    const char *mName;
+    /** The arguments, formatted as text. */
+    std::string mArgs;
+    /** When the call was made, relative to the last reset. */
+    std::chrono::nanoseconds mTime;
+};
+
+/** Clears the recorded calls, and restarts the time they're relative to. */
+MOCKAL_API void ResetCalls();
+
+/**
+ * Enables or disables recording. Calls made while disabled aren't recorded or
+ * counted. Recording is enabled by default.
+ */
+MOCKAL_API void SetRecording(bool enable);
+
+/** Retrieves the calls recorded since the last reset. */
+MOCKAL_API std::vector<Call> GetCalls();
+
+/** Retrieves the number of calls made to each function since the last reset. */
+MOCKAL_API std::map<std::string,size_t> GetCallCounts();
+
+/**
+ * Retrieves the number of calls made to the named function since the last
+ * reset, or to all functions if name is null.
+ */
+MOCKAL_API size_t GetCallCount(const char *name=nullptr);
+
+/**
+ * Retrieves the sample data last given to the named buffer of the current
+ * context's device, or an empty list if there's no such buffer.
+ */
+MOCKAL_API std::vector<char> GetBufferData(unsigned int buffer);
+
+/**
+ * Retrieves the buffers queued on the named source of the current context,
+ * from the first queued, or an empty list if there's no such source.
+ */
+MOCKAL_API std::vector<unsigned int> GetSourceQueue(unsigned int source);
+
+} // namespace mockal
+
+#endif /* MOCKAL_H */
@@ -0,0 +1,186 @@
+
+#include "config.h"
+
+#include "allocator.h"
+
+#include <algorithm>
+#include <cstdlib>
+#ifdef _WIN32
+#include <malloc.h>
+#endif
+
+namespace {
+
+// The default allocator, using the global operator new for fundamental
+// alignments, and the system's aligned allocation for anything larger.
+class DefaultMemoryAllocator final : public alure::MemoryAllocator {
+    void *allocate(size_t size, size_t alignment) noexcept override
+    {
+        if(alignment <= alignof(std::max_align_t))
+            return ::operator new(size, std::nothrow);
+#ifdef _WIN32
+        return _aligned_malloc(size, alignment);
+#else
+        void *ptr;
+        if(posix_memalign(&ptr, alignment, size) != 0)
+            return nullptr;
+        return ptr;
+#endif
+    }
+    void deallocate(void *ptr, size_t, size_t alignment) noexcept override
+    {
+        if(alignment <= alignof(std::max_align_t))
+            ::operator delete(ptr);
+        else
+        {
+#ifdef _WIN32
+            _aligned_free(ptr);
+#else
+            free(ptr);
+#endif
+        }
+    }
+};
+DefaultMemoryAllocator sDefaultAllocator;
+
+alure::UniquePtr<alure::MemoryAllocator> sAllocator;
+
+} // namespace
+
+namespace alure {
+
+MemoryAllocator::~MemoryAllocator() { }
+
+UniquePtr<MemoryAllocator> MemoryAllocator::set(UniquePtr<MemoryAllocator> allocator) noexcept
+{
+    sAllocator.swap(allocator);
+    return allocator;
+}
+
+MemoryAllocator &MemoryAllocator::get() noexcept
+{
+    MemoryAllocator *allocator = sAllocator.get();
+    if(allocator) return *allocator;
+    return sDefaultAllocator;
+}
+
+
+ArenaBuffer::~ArenaBuffer()
+{
+    if(mArena)
+        mArena->release(mData, mCapacity);
+}
+
+ArenaBuffer& ArenaBuffer::operator=(ArenaBuffer&& rhs) noexcept
+{
+    if(this != &rhs)
+    {
+        if(mArena)
+            mArena->release(mData, mCapacity);
+        mArena = rhs.mArena;
+        mData = rhs.mData;
+        mCapacity = rhs.mCapacity;
+        mSize = rhs.mSize;
+        rhs.mArena = nullptr;
+        rhs.mData = nullptr;
+        rhs.mCapacity = rhs.mSize = 0;
+    }
+    return *this;
+}
+
+
+constexpr size_t DecodeArena::Granularity;
+constexpr size_t DecodeArena::HugeGranularity;
+constexpr size_t DecodeArena::MaxFreeBytes;
+
+DecodeArena::~DecodeArena()
+{
+    MemoryAllocator &allocator = MemoryAllocator::get();
+    for(const Block &block : mFree)
+        allocator.deallocate(block.mData, block.mCapacity, getAlignment(block.mCapacity));
+    mFree.clear();
+    mFreeBytes = 0;
+    if(mLarge.mData)
+        allocator.deallocate(mLarge.mData, mLarge.mCapacity, getAlignment(mLarge.mCapacity));
+    mLarge = Block{nullptr, 0};
+}
+
+ArenaBuffer DecodeArena::acquire(size_t size)
+{
+    ArenaBuffer ret;
+    ret.mArena = this;
+    ret.mSize = size;
+
+    std::unique_lock<std::mutex> lock(mMutex);
+    // Use the smallest free block that fits. The free list is kept sorted by
+    // capacity.
+    auto iter = std::lower_bound(mFree.begin(), mFree.end(), size,
+        [](const Block &lhs, size_t rhs) -> bool
+        { return lhs.mCapacity < rhs; }
+    );
+    if(iter != mFree.end())
+    {
+        ret.mData = iter->mData;
+        ret.mCapacity = iter->mCapacity;
+        mFreeBytes -= iter->mCapacity;
+        mFree.erase(iter);
+        return ret;
+    }
+    // Only use the large block for sizes the free list couldn't hold, so it
+    // isn't tied up by something small.
+    if(size > MaxFreeBytes && mLarge.mCapacity >= size)
+    {
+        ret.mData = mLarge.mData;
+        ret.mCapacity = mLarge.mCapacity;
+        mLarge = Block{nullptr, 0};
+        return ret;
+    }
+    lock.unlock();
+
+    const size_t granularity = (size >= HugeGranularity) ? HugeGranularity : Granularity;
+    if(size > std::numeric_limits<size_t>::max() - granularity)
+        throw std::bad_alloc();
+    size_t capacity = std::max((size+granularity-1) / granularity * granularity, granularity);
+    void *ptr = MemoryAllocator::get().allocate(capacity, getAlignment(capacity));
+    if(!ptr) throw std::bad_alloc();
+    ret.mData = static_cast<ALbyte*>(ptr);
+    ret.mCapacity = capacity;
+    return ret;
+}
+
+void DecodeArena::release(ALbyte *data, size_t capacity) noexcept
+{
+    if(!data) return;
+
+    MemoryAllocator &allocator = MemoryAllocator::get();
+    std::unique_lock<std::mutex> lock(mMutex);
+    if(capacity > MaxFreeBytes)
+    {
+        // Keep the larger of this and the current large block.
+        Block old{data, capacity};
+        if(capacity > mLarge.mCapacity)
+            std::swap(old, mLarge);
+        lock.unlock();
+        if(old.mData)
+            allocator.deallocate(old.mData, old.mCapacity, getAlignment(old.mCapacity));
+        return;
+    }
+
+    // Make room by freeing the smallest blocks, since they're the least
+    // useful to keep.
+    while(!mFree.empty() && mFreeBytes+capacity > MaxFreeBytes)
+    {
+        allocator.deallocate(mFree.front().mData, mFree.front().mCapacity,
+                             getAlignment(mFree.front().mCapacity));
+        mFreeBytes -= mFree.front().mCapacity;
+        mFree.erase(mFree.begin());
+    }
+    auto iter = std::lower_bound(mFree.begin(), mFree.end(), capacity,
+        [](const Block &lhs, size_t rhs) -> bool
+        { return lhs.mCapacity < rhs; }
+    );
+    mFree.insert(iter, Block{data, capacity});
+    mFreeBytes += capacity;
+}
+
+} // namespace alure
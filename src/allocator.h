@@ -0,0 +1,129 @@
+#ifndef ALLOCATOR_H
+#define ALLOCATOR_H
+
+#include <cstddef>
+#include <limits>
+#include <mutex>
+#include <new>
+
+#include "main.h"
+
+namespace alure {
+
+/**
+ * A standard allocator using the MemoryAllocator set by the application, for
+ * containers holding audio data.
+ */
+template<typename T>
+struct HookAllocator {
+    using value_type = T;
+
+    HookAllocator() noexcept = default;
+    template<typename U>
+    HookAllocator(const HookAllocator<U>&) noexcept { }
+
+    T *allocate(size_t count)
+    {
+        if(count > std::numeric_limits<size_t>::max()/sizeof(T))
+            throw std::bad_alloc();
+        void *ptr = MemoryAllocator::get().allocate(count*sizeof(T), alignof(T));
+        if(!ptr) throw std::bad_alloc();
+        return static_cast<T*>(ptr);
+    }
+    void deallocate(T *ptr, size_t count) noexcept
+    { MemoryAllocator::get().deallocate(ptr, count*sizeof(T), alignof(T)); }
+};
+template<typename T, typename U>
+inline bool operator==(const HookAllocator<T>&, const HookAllocator<U>&) noexcept
+{ return true; }
+template<typename T, typename U>
+inline bool operator!=(const HookAllocator<T>&, const HookAllocator<U>&) noexcept
+{ return false; }
+
+/** A Vector of audio data, allocated with the MemoryAllocator. */
+template<typename T>
+using HookVector = Vector<T, HookAllocator<T>>;
+
+
+class DecodeArena;
+
+/**
+ * A block of memory from a DecodeArena, given back to it when destroyed. The
+ * contents are uninitialized.
+ */
+class ArenaBuffer {
+    DecodeArena *mArena{nullptr};
+    ALbyte *mData{nullptr};
+    size_t mCapacity{0};
+    size_t mSize{0};
+
+    friend class DecodeArena;
+
+public:
+    ArenaBuffer() noexcept = default;
+    ArenaBuffer(ArenaBuffer&& rhs) noexcept
+      : mArena(rhs.mArena), mData(rhs.mData), mCapacity(rhs.mCapacity), mSize(rhs.mSize)
+    { rhs.mArena = nullptr; rhs.mData = nullptr; rhs.mCapacity = rhs.mSize = 0; }
+    ~ArenaBuffer();
+
+    ArenaBuffer& operator=(ArenaBuffer&& rhs) noexcept;
+
+    ALbyte *data() noexcept { return mData; }
+    const ALbyte *data() const noexcept { return mData; }
+    size_t size() const noexcept { return mSize; }
+
+    /** Shrinks the used size. Can't grow past the size it was acquired with. */
+    void shrink(size_t size) noexcept { if(size < mSize) mSize = size; }
+
+    ArrayView<ALbyte> view() const noexcept { return ArrayView<ALbyte>(mData, mSize); }
+};
+
+/**
+ * Keeps the blocks used to decode buffers around to be reused, so loading a
+ * buffer doesn't need a new allocation for its samples each time. Blocks come
+ * from the MemoryAllocator, and up to MaxFreeBytes worth are kept while
+ * unused, along with the largest block bigger than that. It's safe to use
+ * from multiple threads.
+ */
+class DecodeArena {
+    struct Block {
+        ALbyte *mData;
+        size_t mCapacity;
+    };
+
+    // Sizes are rounded up to this, so blocks are more likely to be reused
+    // for buffers of slightly different lengths. Large blocks are rounded to
+    // and aligned to the common huge page size instead, so the system can
+    // back them with huge pages.
+    static constexpr size_t Granularity = 64*1024;
+    static constexpr size_t HugeGranularity = 2*1024*1024;
+    static constexpr size_t MaxFreeBytes = 16*1024*1024;
+
+    std::mutex mMutex;
+    Vector<Block> mFree;
+    size_t mFreeBytes{0};
+    // A free block too big for the free list, kept so repeatedly loading a
+    // long sound doesn't allocate it anew each time.
+    Block mLarge{nullptr, 0};
+
+    static size_t getAlignment(size_t capacity) noexcept
+    { return (capacity >= HugeGranularity) ? HugeGranularity : alignof(std::max_align_t); }
+
+    void release(ALbyte *data, size_t capacity) noexcept;
+
+    friend class ArenaBuffer;
+
+public:
+    DecodeArena() { mFree.reserve(MaxFreeBytes / Granularity); }
+    DecodeArena(const DecodeArena&) = delete;
+    ~DecodeArena();
+
+    DecodeArena& operator=(const DecodeArena&) = delete;
+
+    /** Gets a block of at least the given size. Throws if out of memory. */
+    ArenaBuffer acquire(size_t size);
+};
+
+} // namespace alure
+
+#endif /* ALLOCATOR_H */
@@ -5,13 +5,21 @@
 
 #include <stdexcept>
 #include <cstring>
+#include <cstdlib>
+#include <limits>
 
 #include "context.h"
+#include "pcmcache.h"
+#include "resampler.h"
+#include "sampleconv.h"
+#include "trace.h"
 
 namespace {
 
 using alure::Array;
 using alure::ArrayView;
+using alure::Vector;
+using alure::HookVector;
 using alure::ChannelConfig;
 using alure::SampleType;
 using alure::AL;
@@ -76,10 +84,564 @@ const struct {
     { SampleType::Mulaw, AL::EXT_MULAW, MulawFormats },
 };
 
+
+// Gets the decoded samples as 16-bit, for encoding.
+HookVector<int16_t> GetShortSamples(ArrayView<ALbyte> data, SampleType type)
+{
+    HookVector<int16_t> out;
+    switch(type)
+    {
+    case SampleType::UInt8:
+        out.resize(data.size());
+        alure::ConvertU8ToS16(out.data(), reinterpret_cast<const uint8_t*>(data.data()),
+                              out.size());
+        break;
+    case SampleType::Int16:
+        out.resize(data.size() / sizeof(int16_t));
+        std::memcpy(out.data(), data.data(), out.size()*sizeof(int16_t));
+        break;
+    case SampleType::Float32:
+        out.resize(data.size() / sizeof(float));
+        alure::ConvertF32ToS16(out.data(), reinterpret_cast<const float*>(data.data()),
+                               out.size());
+        break;
+    case SampleType::Mulaw:
+        out.resize(data.size());
+        alure::DecodeMulaw(out.data(), reinterpret_cast<const uint8_t*>(data.data()),
+                           out.size());
+        break;
+    }
+    return out;
+}
+
+
+// Gets the samples as float, for format conversion.
+HookVector<float> GetFloatSamples(ArrayView<ALbyte> data, SampleType type)
+{
+    HookVector<float> out;
+    if(type == SampleType::Float32)
+    {
+        out.resize(data.size() / sizeof(float));
+        std::memcpy(out.data(), data.data(), out.size()*sizeof(float));
+    }
+    else
+    {
+        HookVector<int16_t> samples = GetShortSamples(data, type);
+        out.resize(samples.size());
+        alure::ConvertS16ToF32(out.data(), samples.data(), out.size());
+    }
+    return out;
+}
+
+HookVector<ALbyte> PutFloatSamples(const HookVector<float> &samples, SampleType type)
+{
+    HookVector<ALbyte> out;
+    if(type == SampleType::Float32)
+    {
+        out.resize(samples.size() * sizeof(float));
+        std::memcpy(out.data(), samples.data(), out.size());
+        return out;
+    }
+
+    HookVector<int16_t> shorts(samples.size());
+    alure::ConvertF32ToS16(shorts.data(), samples.data(), shorts.size());
+    switch(type)
+    {
+    case SampleType::UInt8:
+        out.resize(shorts.size());
+        for(size_t i = 0;i < shorts.size();++i)
+            out[i] = static_cast<ALbyte>((shorts[i]>>8) ^ -128);
+        break;
+    case SampleType::Int16:
+        out.resize(shorts.size() * sizeof(int16_t));
+        std::memcpy(out.data(), shorts.data(), out.size());
+        break;
+    case SampleType::Mulaw:
+        out.resize(shorts.size());
+        alure::EncodeMulaw(reinterpret_cast<uint8_t*>(out.data()), shorts.data(), shorts.size());
+        break;
+    case SampleType::Float32:
+        break;
+    }
+    return out;
+}
+
+
+constexpr float Sqrt1_2{0.707106781f};
+
+// Downmix gains, as the output channel gains for each input channel (both in
+// OpenAL's channel order). LFE is dropped when downmixing away from a format
+// with it, and B-Format is decoded to stereo with a pair of virtual cardioids.
+struct DownmixEntry {
+    ChannelConfig mFrom;
+    ChannelConfig mTo;
+    Array<Array<float,8>,8> mGains;
+};
+// NOTE: Entries for a given source configuration are in order of preference.
+const DownmixEntry DownmixTable[]{
+    { ChannelConfig::Rear, ChannelConfig::Stereo, {{
+        {{ 1.0f, 0.0f }},
+        {{ 0.0f, 1.0f }},
+    }} },
+    { ChannelConfig::Quad, ChannelConfig::Stereo, {{
+        {{ 1.0f, 0.0f, Sqrt1_2, 0.0f }},
+        {{ 0.0f, 1.0f, 0.0f, Sqrt1_2 }},
+    }} },
+    { ChannelConfig::X51, ChannelConfig::Quad, {{
+        {{ 1.0f, 0.0f, Sqrt1_2, 0.0f, 0.0f, 0.0f }},
+        {{ 0.0f, 1.0f, Sqrt1_2, 0.0f, 0.0f, 0.0f }},
+        {{ 0.0f, 0.0f, 0.0f, 0.0f, 1.0f, 0.0f }},
+        {{ 0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 1.0f }},
+    }} },
+    { ChannelConfig::X51, ChannelConfig::Stereo, {{
+        {{ 1.0f, 0.0f, Sqrt1_2, 0.0f, Sqrt1_2, 0.0f }},
+        {{ 0.0f, 1.0f, Sqrt1_2, 0.0f, 0.0f, Sqrt1_2 }},
+    }} },
+    { ChannelConfig::X61, ChannelConfig::X51, {{
+        {{ 1.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f }},
+        {{ 0.0f, 1.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f }},
+        {{ 0.0f, 0.0f, 1.0f, 0.0f, 0.0f, 0.0f, 0.0f }},
+        {{ 0.0f, 0.0f, 0.0f, 1.0f, 0.0f, 0.0f, 0.0f }},
+        {{ 0.0f, 0.0f, 0.0f, 0.0f, Sqrt1_2, 1.0f, 0.0f }},
+        {{ 0.0f, 0.0f, 0.0f, 0.0f, Sqrt1_2, 0.0f, 1.0f }},
+    }} },
+    { ChannelConfig::X61, ChannelConfig::Quad, {{
+        {{ 1.0f, 0.0f, Sqrt1_2, 0.0f, 0.0f, 0.0f, 0.0f }},
+        {{ 0.0f, 1.0f, Sqrt1_2, 0.0f, 0.0f, 0.0f, 0.0f }},
+        {{ 0.0f, 0.0f, 0.0f, 0.0f, Sqrt1_2, 1.0f, 0.0f }},
+        {{ 0.0f, 0.0f, 0.0f, 0.0f, Sqrt1_2, 0.0f, 1.0f }},
+    }} },
+    { ChannelConfig::X61, ChannelConfig::Stereo, {{
+        {{ 1.0f, 0.0f, Sqrt1_2, 0.0f, 0.5f, Sqrt1_2, 0.0f }},
+        {{ 0.0f, 1.0f, Sqrt1_2, 0.0f, 0.5f, 0.0f, Sqrt1_2 }},
+    }} },
+    { ChannelConfig::X71, ChannelConfig::X51, {{
+        {{ 1.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f }},
+        {{ 0.0f, 1.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f }},
+        {{ 0.0f, 0.0f, 1.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f }},
+        {{ 0.0f, 0.0f, 0.0f, 1.0f, 0.0f, 0.0f, 0.0f, 0.0f }},
+        {{ 0.0f, 0.0f, 0.0f, 0.0f, Sqrt1_2, 0.0f, 1.0f, 0.0f }},
+        {{ 0.0f, 0.0f, 0.0f, 0.0f, 0.0f, Sqrt1_2, 0.0f, 1.0f }},
+    }} },
+    { ChannelConfig::X71, ChannelConfig::Quad, {{
+        {{ 1.0f, 0.0f, Sqrt1_2, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f }},
+        {{ 0.0f, 1.0f, Sqrt1_2, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f }},
+        {{ 0.0f, 0.0f, 0.0f, 0.0f, 1.0f, 0.0f, Sqrt1_2, 0.0f }},
+        {{ 0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 1.0f, 0.0f, Sqrt1_2 }},
+    }} },
+    { ChannelConfig::X71, ChannelConfig::Stereo, {{
+        {{ 1.0f, 0.0f, Sqrt1_2, 0.0f, Sqrt1_2, 0.0f, Sqrt1_2, 0.0f }},
+        {{ 0.0f, 1.0f, Sqrt1_2, 0.0f, 0.0f, Sqrt1_2, 0.0f, Sqrt1_2 }},
+    }} },
+    { ChannelConfig::BFormat2D, ChannelConfig::Stereo, {{
+        {{ Sqrt1_2, 0.0f,  0.5f }},
+        {{ Sqrt1_2, 0.0f, -0.5f }},
+    }} },
+    { ChannelConfig::BFormat3D, ChannelConfig::Stereo, {{
+        {{ Sqrt1_2, 0.0f,  0.5f, 0.0f }},
+        {{ Sqrt1_2, 0.0f, -0.5f, 0.0f }},
+    }} },
+
+    // Mono downmixes, for sounds to be spatialized. These average the stereo
+    // downmix's channels, and are never picked as a fallback since mono and
+    // stereo are both always supported.
+    { ChannelConfig::Stereo, ChannelConfig::Mono, {{
+        {{ 0.5f, 0.5f }},
+    }} },
+    { ChannelConfig::Rear, ChannelConfig::Mono, {{
+        {{ 0.5f, 0.5f }},
+    }} },
+    { ChannelConfig::Quad, ChannelConfig::Mono, {{
+        {{ 0.5f, 0.5f, 0.5f*Sqrt1_2, 0.5f*Sqrt1_2 }},
+    }} },
+    { ChannelConfig::X51, ChannelConfig::Mono, {{
+        {{ 0.5f, 0.5f, Sqrt1_2, 0.0f, 0.5f*Sqrt1_2, 0.5f*Sqrt1_2 }},
+    }} },
+    { ChannelConfig::X61, ChannelConfig::Mono, {{
+        {{ 0.5f, 0.5f, Sqrt1_2, 0.0f, 0.5f, 0.5f*Sqrt1_2, 0.5f*Sqrt1_2 }},
+    }} },
+    { ChannelConfig::X71, ChannelConfig::Mono, {{
+        {{ 0.5f, 0.5f, Sqrt1_2, 0.0f, 0.5f*Sqrt1_2, 0.5f*Sqrt1_2, 0.5f*Sqrt1_2,
+           0.5f*Sqrt1_2 }},
+    }} },
+    { ChannelConfig::BFormat2D, ChannelConfig::Mono, {{
+        {{ Sqrt1_2, 0.0f, 0.0f }},
+    }} },
+    { ChannelConfig::BFormat3D, ChannelConfig::Mono, {{
+        {{ Sqrt1_2, 0.0f, 0.0f, 0.0f }},
+    }} },
+};
+
+const DownmixEntry *FindDownmix(ChannelConfig from, ChannelConfig to)
+{
+    for(const DownmixEntry &entry : DownmixTable)
+    {
+        if(entry.mFrom == from && entry.mTo == to)
+            return &entry;
+    }
+    return nullptr;
+}
+
+HookVector<float> DownmixSamples(const HookVector<float> &samples, const DownmixEntry &downmix)
+{
+    const size_t inchans = alure::FramesToBytes(1, downmix.mFrom, SampleType::UInt8);
+    const size_t outchans = alure::FramesToBytes(1, downmix.mTo, SampleType::UInt8);
+    const size_t frames = samples.size() / inchans;
+
+    HookVector<float> inplanar(frames * inchans);
+    Array<float*,8> inptrs;
+    for(size_t c = 0;c < inchans;++c)
+        inptrs[c] = &inplanar[c*frames];
+    alure::DeinterleaveF32(inptrs.data(), samples.data(), inchans, frames);
+
+    HookVector<float> outplanar(frames * outchans, 0.0f);
+    Array<const float*,8> outptrs;
+    for(size_t o = 0;o < outchans;++o)
+    {
+        float *out = &outplanar[o*frames];
+        for(size_t c = 0;c < inchans;++c)
+        {
+            float gain = downmix.mGains[o][c];
+            if(gain != 0.0f) alure::MixF32(out, inptrs[c], frames, gain);
+        }
+        outptrs[o] = out;
+    }
+
+    HookVector<float> out(frames * outchans);
+    alure::InterleaveF32(out.data(), outptrs.data(), outchans, frames);
+    return out;
+}
+
+
+// MS-ADPCM block layout, using OpenAL Soft's default block alignment.
+constexpr ALsizei MSADPCMBlockFrames{64};
+constexpr ALsizei MSADPCMBlockBytes{7 + (MSADPCMBlockFrames-2)/2};
+
+struct MSADPCMChannel {
+    int mCoeffIdx;
+    int mDelta;
+    int mSample1, mSample2;
+};
+
+// Encodes one sample, updating the channel state and returning the nibble.
+int EncodeMSADPCMSample(MSADPCMChannel &chan, int sample)
+{
+    const int *coeffs = alure::MSADPCMCoeffs[chan.mCoeffIdx];
+    int predicted = (chan.mSample1*coeffs[0] + chan.mSample2*coeffs[1]) / 256;
+
+    int err = sample - predicted;
+    int nibble = (err >= 0) ? (err + chan.mDelta/2) / chan.mDelta :
+                              (err - chan.mDelta/2) / chan.mDelta;
+    nibble = std::min(std::max(nibble, -8), 7);
+
+    int decoded = std::min(std::max(predicted + nibble*chan.mDelta, -32768), 32767);
+    chan.mSample2 = chan.mSample1;
+    chan.mSample1 = decoded;
+    chan.mDelta = std::max(alure::MSADPCMAdaption[nibble&0x0f] * chan.mDelta / 256, 16);
+    return nibble & 0x0f;
+}
+
+// Picks the predictor for a channel in a block that gives the least error.
+MSADPCMChannel SetupMSADPCMChannel(const int16_t *samples, int step)
+{
+    // Start each predictor with a delta based on its first few prediction
+    // errors.
+    int32_t deltas[7];
+    for(int c = 0;c < 7;++c)
+    {
+        int delta = 0;
+        for(int i = 2;i < 5;++i)
+        {
+            int predicted = (samples[(i-1)*step]*alure::MSADPCMCoeffs[c][0] +
+                             samples[(i-2)*step]*alure::MSADPCMCoeffs[c][1]) / 256;
+            delta += std::abs(samples[i*step] - predicted);
+        }
+        deltas[c] = std::max(delta / 12, 16);
+    }
+
+    // Trial encode the block with all of them at once.
+    uint32_t errors[7];
+    alure::MSADPCMTrialErrors(errors, samples, static_cast<size_t>(step), MSADPCMBlockFrames,
+                              deltas);
+    int best = 0;
+    for(int c = 1;c < 7;++c)
+    {
+        if(errors[c] < errors[best])
+            best = c;
+    }
+    return MSADPCMChannel{best, deltas[best], samples[step], samples[0]};
+}
+
+void PutLE16(HookVector<ALbyte> &out, int val)
+{
+    out.push_back(static_cast<ALbyte>(val&0xff));
+    out.push_back(static_cast<ALbyte>((val>>8)&0xff));
+}
+
+// Encodes a block of interleaved 16-bit samples for 1 or 2 channels.
+void EncodeMSADPCMBlock(HookVector<ALbyte> &out, const int16_t *samples, int numchans)
+{
+    MSADPCMChannel chans[2];
+    for(int c = 0;c < numchans;++c)
+        chans[c] = SetupMSADPCMChannel(samples+c, numchans);
+
+    for(int c = 0;c < numchans;++c)
+        out.push_back(static_cast<ALbyte>(chans[c].mCoeffIdx));
+    for(int c = 0;c < numchans;++c)
+        PutLE16(out, chans[c].mDelta);
+    for(int c = 0;c < numchans;++c)
+        PutLE16(out, chans[c].mSample1);
+    for(int c = 0;c < numchans;++c)
+        PutLE16(out, chans[c].mSample2);
+
+    // Nibbles are interleaved by channel, high nibble first.
+    int total = (MSADPCMBlockFrames-2) * numchans;
+    const int16_t *src = samples + 2*numchans;
+    for(int i = 0;i < total;i += 2)
+    {
+        int hi = EncodeMSADPCMSample(chans[i%numchans], src[i]);
+        int lo = EncodeMSADPCMSample(chans[(i+1)%numchans], src[i+1]);
+        out.push_back(static_cast<ALbyte>((hi<<4) | lo));
+    }
+}
+
+
+constexpr uint64_t XXH64Prime1{11400714785074694791ull};
+constexpr uint64_t XXH64Prime2{14029467366897019727ull};
+constexpr uint64_t XXH64Prime3{1609587929392839161ull};
+constexpr uint64_t XXH64Prime4{9650029242287828579ull};
+constexpr uint64_t XXH64Prime5{2870177450012600261ull};
+
+inline uint64_t RotL64(uint64_t val, int bits) { return (val<<bits) | (val>>(64-bits)); }
+
+inline uint64_t Read64(const ALbyte *ptr)
+{
+    uint64_t val;
+    std::memcpy(&val, ptr, sizeof(val));
+    return val;
+}
+inline uint32_t Read32(const ALbyte *ptr)
+{
+    uint32_t val;
+    std::memcpy(&val, ptr, sizeof(val));
+    return val;
+}
+
+inline uint64_t XXH64Round(uint64_t acc, uint64_t input)
+{
+    acc += input * XXH64Prime2;
+    return RotL64(acc, 31) * XXH64Prime1;
+}
+
+inline uint64_t XXH64Merge(uint64_t acc, uint64_t val)
+{
+    acc ^= XXH64Round(0, val);
+    return acc*XXH64Prime1 + XXH64Prime4;
+}
+
+
+// The byte value of silence for samples of the given type.
+ALbyte GetSilence(alure::SampleType type)
+{
+    if(type == alure::SampleType::UInt8) return -128;
+    if(type == alure::SampleType::Mulaw) return 127;
+    return 0;
+}
+
 } // namespace
 
 namespace alure {
 
+uint64_t HashBufferData(ArrayView<ALbyte> data)
+{
+    const ALbyte *ptr = data.data();
+    const ALbyte *const end = ptr + data.size();
+    uint64_t hash;
+
+    if(data.size() >= 32)
+    {
+        uint64_t v1 = XXH64Prime1 + XXH64Prime2;
+        uint64_t v2 = XXH64Prime2;
+        uint64_t v3 = 0;
+        uint64_t v4 = 0 - XXH64Prime1;
+        do {
+            v1 = XXH64Round(v1, Read64(ptr));
+            v2 = XXH64Round(v2, Read64(ptr+8));
+            v3 = XXH64Round(v3, Read64(ptr+16));
+            v4 = XXH64Round(v4, Read64(ptr+24));
+            ptr += 32;
+        } while(end-ptr >= 32);
+
+        hash = RotL64(v1, 1) + RotL64(v2, 7) + RotL64(v3, 12) + RotL64(v4, 18);
+        hash = XXH64Merge(hash, v1);
+        hash = XXH64Merge(hash, v2);
+        hash = XXH64Merge(hash, v3);
+        hash = XXH64Merge(hash, v4);
+    }
+    else
+        hash = XXH64Prime5;
+    hash += data.size();
+
+    for(;end-ptr >= 8;ptr += 8)
+    {
+        hash ^= XXH64Round(0, Read64(ptr));
+        hash = RotL64(hash, 27)*XXH64Prime1 + XXH64Prime4;
+    }
+    if(end-ptr >= 4)
+    {
+        hash ^= uint64_t{Read32(ptr)} * XXH64Prime1;
+        hash = RotL64(hash, 23)*XXH64Prime2 + XXH64Prime3;
+        ptr += 4;
+    }
+    for(;ptr != end;++ptr)
+    {
+        hash ^= uint64_t{static_cast<uint8_t>(*ptr)} * XXH64Prime5;
+        hash = RotL64(hash, 11) * XXH64Prime1;
+    }
+
+    hash ^= hash >> 33;
+    hash *= XXH64Prime2;
+    hash ^= hash >> 29;
+    hash *= XXH64Prime3;
+    hash ^= hash >> 32;
+    return hash;
+}
+
+HookVector<ALbyte> ConvertFormatData(ArrayView<ALbyte> data, ChannelConfig srcchans,
+                                     SampleType srctype, ChannelConfig dstchans,
+                                     SampleType dsttype)
+{
+    if(srcchans == dstchans)
+    {
+        if(srctype == dsttype)
+            return HookVector<ALbyte>(data.begin(), data.end());
+        if(srctype == SampleType::Float32 && dsttype == SampleType::Int16)
+        {
+            size_t numsamples = data.size() / sizeof(float);
+            HookVector<ALbyte> out(numsamples * sizeof(int16_t));
+            ConvertF32ToS16(reinterpret_cast<int16_t*>(out.data()),
+                            reinterpret_cast<const float*>(data.data()), numsamples);
+            return out;
+        }
+        return PutFloatSamples(GetFloatSamples(data, srctype), dsttype);
+    }
+
+    const DownmixEntry *downmix = FindDownmix(srcchans, dstchans);
+    if(!downmix)
+        throw std::runtime_error(String("Unsupported channel conversion (")+
+            GetChannelConfigName(srcchans)+" to "+GetChannelConfigName(dstchans)+")");
+    return PutFloatSamples(DownmixSamples(GetFloatSamples(data, srctype), *downmix), dsttype);
+}
+
+HookVector<ALbyte> ResampleFormatData(ArrayView<ALbyte> data, ChannelConfig chans,
+                                      SampleType type, ALuint srcrate, ALuint dstrate)
+{
+    const size_t numchans = FramesToBytes(1, chans, SampleType::UInt8);
+    return PutFloatSamples(
+        ResampleSamples(GetFloatSamples(data, type), numchans, srcrate, dstrate), type
+    );
+}
+
+std::pair<uint64_t,uint64_t> ScaleLoopPoints(std::pair<uint64_t,uint64_t> loop_pts,
+                                             ALuint srcrate, ALuint dstrate, ALuint frames)
+{
+    loop_pts.first = (loop_pts.first*dstrate + srcrate/2) / srcrate;
+    loop_pts.second = std::min<uint64_t>((loop_pts.second*dstrate + srcrate/2) / srcrate, frames);
+    if(loop_pts.first >= loop_pts.second)
+        loop_pts = std::make_pair(0, frames);
+    return loop_pts;
+}
+
+std::pair<uint64_t,uint64_t> ClampLoopPoints(std::pair<uint64_t,uint64_t> loop_pts,
+                                             ALuint frames)
+{
+    if(loop_pts.first >= loop_pts.second)
+        return std::make_pair(0, frames);
+    loop_pts.second = std::min<uint64_t>(loop_pts.second, frames);
+    loop_pts.first = std::min<uint64_t>(loop_pts.first, loop_pts.second-1);
+    return loop_pts;
+}
+
+ALenum GetFallbackFormat(ChannelConfig &chans, SampleType &type)
+{
+    ALenum format = GetFormat(chans, type);
+    if(format != AL_NONE) return format;
+
+    // 16-bit is always available, so try it before changing the channels.
+    format = GetFormat(chans, SampleType::Int16);
+    if(format != AL_NONE)
+    {
+        type = SampleType::Int16;
+        return format;
+    }
+
+    for(const DownmixEntry &entry : DownmixTable)
+    {
+        if(entry.mFrom != chans)
+            continue;
+        format = GetFormat(entry.mTo, type);
+        if(format != AL_NONE)
+        {
+            chans = entry.mTo;
+            return format;
+        }
+        format = GetFormat(entry.mTo, SampleType::Int16);
+        if(format != AL_NONE)
+        {
+            chans = entry.mTo;
+            type = SampleType::Int16;
+            return format;
+        }
+    }
+    return AL_NONE;
+}
+
+ALenum EncodeBufferData(ArrayView<ALbyte> data, HookVector<ALbyte> &out, ChannelConfig chans,
+                        SampleType type, BufferStorage storage, const ContextImpl &ctx,
+                        ALsizei &block_frames)
+{
+    block_frames = 0;
+    if(storage == BufferStorage::Native || type == SampleType::Mulaw)
+        return AL_NONE;
+
+    ALuint numchans = FramesToBytes(1, chans, SampleType::UInt8);
+    size_t numsamples = data.size() / FramesToBytes(1, ChannelConfig::Mono, type);
+    if(storage == BufferStorage::Mulaw)
+    {
+        ALenum format = GetFormat(chans, SampleType::Mulaw);
+        if(format == AL_NONE) return AL_NONE;
+
+        HookVector<int16_t> samples = GetShortSamples(data, type);
+        out.resize(numsamples);
+        EncodeMulaw(reinterpret_cast<uint8_t*>(out.data()), samples.data(), numsamples);
+        return format;
+    }
+
+    if(storage == BufferStorage::MSADPCM)
+    {
+        if(!ctx.hasExtension(AL::SOFT_MSADPCM) || numchans > 2)
+            return AL_NONE;
+
+        size_t frames = numsamples / numchans;
+        size_t numblocks = (frames + MSADPCMBlockFrames-1) / MSADPCMBlockFrames;
+
+        // Pad the last block with silence.
+        HookVector<int16_t> samples = GetShortSamples(data, type);
+        samples.resize(numblocks * MSADPCMBlockFrames * numchans, 0);
+
+        out.clear();
+        out.reserve(numblocks * MSADPCMBlockBytes * numchans);
+        for(size_t b = 0;b < numblocks;++b)
+            EncodeMSADPCMBlock(out, &samples[b * MSADPCMBlockFrames * numchans],
+                               static_cast<int>(numchans));
+
+        block_frames = MSADPCMBlockFrames;
+        return (numchans == 1) ? AL_FORMAT_MONO_MSADPCM_SOFT : AL_FORMAT_STEREO_MSADPCM_SOFT;
+    }
+
+    return AL_NONE;
+}
+
 void BufferImpl::cleanup()
 {
     alGetError();
@@ -110,44 +672,203 @@ void BufferImpl::cleanup()
         alGetError();
     }
 
-    alDeleteBuffers(1, &mId);
-    throw_al_error("Buffer failed to delete");
+    if(mContext.releaseBufferId(mId, mDataHash))
+    {
+        alDeleteBuffers(1, &mId);
+        throw_al_error("Buffer failed to delete");
+        mContext.getStats().mBufferMemory.fetch_sub(mDataSize, std::memory_order_relaxed);
+    }
     mId = 0;
 }
 
 
+ALuint UploadBufferChunked(ContextImpl &ctx, StringView name, ALuint bid, ALenum format,
+                           ALuint srate, ChannelConfig chans, SampleType type,
+                           Decoder &decoder, ALuint frames)
+{
+    const ALuint frame_size = FramesToBytes(1, chans, type);
+    const ALuint chunk_frames = std::max<ALuint>(UploadChunkSize / frame_size, 1);
+    ArenaBuffer staging = ctx.getDecodeArena().acquire(
+        FramesToBytes(std::min(frames, chunk_frames), chans, type)
+    );
+
+    // Allocate the buffer's storage up front, then fill it in.
+    alBufferData(bid, format, nullptr, static_cast<ALsizei>(FramesToBytes(frames, chans, type)),
+                 srate);
+
+    std::chrono::steady_clock::duration decode_time{};
+    ALuint total = 0;
+    while(total < frames)
+    {
+        ALuint todo = std::min(frames-total, chunk_frames);
+        auto start = std::chrono::steady_clock::now();
+        ALuint got;
+        {
+            TraceSpan span("Decoder::read");
+            got = decoder.read(staging.data(), todo);
+        }
+        decode_time += std::chrono::steady_clock::now() - start;
+        if(got == 0) break;
+
+        ctx.send(&MessageHandler::bufferLoading, name, chans, type, srate,
+                 ArrayView<ALbyte>(staging.data(), got*frame_size));
+        ctx.alBufferSubDataSOFT(bid, format, staging.data(),
+            static_cast<ALsizei>(total*frame_size), static_cast<ALsizei>(got*frame_size)
+        );
+        total += got;
+        if(got < todo) break;
+    }
+    ContextStats &stats = ctx.getStats();
+    stats.addDecode(stats.mBufferDecodeTimes, decode_time, FramesToBytes(total, chans, type));
+    return total;
+}
+
+void SilenceBufferChunked(ContextImpl &ctx, ALuint bid, ALenum format, ChannelConfig chans,
+                          SampleType type, ALuint start, ALuint end)
+{
+    if(start >= end) return;
+
+    const ALuint frame_size = FramesToBytes(1, chans, type);
+    const ALuint chunk_frames = std::max<ALuint>(UploadChunkSize / frame_size, 1);
+    ArenaBuffer staging = ctx.getDecodeArena().acquire(
+        FramesToBytes(std::min(end-start, chunk_frames), chans, type)
+    );
+    std::fill_n(staging.data(), staging.size(), GetSilence(type));
+    while(start < end)
+    {
+        ALuint todo = std::min(end-start, chunk_frames);
+        ctx.alBufferSubDataSOFT(bid, format, staging.data(),
+            static_cast<ALsizei>(start*frame_size), static_cast<ALsizei>(todo*frame_size)
+        );
+        start += todo;
+    }
+}
+
+
 void BufferImpl::load(ALuint frames, ALenum format, SharedPtr<Decoder> decoder, ContextImpl *ctx)
 {
-    Vector<ALbyte> data(FramesToBytes(frames, mChannelConfig, mSampleType));
+    TraceSpan span("BufferImpl::load");
+    PcmCacheFile cached;
+    uint64_t cache_key = 0;
+    if(!mCacheDir.empty())
+    {
+        cache_key = GetPcmCacheKey(mName, *decoder, mChannelConfig, mSampleType, mFrequency);
+        if(cache_key && cached.open(mCacheDir, cache_key))
+        {
+            const PcmCacheInfo &info = cached.getInfo();
+            if(info.mChannels != mChannelConfig || info.mType != mSampleType ||
+               info.mFrequency != mFrequency)
+                cached.close();
+        }
+    }
 
-    ALuint got = decoder->read(data.data(), frames);
-    if(got > 0)
+    // Large sounds that go to OpenAL as decoded are uploaded in chunks, rather
+    // than staging the whole thing. Cached sounds need all the samples to
+    // write out.
+    bool chunks_sent = false;
+    if(!cache_key && decoder->getChannelConfig() == mChannelConfig &&
+       decoder->getSampleType() == mSampleType && decoder->getFrequency() == mFrequency &&
+       FramesToBytes(frames, mChannelConfig, mSampleType) > UploadChunkSize &&
+       ctx->canUploadChunked(mSampleType))
     {
+        ALuint got = UploadBufferChunked(*ctx, mName, mId, format, mFrequency,
+                                         mChannelConfig, mSampleType, *decoder, frames);
+        if(got == 0)
+            throw std::runtime_error("No samples for buffer");
+        // If the decoder was shorter than it said, decode it again the usual
+        // way so the buffer isn't padded with silence.
+        if(got == frames || !decoder->seek(0))
+        {
+            SilenceBufferChunked(*ctx, mId, format, mChannelConfig, mSampleType, got, frames);
+            mBlockFrames = 0;
+            mDataSize = FramesToBytes(frames, mChannelConfig, mSampleType);
+            ctx->getStats().mBufferMemory.fetch_add(mDataSize, std::memory_order_relaxed);
+            if(ctx->hasExtension(AL::SOFT_loop_points))
+            {
+                std::pair<uint64_t,uint64_t> loop_pts = ClampLoopPoints(
+                    decoder->getLoopPoints(), frames
+                );
+                ALint pts[2]{(ALint)loop_pts.first, (ALint)loop_pts.second};
+                alBufferiv(mId, AL_LOOP_POINTS_SOFT, pts);
+            }
+            return;
+        }
+        // The message handler already saw the samples as they were uploaded.
+        chunks_sent = true;
         frames = got;
-        data.resize(FramesToBytes(frames, mChannelConfig, mSampleType));
     }
-    else
+
+    ArenaBuffer decoded;
+    HookVector<ALbyte> data;
+    ArrayView<ALbyte> pcm = cached.getData();
+    std::pair<uint64_t,uint64_t> loop_pts = cached.getInfo().mLoopPts;
+    if(pcm.empty())
     {
-        ALbyte silence = 0;
-        if(mSampleType == SampleType::UInt8) silence = -128;
-        else if(mSampleType == SampleType::Mulaw) silence = 127;
-        std::fill(data.begin(), data.end(), silence);
+        ChannelConfig decchans = decoder->getChannelConfig();
+        SampleType dectype = decoder->getSampleType();
+        decoded = ctx->getDecodeArena().acquire(std::max(
+            FramesToBytes(frames, decchans, dectype),
+            FramesToBytes(frames, mChannelConfig, mSampleType)
+        ));
+
+        auto start = std::chrono::steady_clock::now();
+        ALuint got;
+        {
+            TraceSpan readspan("Decoder::read");
+            got = decoder->read(decoded.data(), frames);
+        }
+        ContextStats &stats = ctx->getStats();
+        stats.addDecode(stats.mBufferDecodeTimes, std::chrono::steady_clock::now() - start,
+                        FramesToBytes(got, decchans, dectype));
+        if(got == 0)
+            throw std::runtime_error("No samples for buffer");
+        frames = got;
+        decoded.shrink(FramesToBytes(frames, decchans, dectype));
+        pcm = decoded.view();
+        if(decchans != mChannelConfig || dectype != mSampleType)
+        {
+            data = ConvertFormatData(pcm, decchans, dectype, mChannelConfig, mSampleType);
+            pcm = data;
+        }
+
+        loop_pts = ClampLoopPoints(decoder->getLoopPoints(), frames);
+
+        ALuint decrate = decoder->getFrequency();
+        if(decrate != mFrequency)
+        {
+            data = ResampleFormatData(pcm, mChannelConfig, mSampleType, decrate, mFrequency);
+            pcm = data;
+            frames = static_cast<ALuint>(
+                data.size() / FramesToBytes(1, mChannelConfig, mSampleType)
+            );
+            loop_pts = ScaleLoopPoints(loop_pts, decrate, mFrequency, frames);
+        }
+
+        if(cache_key)
+            WritePcmCache(mCacheDir, cache_key,
+                PcmCacheInfo{mChannelConfig, mSampleType, mFrequency, loop_pts}, pcm);
     }
 
-    std::pair<uint64_t,uint64_t> loop_pts = decoder->getLoopPoints();
-    if(loop_pts.first >= loop_pts.second)
-        loop_pts = std::make_pair(0, frames);
-    else
+    if(!chunks_sent)
+        ctx->send(&MessageHandler::bufferLoading,
+            mName, mChannelConfig, mSampleType, mFrequency, pcm
+        );
+
+    HookVector<ALbyte> encoded;
+    mBlockedLength = static_cast<ALuint>(pcm.size() / FramesToBytes(1, mChannelConfig, mSampleType));
+    ALenum storeformat = EncodeBufferData(pcm, encoded, mChannelConfig, mSampleType,
+                                          ctx->getBufferStorage(), *ctx, mBlockFrames);
+    if(storeformat != AL_NONE)
     {
-        loop_pts.second = std::min<uint64_t>(loop_pts.second, frames);
-        loop_pts.first = std::min<uint64_t>(loop_pts.first, loop_pts.second-1);
+        format = storeformat;
+        pcm = encoded;
     }
 
-    ctx->send(&MessageHandler::bufferLoading,
-        mName, mChannelConfig, mSampleType, mFrequency, data
-    );
-
-    alBufferData(mId, format, data.data(), static_cast<ALsizei>(data.size()), mFrequency);
+    if(mBlockFrames > 0 && ctx->hasExtension(AL::SOFT_block_alignment))
+        alBufferi(mId, AL_UNPACK_BLOCK_ALIGNMENT_SOFT, mBlockFrames);
+    alBufferData(mId, format, pcm.data(), static_cast<ALsizei>(pcm.size()), mFrequency);
+    mDataSize = pcm.size();
+    ctx->getStats().mBufferMemory.fetch_add(mDataSize, std::memory_order_relaxed);
     if(ctx->hasExtension(AL::SOFT_loop_points))
     {
         ALint pts[2]{(ALint)loop_pts.first, (ALint)loop_pts.second};
@@ -160,6 +881,8 @@ DECL_THUNK0(ALuint, Buffer, getLength, const)
 ALuint BufferImpl::getLength() const
 {
     CheckContext(mContext);
+    if(mBlockFrames > 0)
+        return mBlockedLength;
 
     alGetError();
     ALint size=-1, bits=-1, chans=-1;
@@ -189,6 +912,8 @@ void BufferImpl::setLoopPoints(ALuint start, ALuint end)
 
     if(UNLIKELY(!mSources.empty()))
         throw std::runtime_error("Buffer is in use");
+    if(UNLIKELY(mContext.isBufferIdShared(mId, mDataHash)))
+        throw std::runtime_error("Buffer data is shared");
 
     if(!mContext.hasExtension(AL::SOFT_loop_points))
     {
@@ -204,6 +929,9 @@ void BufferImpl::setLoopPoints(ALuint start, ALuint end)
     ALint pts[2]{(ALint)start, (ALint)end};
     alBufferiv(mId, AL_LOOP_POINTS_SOFT, pts);
     throw_al_error("Failed to set loop points");
+    // Later buffers loaded with the same data only share this one's ID if
+    // they have the same loop points.
+    mContext.setSharedLoopPoints(mId, mDataHash, std::make_pair(start, end));
 }
 
 DECL_THUNK0(ALuintPair, Buffer, getLoopPoints, const)
@@ -2,12 +2,67 @@
 #define BUFFER_H
 
 #include <algorithm>
+#include <atomic>
 
 #include "main.h"
+#include "allocator.h"
 
 namespace alure {
 
 ALenum GetFormat(ChannelConfig chans, SampleType type);
+/**
+ * Gets the format to use for the given channel configuration and sample
+ * type. If it isn't supported, chans and type are updated to the closest
+ * supported format the samples can be converted to with ConvertFormatData,
+ * or AL_NONE is returned if there is none.
+ */
+ALenum GetFallbackFormat(ChannelConfig &chans, SampleType &type);
+HookVector<ALbyte> ConvertFormatData(ArrayView<ALbyte> data, ChannelConfig srcchans,
+                                     SampleType srctype, ChannelConfig dstchans,
+                                     SampleType dsttype);
+HookVector<ALbyte> ResampleFormatData(ArrayView<ALbyte> data, ChannelConfig chans,
+                                      SampleType type, ALuint srcrate, ALuint dstrate);
+/**
+ * Hashes loaded buffer data, to find identical buffers. This is the XXH64
+ * algorithm, whose four independent lanes keep the CPU's pipelines full.
+ */
+uint64_t HashBufferData(ArrayView<ALbyte> data);
+std::pair<uint64_t,uint64_t> ScaleLoopPoints(std::pair<uint64_t,uint64_t> loop_pts,
+                                             ALuint srcrate, ALuint dstrate, ALuint frames);
+/**
+ * Clamps a decoder's loop points to the given length. Unset or invalid loop
+ * points cover the whole length.
+ */
+std::pair<uint64_t,uint64_t> ClampLoopPoints(std::pair<uint64_t,uint64_t> loop_pts,
+                                             ALuint frames);
+/**
+ * Encodes the samples for the given storage into out, returning the format
+ * for it. If the storage is native or the encoding is unsupported, returns
+ * AL_NONE and leaves out alone.
+ */
+ALenum EncodeBufferData(ArrayView<ALbyte> data, HookVector<ALbyte> &out, ChannelConfig chans,
+                        SampleType type, BufferStorage storage, const ContextImpl &ctx,
+                        ALsizei &block_frames);
+
+/** The most sample data staged at once when uploading a buffer in chunks. */
+constexpr size_t UploadChunkSize = 1024*1024;
+
+/**
+ * Allocates the buffer for the given number of frames, and decodes them into
+ * it in chunks of up to UploadChunkSize with AL_SOFT_buffer_sub_data. The
+ * samples must be in a format OpenAL takes as-is. Each chunk is given to the
+ * message handler's bufferLoading as it's uploaded. Returns the number of
+ * frames decoded, which is less than requested if the decoder ran out early.
+ */
+ALuint UploadBufferChunked(ContextImpl &ctx, StringView name, ALuint bid, ALenum format,
+                           ALuint srate, ChannelConfig chans, SampleType type,
+                           Decoder &decoder, ALuint frames);
+/**
+ * Fills frames [start, end) of a buffer allocated by UploadBufferChunked with
+ * silence.
+ */
+void SilenceBufferChunked(ContextImpl &ctx, ALuint bid, ALenum format, ChannelConfig chans,
+                          SampleType type, ALuint start, ALuint end);
 
 class BufferImpl {
     ContextImpl &mContext;
@@ -22,6 +77,26 @@ class BufferImpl {
     const String mName;
     size_t mNameHash;
 
+    // Sample frames per block for block-compressed storage, or 0, and the
+    // length of the stored audio, since the size of block-compressed data
+    // includes the padding of the last block.
+    ALsizei mBlockFrames{0};
+    ALuint mBlockedLength{0};
+
+    // The on-disk decode cache to use for an asynchronous load, or empty.
+    String mCacheDir;
+
+    // The size of the stored sample data, for the context's statistics.
+    size_t mDataSize{0};
+
+    // The hash of the sample data when its AL buffer may be shared with other
+    // buffers, to find the context's entry for it, or 0.
+    uint64_t mDataHash{0};
+
+    // Cleared while an asynchronous load is pending, and set by the
+    // background thread when it finishes, so checking needs no future.
+    std::atomic<bool> mLoaded{true};
+
 public:
     BufferImpl(ContextImpl &context, ALuint id, ALuint freq, ChannelConfig config, SampleType type,
                StringView name, size_t name_hash)
@@ -43,6 +118,17 @@ public:
 
     void load(ALuint frames, ALenum format, SharedPtr<Decoder> decoder, ContextImpl *ctx);
 
+    void setBlockFrames(ALsizei block_frames, ALuint length)
+    { mBlockFrames = block_frames; mBlockedLength = length; }
+    void setCacheDirectory(String dir) { mCacheDir = std::move(dir); }
+    void setDataSize(size_t size) { mDataSize = size; }
+    void setDataHash(uint64_t hash) { mDataHash = hash; }
+    uint64_t getDataHash() const { return mDataHash; }
+
+    void setLoading() { mLoaded.store(false, std::memory_order_relaxed); }
+    void setLoaded() { mLoaded.store(true, std::memory_order_release); }
+    bool isLoaded() const { return mLoaded.load(std::memory_order_acquire); }
+
     ALuint getLength() const;
 
     ALuint getFrequency() const { return mFrequency; }
@@ -15,6 +15,7 @@
 
 #include "alc.h"
 
+#include "decoders/pack.hpp"
 #ifdef HAVE_WAVE
 #include "decoders/wave.hpp"
 #endif
@@ -37,10 +38,13 @@
 #include "devicemanager.h"
 #include "device.h"
 #include "buffer.h"
+#include "memstream.h"
+#include "pcmcache.h"
 #include "source.h"
 #include "auxeffectslot.h"
 #include "effect.h"
 #include "sourcegroup.h"
+#include "trace.h"
 
 #ifdef _WIN32
 #define WIN32_LEAN_AND_MEAN
@@ -227,6 +231,7 @@ public:
 
 using DecoderEntryPair = std::pair<alure::String,alure::UniquePtr<alure::DecoderFactory>>;
 const DecoderEntryPair sDefaultDecoders[] = {
+    { "_alure_int_pack", alure::MakeUnique<alure::PackDecoderFactory>() },
 #ifdef HAVE_WAVE
     { "_alure_int_wave", alure::MakeUnique<alure::WaveDecoderFactory>() },
 #endif
@@ -248,6 +253,10 @@ const DecoderEntryPair sDefaultDecoders[] = {
 };
 alure::Vector<DecoderEntryPair> sDecoders;
 
+// Guards the registered decoder factories and the file factory, since the
+// background thread opens decoders for streams started from a preroll.
+std::mutex sDecoderMutex;
+
 
 alure::DecoderOrExceptT GetDecoder(alure::UniquePtr<std::istream> &file,
                                    alure::ArrayView<DecoderEntryPair> decoders)
@@ -271,6 +280,7 @@ alure::DecoderOrExceptT GetDecoder(alure::UniquePtr<std::istream> &file,
 
 static alure::DecoderOrExceptT GetDecoder(alure::UniquePtr<std::istream> file)
 {
+    std::lock_guard<std::mutex> lock(sDecoderMutex);
     auto decoder = GetDecoder(file, sDecoders);
     if(std::holds_alternative<std::exception_ptr>(decoder)) return decoder;
     if(std::get<alure::SharedPtr<alure::Decoder>>(decoder)) return decoder;
@@ -296,6 +306,26 @@ DefaultFileIOFactory sDefaultFileFactory;
 
 alure::UniquePtr<alure::FileIOFactory> sFileFactory;
 
+// Finds the shared AL buffer entry for a buffer's ID and data hash, in a list
+// sorted by hash. A hash of 0 means the buffer's ID isn't shared.
+template<typename T>
+auto FindSharedBufferId(T &list, ALuint id, uint64_t data_hash) -> decltype(list.begin())
+{
+    if(!data_hash)
+        return list.end();
+    auto iter = std::lower_bound(list.begin(), list.end(), data_hash,
+        [](const typename T::value_type &lhs, uint64_t rhs) -> bool
+        { return lhs.mHash < rhs; }
+    );
+    while(iter != list.end() && iter->mHash == data_hash)
+    {
+        if(iter->mId == id)
+            return iter;
+        ++iter;
+    }
+    return list.end();
+}
+
 }
 
 namespace alure {
@@ -384,6 +414,7 @@ DecoderFactory::~DecoderFactory() { }
 
 void RegisterDecoder(StringView name, UniquePtr<DecoderFactory> factory)
 {
+    std::lock_guard<std::mutex> lock(sDecoderMutex);
     auto iter = std::lower_bound(sDecoders.begin(), sDecoders.end(), name,
         [](const DecoderEntryPair &entry, StringView rhs) -> bool
         { return entry.first < rhs; }
@@ -395,6 +426,7 @@ void RegisterDecoder(StringView name, UniquePtr<DecoderFactory> factory)
 
 UniquePtr<DecoderFactory> UnregisterDecoder(StringView name) noexcept
 {
+    std::lock_guard<std::mutex> lock(sDecoderMutex);
     UniquePtr<DecoderFactory> factory;
     auto iter = std::lower_bound(sDecoders.begin(), sDecoders.end(), name,
         [](const DecoderEntryPair &entry, StringView rhs) noexcept -> bool
@@ -414,6 +446,7 @@ FileIOFactory::~FileIOFactory() { }
 
 UniquePtr<FileIOFactory> FileIOFactory::set(UniquePtr<FileIOFactory> factory) noexcept
 {
+    std::lock_guard<std::mutex> lock(sDecoderMutex);
     sFileFactory.swap(factory);
     return factory;
 }
@@ -425,6 +458,13 @@ FileIOFactory &FileIOFactory::get() noexcept
     return sDefaultFileFactory;
 }
 
+UniquePtr<std::istream> OpenFile(const String &name)
+{
+    TraceSpan span("FileIOFactory::openFile");
+    std::lock_guard<std::mutex> lock(sDecoderMutex);
+    return FileIOFactory::get().openFile(name);
+}
+
 
 // Default message handler methods are no-ops.
 MessageHandler::~MessageHandler()
@@ -443,6 +483,10 @@ void MessageHandler::sourceForceStopped(Source) noexcept
 {
 }
 
+void MessageHandler::sourceUnderrun(Source, uint64_t) noexcept
+{
+}
+
 void MessageHandler::bufferLoading(StringView, ChannelConfig, SampleType, ALuint, ArrayView<ALbyte>) noexcept
 {
 }
@@ -503,6 +547,11 @@ static void LoadSourceResampler(ContextImpl *ctx)
     LoadALFunc(&ctx->alGetStringiSOFT, "alGetStringiSOFT");
 }
 
+static void LoadBufferSubData(ContextImpl *ctx)
+{
+    LoadALFunc(&ctx->alBufferSubDataSOFT, "alBufferSubDataSOFT");
+}
+
 static void LoadSourceLatency(ContextImpl *ctx)
 {
     LoadALFunc(&ctx->alGetSourcei64vSOFT, "alGetSourcei64vSOFT");
@@ -524,6 +573,10 @@ static const struct {
     { AL::EXT_MULAW_MCFORMATS, "AL_EXT_MULAW_MCFORMATS", LoadNothing },
     { AL::EXT_MULAW_BFORMAT,   "AL_EXT_MULAW_BFORMAT",   LoadNothing },
 
+    { AL::SOFT_MSADPCM,         "AL_SOFT_MSADPCM",         LoadNothing },
+    { AL::SOFT_block_alignment, "AL_SOFT_block_alignment", LoadNothing },
+    { AL::SOFT_buffer_sub_data, "AL_SOFT_buffer_sub_data", LoadBufferSubData },
+
     { AL::SOFT_loop_points,       "AL_SOFT_loop_points",       LoadNothing },
     { AL::SOFT_source_latency,    "AL_SOFT_source_latency",    LoadSourceLatency },
     { AL::SOFT_source_resampler,  "AL_SOFT_source_resampler",  LoadSourceResampler },
@@ -604,12 +657,15 @@ void ContextImpl::backgroundProc()
     if(DeviceManagerImpl::SetThreadContext && mDevice.hasExtension(ALC::EXT_thread_local_context))
         DeviceManagerImpl::SetThreadContext(getALCcontext());
 
+    SetTraceThreadName("alure background");
+
     std::chrono::steady_clock::time_point basetime = std::chrono::steady_clock::now();
     std::chrono::milliseconds waketime(0);
     std::unique_lock<std::mutex> ctxlock(gGlobalCtxMutex);
     while(!mQuitThread.load(std::memory_order_acquire))
     {
         {
+            TraceSpan span("ContextImpl::backgroundProc");
             std::lock_guard<std::mutex> srclock(mSourceStreamMutex);
             mStreamingSources.erase(
                 std::remove_if(mStreamingSources.begin(), mStreamingSources.end(),
@@ -617,7 +673,42 @@ void ContextImpl::backgroundProc()
                     { return !source->updateAsync(); }
                 ), mStreamingSources.end()
             );
+            mStats.mStreamsActive.store(static_cast<ALuint>(mStreamingSources.size()),
+                                        std::memory_order_relaxed);
+        }
+
+        // Open one requested decoder at a time too, without holding the
+        // context lock since finding and probing the file can take a while.
+        std::unique_lock<std::mutex> reqlock(mDecoderRequestMutex);
+        if(!mDecoderRequests.empty())
+        {
+            SharedPtr<DecoderRequest> request = std::move(mDecoderRequests.front());
+            mDecoderRequests.erase(mDecoderRequests.begin());
+            reqlock.unlock();
+            ctxlock.unlock();
+
+            // Don't bother if the stream was already stopped. There's no
+            // message handler to ask for a substitute on this thread, so a
+            // file that can't be opened just leaves the decoder empty.
+            if(request.use_count() > 1)
+            {
+                try {
+                    DecoderOrExceptT dec = findDecoder(request->mName, false);
+                    if(SharedPtr<Decoder> *decoder = std::get_if<SharedPtr<Decoder>>(&dec))
+                        request->mDecoder = std::move(*decoder);
+                }
+                catch(...) {
+                }
+            }
+            request->mDone.store(true, std::memory_order_release);
+
+            ctxlock.lock();
+            while(!mQuitThread.load(std::memory_order_acquire) &&
+                  alcGetCurrentContext() != getALCcontext())
+                mWakeThread.wait(ctxlock);
+            continue;
         }
+        reqlock.unlock();
 
         // Only do one pending buffer at a time. In case there's several large
         // buffers to load, we still need to process streaming sources so they
@@ -625,15 +716,28 @@ void ContextImpl::backgroundProc()
         PendingPromise *lastpb = mPendingCurrent.load(std::memory_order_acquire);
         if(PendingPromise *pb = lastpb->mNext.load(std::memory_order_relaxed))
         {
-            pb->mBuffer->load(pb->mFrames, pb->mFormat, std::move(pb->mDecoder), this);
-            pb->mPromise.set_value(Buffer(pb->mBuffer));
+            try {
+                pb->mBuffer->load(pb->mFrames, pb->mFormat, std::move(pb->mDecoder), this);
+                // The buffer may be removed as soon as the promise is set, so
+                // mark it loaded first. A buffer that failed to load is left
+                // pending, so its future keeps reporting the error until it's
+                // removed.
+                pb->mBuffer->setLoaded();
+                mStats.mPendingBuffers.fetch_sub(1, std::memory_order_relaxed);
+                pb->mPromise.set_value(Buffer(pb->mBuffer));
+            }
+            catch(...) {
+                mStats.mPendingBuffers.fetch_sub(1, std::memory_order_relaxed);
+                pb->mPromise.set_exception(std::current_exception());
+            }
             Promise<Buffer>().swap(pb->mPromise);
             mPendingCurrent.store(pb, std::memory_order_release);
             continue;
         }
 
         std::unique_lock<std::mutex> wakelock(mWakeMutex);
-        if(!mQuitThread.load(std::memory_order_acquire) && lastpb->mNext.load(std::memory_order_acquire) == nullptr)
+        if(!mQuitThread.load(std::memory_order_acquire) &&
+           lastpb->mNext.load(std::memory_order_acquire) == nullptr && !hasDecoderRequests())
         {
             ctxlock.unlock();
 
@@ -676,7 +780,7 @@ ContextImpl::ContextImpl(DeviceImpl &device, ArrayView<AttributePair> attrs)
     if(!mContext) throw alc_error(alcGetError(alcdev), "alcCreateContext failed");
 
     mSourceIds.reserve(256);
-    mPendingTail = mPendingHead = new PendingPromise();
+    mPendingSwept = mPendingTail = mPendingHead = new PendingPromise();
     mPendingCurrent.store(mPendingHead, std::memory_order_relaxed);
 }
 
@@ -699,7 +803,7 @@ ContextImpl::~ContextImpl()
         pb = next;
     }
     mPendingCurrent.store(nullptr, std::memory_order_relaxed);
-    mPendingTail = mPendingHead = nullptr;
+    mPendingSwept = mPendingTail = mPendingHead = nullptr;
 
     mEffectSlots.clear();
     mEffects.clear();
@@ -758,12 +862,20 @@ void ContextImpl::destroy()
             alDeleteSources(static_cast<ALsizei>(mSourceIds.size()), mSourceIds.data());
         mSourceIds.clear();
 
+        // Deleting the sources unqueued any stream buffers still on them.
+        if(!mStreamBufferIds.empty())
+            alDeleteBuffers(static_cast<ALsizei>(mStreamBufferIds.size()),
+                            mStreamBufferIds.data());
+        mStreamBufferIds.clear();
+
         for(auto &bufptr : mBuffers)
         {
             ALuint id = bufptr->getId();
-            alDeleteBuffers(1, &id);
+            if(releaseBufferId(id, bufptr->getDataHash()))
+                alDeleteBuffers(1, &id);
         }
         mBuffers.clear();
+        mStreamPrerolls.clear();
 
         mEffectSlots.clear();
         mEffects.clear();
@@ -821,26 +933,45 @@ void ContextImpl::setAsyncWakeInterval(std::chrono::milliseconds interval)
 }
 
 
-DecoderOrExceptT ContextImpl::findDecoder(StringView name)
+DecoderOrExceptT ContextImpl::findDecoder(StringView name, bool substitute)
 {
+    TraceSpan span("ContextImpl::findDecoder");
+    if(SharedPtr<const HookVector<char>> data = findFileData(name))
+    {
+        ArrayView<ALbyte> view(reinterpret_cast<const ALbyte*>(data->data()), data->size());
+        return GetDecoder(MakeUnique<MemoryStream>(std::move(data), view));
+    }
+
     String oldname = String(name);
-    auto file = FileIOFactory::get().openFile(oldname);
+    UniquePtr<std::istream> file = OpenFile(oldname);
     if(UNLIKELY(!file))
     {
         // Resource not found. Try to find a substitute.
-        if(!mMessage.get())
+        if(!substitute || !mMessage.get())
             return std::make_exception_ptr(std::runtime_error("Failed to open file"));
         do {
             String newname(mMessage->resourceNotFound(oldname));
             if(newname.empty())
                 return std::make_exception_ptr(std::runtime_error("Failed to open file"));
-            file = FileIOFactory::get().openFile(newname);
+            file = OpenFile(newname);
             oldname = std::move(newname);
         } while(!file);
     }
     return GetDecoder(std::move(file));
 }
 
+SharedPtr<DecoderRequest> ContextImpl::requestDecoder(StringView name)
+{
+    auto request = MakeShared<DecoderRequest>();
+    request->mName = String(name);
+    {
+        std::lock_guard<std::mutex> lock(mDecoderRequestMutex);
+        mDecoderRequests.push_back(request);
+    }
+    wakeThread();
+    return request;
+}
+
 DECL_THUNK1(SharedPtr<Decoder>, Context, createDecoder,, StringView)
 SharedPtr<Decoder> ContextImpl::createDecoder(StringView name)
 {
@@ -910,6 +1041,35 @@ ContextImpl::BufferListT::const_iterator ContextImpl::findBufferName(StringView
     return iter;
 }
 
+void ContextImpl::sweepFutureBuffers()
+{
+    // Remove the entries of buffers the background thread finished loading
+    // since the last sweep. Only those are looked at, and there's nothing to
+    // do when it hasn't finished any.
+    PendingPromise *current = mPendingCurrent.load(std::memory_order_acquire);
+    while(mPendingSwept != current)
+    {
+        PendingPromise *pb = mPendingSwept->mNext.load(std::memory_order_relaxed);
+        // The entry may already be gone, and its buffer along with it, so
+        // compare the pointer without using it.
+        auto iter = std::lower_bound(mFutureBuffers.begin(), mFutureBuffers.end(),
+            pb->mNameHash,
+            [](const PendingBuffer &lhs, size_t rhs) -> bool
+            { return lhs.mBuffer->getNameHash() < rhs; }
+        );
+        while(iter != mFutureBuffers.end() && iter->mBuffer->getNameHash() == pb->mNameHash)
+        {
+            if(iter->mBuffer == pb->mBuffer && iter->mBuffer->isLoaded())
+            {
+                mFutureBuffers.erase(iter);
+                break;
+            }
+            ++iter;
+        }
+        mPendingSwept = pb;
+    }
+}
+
 BufferOrExceptT ContextImpl::doCreateBuffer(StringView name, size_t name_hash, BufferListT::const_iterator iter, SharedPtr<Decoder> decoder)
 {
     ALuint srate = decoder->getFrequency();
@@ -919,38 +1079,176 @@ BufferOrExceptT ContextImpl::doCreateBuffer(StringView name, size_t name_hash, B
         std::min<uint64_t>(decoder->getLength(), std::numeric_limits<ALuint>::max())
     );
 
-    Vector<ALbyte> data(FramesToBytes(frames, chans, type));
-    frames = decoder->read(data.data(), frames);
-    if(!frames)
-        return std::make_exception_ptr(std::runtime_error("No samples for buffer"));
-    data.resize(FramesToBytes(frames, chans, type));
-
-    std::pair<uint64_t,uint64_t> loop_pts = decoder->getLoopPoints();
-    if(loop_pts.first >= loop_pts.second)
-        loop_pts = std::make_pair(0, frames);
-    else
-    {
-        loop_pts.second = std::min<uint64_t>(loop_pts.second, frames);
-        loop_pts.first = std::min<uint64_t>(loop_pts.first, loop_pts.second-1);
-    }
-
     // Get the format before calling the bufferLoading message handler, to
-    // ensure it's something OpenAL can handle.
-    ALenum format = GetFormat(chans, type);
+    // ensure it's something OpenAL can handle. Samples in a format it can't
+    // handle are converted to the closest one it can.
+    ChannelConfig bufchans = getDownmixToMono(name) ? ChannelConfig::Mono : chans;
+    SampleType buftype = getBufferSampleType(type);
+    ALenum format = GetFallbackFormat(bufchans, buftype);
     if(UNLIKELY(format == AL_NONE))
     {
         auto str = String("Unsupported format (")+GetSampleTypeName(type)+", "+
                    GetChannelConfigName(chans)+")";
         return std::make_exception_ptr(std::runtime_error(str));
     }
+    ALuint bufrate = getLoadFrequency(srate);
+
+    // Check the decode cache for the file already decoded to this format.
+    PcmCacheFile cached;
+    uint64_t cache_key = 0;
+    if(!mDecodeCacheDir.empty())
+    {
+        cache_key = GetPcmCacheKey(name, *decoder, bufchans, buftype, bufrate);
+        if(cache_key && cached.open(mDecodeCacheDir, cache_key))
+        {
+            const PcmCacheInfo &info = cached.getInfo();
+            if(info.mChannels != bufchans || info.mType != buftype || info.mFrequency != bufrate)
+                cached.close();
+        }
+    }
+
+    // Large sounds that go to OpenAL as decoded are uploaded in chunks, rather
+    // than staging the whole thing. Buffers that may be shared need all the
+    // samples to hash, and cached sounds need them to write out.
+    bool chunks_sent = false;
+    if(!cache_key && !mBufferDedup && bufchans == chans && buftype == type &&
+       bufrate == srate && FramesToBytes(frames, chans, type) > UploadChunkSize &&
+       canUploadChunked(type))
+    {
+        alGetError();
+        ALuint bid = 0;
+        alGenBuffers(1, &bid);
+        ALuint got = UploadBufferChunked(*this, name, bid, format, srate, chans, type,
+                                         *decoder, frames);
+        if(got == 0)
+        {
+            alDeleteBuffers(1, &bid);
+            return std::make_exception_ptr(std::runtime_error("No samples for buffer"));
+        }
+        if(got == frames || !decoder->seek(0))
+        {
+            SilenceBufferChunked(*this, bid, format, chans, type, got, frames);
+            std::pair<uint64_t,uint64_t> loop_pts = ClampLoopPoints(decoder->getLoopPoints(),
+                                                                    frames);
+            if(hasExtension(AL::SOFT_loop_points))
+            {
+                ALint pts[2]{(ALint)loop_pts.first, (ALint)loop_pts.second};
+                alBufferiv(bid, AL_LOOP_POINTS_SOFT, pts);
+            }
+            if(ALenum err = alGetError())
+            {
+                alDeleteBuffers(1, &bid);
+                return std::make_exception_ptr(al_error(err, "Failed to buffer data"));
+            }
 
-    if(mMessage.get())
-        mMessage->bufferLoading(name, chans, type, srate, data);
+            size_t size = FramesToBytes(frames, chans, type);
+            mStats.mBufferMemory.fetch_add(size, std::memory_order_relaxed);
+
+            auto buffer = MakeUnique<BufferImpl>(*this, bid, srate, chans, type, name,
+                                                 name_hash);
+            buffer->setDataSize(size);
+            return mBuffers.insert(iter, std::move(buffer))->get();
+        }
+        // The decoder was shorter than it said. Decode it again the usual way,
+        // so the buffer isn't padded with silence. The message handler already
+        // saw the samples as they were uploaded.
+        alDeleteBuffers(1, &bid);
+        chunks_sent = true;
+        frames = got;
+    }
+
+    ArenaBuffer decoded;
+    HookVector<ALbyte> data;
+    ArrayView<ALbyte> pcm = cached.getData();
+    std::pair<uint64_t,uint64_t> loop_pts = cached.getInfo().mLoopPts;
+    if(pcm.empty())
+    {
+        decoded = mDecodeArena.acquire(FramesToBytes(frames, chans, type));
+        auto start = std::chrono::steady_clock::now();
+        {
+            TraceSpan span("Decoder::read");
+            frames = decoder->read(decoded.data(), frames);
+        }
+        mStats.addDecode(mStats.mBufferDecodeTimes, std::chrono::steady_clock::now() - start,
+                         FramesToBytes(frames, chans, type));
+        if(!frames)
+            return std::make_exception_ptr(std::runtime_error("No samples for buffer"));
+        decoded.shrink(FramesToBytes(frames, chans, type));
+        pcm = decoded.view();
+
+        loop_pts = ClampLoopPoints(decoder->getLoopPoints(), frames);
+
+        if(bufchans != chans || buftype != type)
+        {
+            data = ConvertFormatData(pcm, chans, type, bufchans, buftype);
+            pcm = data;
+        }
+        if(bufrate != srate)
+        {
+            data = ResampleFormatData(pcm, bufchans, buftype, srate, bufrate);
+            pcm = data;
+            frames = static_cast<ALuint>(data.size() / FramesToBytes(1, bufchans, buftype));
+            loop_pts = ScaleLoopPoints(loop_pts, srate, bufrate, frames);
+        }
+
+        if(cache_key)
+            WritePcmCache(mDecodeCacheDir, cache_key,
+                          PcmCacheInfo{bufchans, buftype, bufrate, loop_pts}, pcm);
+    }
+    chans = bufchans;
+    type = buftype;
+    srate = bufrate;
+
+    if(mMessage.get() && !chunks_sent)
+        mMessage->bufferLoading(name, chans, type, srate, pcm);
+
+    ALsizei block_frames = 0;
+    ALuint length = static_cast<ALuint>(pcm.size() / FramesToBytes(1, chans, type));
+    HookVector<ALbyte> encoded;
+    ALenum storeformat = EncodeBufferData(pcm, encoded, chans, type, getBufferStorage(), *this,
+                                          block_frames);
+    if(storeformat != AL_NONE)
+    {
+        format = storeformat;
+        pcm = encoded;
+    }
+
+    // Look for an identical buffer to share. The loop points are part of the
+    // AL buffer, so they need to match too.
+    uint64_t data_hash = 0;
+    auto shared = mSharedBufferIds.end();
+    if(mBufferDedup)
+    {
+        // 0 is reserved for unshared buffers.
+        data_hash = HashBufferData(pcm);
+        if(!data_hash) data_hash = 1;
+        shared = std::lower_bound(mSharedBufferIds.begin(), mSharedBufferIds.end(), data_hash,
+            [](const SharedBufferId &lhs, uint64_t rhs) -> bool
+            { return lhs.mHash < rhs; }
+        );
+        while(shared != mSharedBufferIds.end() && shared->mHash == data_hash)
+        {
+            if(shared->mFormat == format && shared->mFrequency == srate &&
+               shared->mSize == pcm.size() && shared->mLoopPts == loop_pts)
+            {
+                ++shared->mRefs;
+                auto buffer = MakeUnique<BufferImpl>(*this, shared->mId, srate, chans, type,
+                                                     name, name_hash);
+                buffer->setBlockFrames(block_frames, length);
+                buffer->setDataSize(pcm.size());
+                buffer->setDataHash(data_hash);
+                return mBuffers.insert(iter, std::move(buffer))->get();
+            }
+            ++shared;
+        }
+    }
 
     alGetError();
     ALuint bid = 0;
     alGenBuffers(1, &bid);
-    alBufferData(bid, format, data.data(), static_cast<ALsizei>(data.size()), srate);
+    if(block_frames > 0 && hasExtension(AL::SOFT_block_alignment))
+        alBufferi(bid, AL_UNPACK_BLOCK_ALIGNMENT_SOFT, block_frames);
+    alBufferData(bid, format, pcm.data(), static_cast<ALsizei>(pcm.size()), srate);
     if(hasExtension(AL::SOFT_loop_points))
     {
         ALint pts[2]{(ALint)loop_pts.first, (ALint)loop_pts.second};
@@ -962,9 +1260,17 @@ BufferOrExceptT ContextImpl::doCreateBuffer(StringView name, size_t name_hash, B
         return std::make_exception_ptr(al_error(err, "Failed to buffer data"));
     }
 
-    return mBuffers.insert(iter,
-        MakeUnique<BufferImpl>(*this, bid, srate, chans, type, name, name_hash)
-    )->get();
+    if(mBufferDedup)
+        mSharedBufferIds.insert(shared,
+            SharedBufferId{data_hash, format, srate, pcm.size(), loop_pts, bid, 1});
+
+    mStats.mBufferMemory.fetch_add(pcm.size(), std::memory_order_relaxed);
+
+    auto buffer = MakeUnique<BufferImpl>(*this, bid, srate, chans, type, name, name_hash);
+    buffer->setBlockFrames(block_frames, length);
+    buffer->setDataSize(pcm.size());
+    buffer->setDataHash(data_hash);
+    return mBuffers.insert(iter, std::move(buffer))->get();
 }
 
 BufferOrExceptT ContextImpl::doCreateBufferAsync(StringView name, size_t name_hash, BufferListT::const_iterator iter, SharedPtr<Decoder> decoder, Promise<Buffer> promise)
@@ -978,13 +1284,20 @@ BufferOrExceptT ContextImpl::doCreateBufferAsync(StringView name, size_t name_ha
     if(!frames)
         return std::make_exception_ptr(std::runtime_error("No samples for buffer"));
 
-    ALenum format = GetFormat(chans, type);
+    // The buffer's format may differ from the decoder's, in which case the
+    // samples are converted as they're loaded.
+    ChannelConfig bufchans = getDownmixToMono(name) ? ChannelConfig::Mono : chans;
+    SampleType buftype = getBufferSampleType(type);
+    ALenum format = GetFallbackFormat(bufchans, buftype);
     if(UNLIKELY(format == AL_NONE))
     {
         auto str = String("Unsupported format (")+GetSampleTypeName(type)+", "+
                    GetChannelConfigName(chans)+")";
         return std::make_exception_ptr(std::runtime_error(str));
     }
+    chans = bufchans;
+    type = buftype;
+    srate = getLoadFrequency(srate);
 
     alGetError();
     ALuint bid = 0;
@@ -993,18 +1306,25 @@ BufferOrExceptT ContextImpl::doCreateBufferAsync(StringView name, size_t name_ha
         return std::make_exception_ptr(al_error(err, "Failed to create buffer"));
 
     auto buffer = MakeUnique<BufferImpl>(*this, bid, srate, chans, type, name, name_hash);
+    buffer->setCacheDirectory(mDecodeCacheDir);
 
     if(mThread.get_id() == std::thread::id())
         mThread = std::thread(std::mem_fn(&ContextImpl::backgroundProc), this);
 
+    buffer->setLoading();
+
+    // Promises are only reused once swept, so sweep first to have the most
+    // available.
+    sweepFutureBuffers();
     PendingPromise *pf = nullptr;
-    if(mPendingTail == mPendingCurrent.load(std::memory_order_acquire))
-        pf = new PendingPromise(buffer.get(), std::move(decoder), format, frames,
+    if(mPendingTail == mPendingSwept)
+        pf = new PendingPromise(buffer.get(), name_hash, std::move(decoder), format, frames,
                                 std::move(promise));
     else
     {
         pf = mPendingTail;
         pf->mBuffer = buffer.get();
+        pf->mNameHash = name_hash;
         pf->mDecoder = std::move(decoder);
         pf->mFormat = format;
         pf->mFrames = frames;
@@ -1012,6 +1332,7 @@ BufferOrExceptT ContextImpl::doCreateBufferAsync(StringView name, size_t name_ha
         mPendingTail = pf->mNext.exchange(nullptr, std::memory_order_relaxed);
     }
 
+    mStats.mPendingBuffers.fetch_add(1, std::memory_order_relaxed);
     mPendingHead->mNext.store(pf, std::memory_order_release);
     mPendingHead = pf;
 
@@ -1037,13 +1358,7 @@ Buffer ContextImpl::getBuffer(StringView name)
             mFutureBuffers.erase(iter);
         }
 
-        // Clear out any completed futures.
-        mFutureBuffers.erase(
-            std::remove_if(mFutureBuffers.begin(), mFutureBuffers.end(),
-                [](const PendingBuffer &entry) -> bool
-                { return GetFutureState(entry.mFuture) == std::future_status::ready; }
-            ), mFutureBuffers.end()
-        );
+        sweepFutureBuffers();
 
         // If we got the buffer, return it. Otherwise, go load it normally.
         if(buffer) return buffer;
@@ -1075,18 +1390,12 @@ SharedFuture<Buffer> ContextImpl::getBufferAsync(StringView name)
         if(iter != mFutureBuffers.end() && iter->mBuffer->getNameHash() == name_hash)
         {
             future = iter->mFuture;
-            if(GetFutureState(future) == std::future_status::ready)
+            if(iter->mBuffer->isLoaded())
                 mFutureBuffers.erase(iter);
             return future;
         }
 
-        // Clear out any fulfilled futures.
-        mFutureBuffers.erase(
-            std::remove_if(mFutureBuffers.begin(), mFutureBuffers.end(),
-                [](const PendingBuffer &entry) -> bool
-                { return GetFutureState(entry.mFuture) == std::future_status::ready; }
-            ), mFutureBuffers.end()
-        );
+        sweepFutureBuffers();
     }
 
     auto iter = findBufferName(name, name_hash);
@@ -1127,15 +1436,7 @@ void ContextImpl::precacheBuffersAsync(ArrayView<StringView> names)
     CheckContext(this);
 
     if(UNLIKELY(!mFutureBuffers.empty()))
-    {
-        // Clear out any fulfilled futures.
-        mFutureBuffers.erase(
-            std::remove_if(mFutureBuffers.begin(), mFutureBuffers.end(),
-                [](const PendingBuffer &entry) -> bool
-                { return GetFutureState(entry.mFuture) == std::future_status::ready; }
-            ), mFutureBuffers.end()
-        );
-    }
+        sweepFutureBuffers();
 
     auto hasher = std::hash<StringView>();
     for(const StringView name : names)
@@ -1195,15 +1496,7 @@ SharedFuture<Buffer> ContextImpl::createBufferAsyncFrom(StringView name, SharedP
     CheckContext(this);
 
     if(UNLIKELY(!mFutureBuffers.empty()))
-    {
-        // Clear out any fulfilled futures.
-        mFutureBuffers.erase(
-            std::remove_if(mFutureBuffers.begin(), mFutureBuffers.end(),
-                [](const PendingBuffer &entry) -> bool
-                { return GetFutureState(entry.mFuture) == std::future_status::ready; }
-            ), mFutureBuffers.end()
-        );
-    }
+        sweepFutureBuffers();
 
     auto hasher = std::hash<StringView>();
     size_t name_hash = hasher(name);
@@ -1250,13 +1543,7 @@ Buffer ContextImpl::findBuffer(StringView name)
             mFutureBuffers.erase(iter);
         }
 
-        // Clear out any completed futures.
-        mFutureBuffers.erase(
-            std::remove_if(mFutureBuffers.begin(), mFutureBuffers.end(),
-                [](const PendingBuffer &entry) -> bool
-                { return GetFutureState(entry.mFuture) == std::future_status::ready; }
-            ), mFutureBuffers.end()
-        );
+        sweepFutureBuffers();
     }
 
     if(LIKELY(!buffer))
@@ -1283,18 +1570,12 @@ SharedFuture<Buffer> ContextImpl::findBufferAsync(StringView name)
         if(iter != mFutureBuffers.end() && iter->mBuffer->getNameHash() == name_hash)
         {
             future = iter->mFuture;
-            if(GetFutureState(future) == std::future_status::ready)
+            if(iter->mBuffer->isLoaded())
                 mFutureBuffers.erase(iter);
             return future;
         }
 
-        // Clear out any fulfilled futures.
-        mFutureBuffers.erase(
-            std::remove_if(mFutureBuffers.begin(), mFutureBuffers.end(),
-                [](const PendingBuffer &entry) -> bool
-                { return GetFutureState(entry.mFuture) == std::future_status::ready; }
-            ), mFutureBuffers.end()
-        );
+        sweepFutureBuffers();
     }
 
     auto iter = findBufferName(name, name_hash);
@@ -1330,13 +1611,7 @@ void ContextImpl::removeBuffer(StringView name)
             mFutureBuffers.erase(iter);
         }
 
-        // Clear out any completed futures.
-        mFutureBuffers.erase(
-            std::remove_if(mFutureBuffers.begin(), mFutureBuffers.end(),
-                [](const PendingBuffer &entry) -> bool
-                { return GetFutureState(entry.mFuture) == std::future_status::ready; }
-            ), mFutureBuffers.end()
-        );
+        sweepFutureBuffers();
     }
 
     auto iter = findBufferName(name, name_hash);
@@ -1349,7 +1624,7 @@ void ContextImpl::removeBuffer(StringView name)
                 [buffer](PendingSource &entry) -> bool
                 {
                     return (GetFutureState(entry.mFuture) == std::future_status::ready &&
-                            entry.mFuture.get().getHandle() == buffer);
+                            GetFutureValue(entry.mFuture).getHandle() == buffer);
                 }
             ), mPendingSources.end()
         );
@@ -1359,6 +1634,302 @@ void ContextImpl::removeBuffer(StringView name)
 }
 
 
+DECL_THUNK2(void, Context, precacheStreamPreroll,, StringView, std::chrono::milliseconds)
+DECL_THUNK2(void, Context, precacheStreamHead,, StringView, std::chrono::milliseconds)
+void ContextImpl::doPrecacheStream(StringView name, std::chrono::milliseconds duration, bool resident)
+{
+    if(duration.count() <= 0)
+        throw std::domain_error("Invalid preroll duration");
+    CheckContext(this);
+
+    SharedPtr<Decoder> decoder = createDecoder(name);
+    auto preroll = MakeShared<StreamPreroll>();
+    preroll->mName = String(name);
+    preroll->mNameHash = std::hash<StringView>()(name);
+    preroll->mFrequency = decoder->getFrequency();
+    preroll->mChannels = decoder->getChannelConfig();
+    preroll->mType = decoder->getSampleType();
+    preroll->mLoopPts = decoder->getLoopPoints();
+
+    preroll->mMono = getDownmixToMono(name);
+    ChannelConfig bufchans = preroll->mMono ? ChannelConfig::Mono : preroll->mChannels;
+    SampleType buftype = preroll->mType;
+    ALenum format = GetFallbackFormat(bufchans, buftype);
+    if(UNLIKELY(format == AL_NONE))
+    {
+        auto str = String("Unsupported format (")+GetSampleTypeName(preroll->mType)+", "+
+                   GetChannelConfigName(preroll->mChannels)+")";
+        throw std::runtime_error(str);
+    }
+
+    uint64_t frames = static_cast<uint64_t>(duration.count()) * preroll->mFrequency / 1000;
+    // Stop short of a loop end, so looping is always handled by the stream's
+    // decoder.
+    if(preroll->mLoopPts.first < preroll->mLoopPts.second)
+        frames = std::min<uint64_t>(frames, preroll->mLoopPts.second-1);
+    frames = std::min<uint64_t>(frames, std::numeric_limits<ALsizei>::max());
+
+    ALuint frame_size = FramesToBytes(1, preroll->mChannels, preroll->mType);
+    preroll->mData.resize(static_cast<size_t>(frames) * frame_size);
+    preroll->mFrames = decoder->read(preroll->mData.data(), static_cast<ALuint>(frames));
+    preroll->mData.resize(preroll->mFrames * frame_size);
+
+    if(resident)
+    {
+        alGetError();
+        alGenBuffers(1, &preroll->mBufferId);
+        throw_al_error("Failed to create buffer");
+        // The stream compares against the decoded format, so only the
+        // buffer's copy is converted.
+        if(bufchans != preroll->mChannels || buftype != preroll->mType)
+            preroll->mData = ConvertFormatData(preroll->mData, preroll->mChannels,
+                                               preroll->mType, bufchans, buftype);
+        alBufferData(preroll->mBufferId, format,
+            preroll->mData.data(), static_cast<ALsizei>(preroll->mData.size()),
+            preroll->mFrequency
+        );
+        throw_al_error("Failed to buffer data");
+        HookVector<ALbyte>().swap(preroll->mData);
+    }
+
+    size_t name_hash = preroll->mNameHash;
+    auto iter = std::lower_bound(mStreamPrerolls.begin(), mStreamPrerolls.end(), name_hash,
+        [](const SharedPtr<const StreamPreroll> &lhs, size_t rhs) -> bool
+        { return lhs->mNameHash < rhs; }
+    );
+    while(iter != mStreamPrerolls.end() && (*iter)->mNameHash == name_hash &&
+          (*iter)->mName != name)
+        ++iter;
+    if(iter != mStreamPrerolls.end() && (*iter)->mNameHash == name_hash)
+        *iter = std::move(preroll);
+    else
+        mStreamPrerolls.insert(iter, std::move(preroll));
+}
+
+DECL_THUNK1(void, Context, removeStreamPreroll,, StringView)
+void ContextImpl::removeStreamPreroll(StringView name)
+{
+    CheckContext(this);
+
+    size_t name_hash = std::hash<StringView>()(name);
+    auto iter = std::lower_bound(mStreamPrerolls.begin(), mStreamPrerolls.end(), name_hash,
+        [](const SharedPtr<const StreamPreroll> &lhs, size_t rhs) -> bool
+        { return lhs->mNameHash < rhs; }
+    );
+    while(iter != mStreamPrerolls.end() && (*iter)->mNameHash == name_hash)
+    {
+        if((*iter)->mName == name)
+        {
+            mStreamPrerolls.erase(iter);
+            break;
+        }
+        ++iter;
+    }
+}
+
+DECL_THUNK1(void, Context, precacheFileData,, StringView)
+void ContextImpl::precacheFileData(StringView name)
+{
+    CheckContext(this);
+
+    auto file = OpenFile(String(name));
+    if(UNLIKELY(!file))
+        throw std::runtime_error("Failed to open file");
+
+    // Read the whole file into one allocation, if its size can be found.
+    auto data = MakeShared<HookVector<char>>();
+    if(file->seekg(0, std::ios_base::end))
+    {
+        std::streamoff size = file->tellg();
+        if(size > 0) data->reserve(static_cast<size_t>(size));
+        file->seekg(0, std::ios_base::beg);
+    }
+    file->clear();
+
+    Array<char,4096> chunk;
+    while(file->read(chunk.data(), chunk.size()) || file->gcount() > 0)
+        data->insert(data->end(), chunk.data(), chunk.data()+file->gcount());
+    data->shrink_to_fit();
+
+    size_t name_hash = std::hash<StringView>()(name);
+    std::lock_guard<std::mutex> lock(mFileDataMutex);
+    auto iter = std::lower_bound(mFileData.begin(), mFileData.end(), name_hash,
+        [](const FileData &lhs, size_t rhs) -> bool
+        { return lhs.mNameHash < rhs; }
+    );
+    while(iter != mFileData.end() && iter->mNameHash == name_hash && iter->mName != name)
+        ++iter;
+    if(iter != mFileData.end() && iter->mNameHash == name_hash)
+        iter->mData = std::move(data);
+    else
+        mFileData.insert(iter, FileData{String(name), name_hash, std::move(data)});
+}
+
+DECL_THUNK1(void, Context, removeFileData,, StringView)
+void ContextImpl::removeFileData(StringView name)
+{
+    CheckContext(this);
+
+    size_t name_hash = std::hash<StringView>()(name);
+    std::lock_guard<std::mutex> lock(mFileDataMutex);
+    auto iter = std::lower_bound(mFileData.begin(), mFileData.end(), name_hash,
+        [](const FileData &lhs, size_t rhs) -> bool
+        { return lhs.mNameHash < rhs; }
+    );
+    while(iter != mFileData.end() && iter->mNameHash == name_hash)
+    {
+        if(iter->mName == name)
+        {
+            mFileData.erase(iter);
+            break;
+        }
+        ++iter;
+    }
+}
+
+SharedPtr<const HookVector<char>> ContextImpl::findFileData(StringView name)
+{
+    size_t name_hash = std::hash<StringView>()(name);
+    std::lock_guard<std::mutex> lock(mFileDataMutex);
+    auto iter = std::lower_bound(mFileData.begin(), mFileData.end(), name_hash,
+        [](const FileData &lhs, size_t rhs) -> bool
+        { return lhs.mNameHash < rhs; }
+    );
+    while(iter != mFileData.end() && iter->mNameHash == name_hash)
+    {
+        if(iter->mName == name)
+            return iter->mData;
+        ++iter;
+    }
+    return nullptr;
+}
+
+DECL_THUNK1(void, Context, setDecodeCacheDirectory,, StringView)
+void ContextImpl::setDecodeCacheDirectory(StringView path)
+{
+    CheckContext(this);
+    mDecodeCacheDir = String(path);
+}
+
+DECL_THUNK1(void, Context, setBufferDeduplication,, bool)
+void ContextImpl::setBufferDeduplication(bool enable)
+{
+    CheckContext(this);
+    mBufferDedup = enable;
+}
+
+bool ContextImpl::releaseBufferId(ALuint id, uint64_t data_hash)
+{
+    auto iter = FindSharedBufferId(mSharedBufferIds, id, data_hash);
+    if(iter == mSharedBufferIds.end())
+        return true;
+    if(--iter->mRefs > 0)
+        return false;
+    mSharedBufferIds.erase(iter);
+    return true;
+}
+
+bool ContextImpl::isBufferIdShared(ALuint id, uint64_t data_hash) const
+{
+    auto iter = FindSharedBufferId(mSharedBufferIds, id, data_hash);
+    return iter != mSharedBufferIds.end() && iter->mRefs > 1;
+}
+
+void ContextImpl::setSharedLoopPoints(ALuint id, uint64_t data_hash,
+                                      std::pair<uint64_t,uint64_t> loop_pts)
+{
+    auto iter = FindSharedBufferId(mSharedBufferIds, id, data_hash);
+    if(iter != mSharedBufferIds.end())
+        iter->mLoopPts = loop_pts;
+}
+
+DECL_THUNK2(void, Context, setDownmixToMono,, StringView, bool)
+void ContextImpl::setDownmixToMono(StringView name, bool enable)
+{
+    CheckContext(this);
+    size_t name_hash = std::hash<StringView>()(name);
+    auto iter = std::lower_bound(mMonoNames.begin(), mMonoNames.end(), name_hash,
+        [](const MonoName &lhs, size_t rhs) -> bool
+        { return lhs.mNameHash < rhs; }
+    );
+    while(iter != mMonoNames.end() && iter->mNameHash == name_hash && iter->mName != name)
+        ++iter;
+
+    bool found = (iter != mMonoNames.end() && iter->mNameHash == name_hash);
+    if(enable && !found)
+        mMonoNames.insert(iter, MonoName{name_hash, String(name)});
+    else if(!enable && found)
+        mMonoNames.erase(iter);
+}
+
+DECL_THUNK1(bool, Context, getDownmixToMono, const, StringView)
+bool ContextImpl::getDownmixToMono(StringView name) const
+{
+    size_t name_hash = std::hash<StringView>()(name);
+    auto iter = std::lower_bound(mMonoNames.begin(), mMonoNames.end(), name_hash,
+        [](const MonoName &lhs, size_t rhs) -> bool
+        { return lhs.mNameHash < rhs; }
+    );
+    while(iter != mMonoNames.end() && iter->mNameHash == name_hash)
+    {
+        if(iter->mName == name)
+            return true;
+        ++iter;
+    }
+    return false;
+}
+
+DECL_THUNK1(void, Context, setBufferStorage,, BufferStorage)
+void ContextImpl::setBufferStorage(BufferStorage storage)
+{
+    CheckContext(this);
+    mBufferStorage.store(storage, std::memory_order_relaxed);
+}
+
+DECL_THUNK1(void, Context, setSampleTypePolicy,, SampleTypePolicy)
+void ContextImpl::setSampleTypePolicy(SampleTypePolicy policy)
+{
+    CheckContext(this);
+    mSampleTypePolicy.store(policy, std::memory_order_relaxed);
+}
+
+DECL_THUNK1(void, Context, setStreamingThreshold,, uint64_t)
+void ContextImpl::setStreamingThreshold(uint64_t size)
+{
+    CheckContext(this);
+    mStreamingThreshold = size;
+}
+
+DECL_THUNK1(void, Context, setLoadResampling,, bool)
+void ContextImpl::setLoadResampling(bool enable)
+{
+    CheckContext(this);
+    mLoadResampling = enable;
+}
+
+ALuint ContextImpl::getLoadFrequency(ALuint srate) const
+{
+    if(!mLoadResampling) return srate;
+    return mDevice.getFrequency();
+}
+
+SharedPtr<const StreamPreroll> ContextImpl::findStreamPreroll(StringView name) const
+{
+    size_t name_hash = std::hash<StringView>()(name);
+    auto iter = std::lower_bound(mStreamPrerolls.begin(), mStreamPrerolls.end(), name_hash,
+        [](const SharedPtr<const StreamPreroll> &lhs, size_t rhs) -> bool
+        { return lhs->mNameHash < rhs; }
+    );
+    while(iter != mStreamPrerolls.end() && (*iter)->mNameHash == name_hash)
+    {
+        if((*iter)->mName == name)
+            return *iter;
+        ++iter;
+    }
+    return nullptr;
+}
+
+
 ALuint ContextImpl::getSourceId(ALuint maxprio)
 {
     ALuint id = 0;
@@ -1367,7 +1938,10 @@ ALuint ContextImpl::getSourceId(ALuint maxprio)
         alGetError();
         alGenSources(1, &id);
         if(alGetError() == AL_NO_ERROR)
+        {
+            ++mSourceIdCount;
             return id;
+        }
 
         SourceImpl *lowest = nullptr;
         for(SourceBufferUpdateEntry &entry : mPlaySources)
@@ -1383,6 +1957,7 @@ ALuint ContextImpl::getSourceId(ALuint maxprio)
         if(lowest && lowest->getPriority() < maxprio)
         {
             lowest->stop();
+            mStats.mForceStops.fetch_add(1, std::memory_order_relaxed);
             if(mMessage.get())
                 mMessage->sourceForceStopped(lowest);
         }
@@ -1395,6 +1970,19 @@ ALuint ContextImpl::getSourceId(ALuint maxprio)
     return id;
 }
 
+ALuint ContextImpl::getStreamBufferId()
+{
+    ALuint id = 0;
+    if(mStreamBufferIds.empty())
+        alGenBuffers(1, &id);
+    else
+    {
+        id = mStreamBufferIds.back();
+        mStreamBufferIds.pop_back();
+    }
+    return id;
+}
+
 
 DECL_THUNK0(Source, Context, createSource,)
 Source ContextImpl::createSource()
@@ -1518,14 +2106,14 @@ void ContextImpl::addStream(SourceImpl *source)
     auto iter = std::lower_bound(mStreamingSources.begin(), mStreamingSources.end(), source);
     if(iter == mStreamingSources.end() || *iter != source)
         mStreamingSources.insert(iter, source);
+    mStats.mStreamsActive.store(static_cast<ALuint>(mStreamingSources.size()),
+                                std::memory_order_relaxed);
 }
 
 void ContextImpl::removeStream(SourceImpl *source)
 {
     std::lock_guard<std::mutex> lock(mSourceStreamMutex);
-    auto iter = std::lower_bound(mStreamingSources.begin(), mStreamingSources.end(), source);
-    if(iter != mStreamingSources.end() && *iter == source)
-        mStreamingSources.erase(iter);
+    removeStreamNoLock(source);
 }
 
 void ContextImpl::removeStreamNoLock(SourceImpl *source)
@@ -1533,6 +2121,8 @@ void ContextImpl::removeStreamNoLock(SourceImpl *source)
     auto iter = std::lower_bound(mStreamingSources.begin(), mStreamingSources.end(), source);
     if(iter != mStreamingSources.end() && *iter == source)
         mStreamingSources.erase(iter);
+    mStats.mStreamsActive.store(static_cast<ALuint>(mStreamingSources.size()),
+                                std::memory_order_relaxed);
 }
 
 
@@ -1635,14 +2225,19 @@ DECL_THUNK0(void, Context, update,)
 void ContextImpl::update()
 {
     CheckContext(this);
-    mPendingSources.erase(
-        std::remove_if(mPendingSources.begin(), mPendingSources.end(),
-            [](PendingSource &entry) -> bool
-            { return !entry.mSource->checkPending(entry.mFuture); }
-        ), mPendingSources.end()
-    );
+    TraceSpan span("ContextImpl::update");
+    {
+        TraceSpan pendingspan("update: pending sources");
+        mPendingSources.erase(
+            std::remove_if(mPendingSources.begin(), mPendingSources.end(),
+                [](PendingSource &entry) -> bool
+                { return !entry.mSource->checkPending(entry.mFuture); }
+            ), mPendingSources.end()
+        );
+    }
     if(!mFadingSources.empty())
     {
+        TraceSpan fadespan("update: fading sources");
         auto cur_time = mDevice.getClockTime();
         mFadingSources.erase(
             std::remove_if(mFadingSources.begin(), mFadingSources.end(),
@@ -1651,18 +2246,21 @@ void ContextImpl::update()
             ), mFadingSources.end()
         );
     }
-    mPlaySources.erase(
-        std::remove_if(mPlaySources.begin(), mPlaySources.end(),
-            [](const SourceBufferUpdateEntry &entry) -> bool
-            { return !entry.mSource->playUpdate(entry.mId); }
-        ), mPlaySources.end()
-    );
-    mStreamSources.erase(
-        std::remove_if(mStreamSources.begin(), mStreamSources.end(),
-            [](const SourceStreamUpdateEntry &entry) -> bool
-            { return !entry.mSource->playUpdate(); }
-        ), mStreamSources.end()
-    );
+    {
+        TraceSpan playspan("update: playing sources");
+        mPlaySources.erase(
+            std::remove_if(mPlaySources.begin(), mPlaySources.end(),
+                [](const SourceBufferUpdateEntry &entry) -> bool
+                { return !entry.mSource->playUpdate(entry.mId); }
+            ), mPlaySources.end()
+        );
+        mStreamSources.erase(
+            std::remove_if(mStreamSources.begin(), mStreamSources.end(),
+                [](const SourceStreamUpdateEntry &entry) -> bool
+                { return !entry.mSource->playUpdate(); }
+            ), mStreamSources.end()
+        );
+    }
 
     if(!mWakeInterval.load(std::memory_order_relaxed).count())
     {
@@ -1674,6 +2272,7 @@ void ContextImpl::update()
 
     if(hasExtension(AL::EXT_disconnect) && mIsConnected)
     {
+        TraceSpan connspan("update: connection check");
         ALCint connected;
         alcGetIntegerv(mDevice.getALCdevice(), ALC_CONNECTED, 1, &connected);
         mIsConnected = static_cast<bool>(connected);
@@ -1681,8 +2280,37 @@ void ContextImpl::update()
     }
 }
 
+DECL_THUNK0(ContextStatistics, Context, getStatistics, const)
+ContextStatistics ContextImpl::getStatistics() const
+{
+    CheckContext(this);
+
+    ContextStatistics stats;
+    stats.mSourcesFree = static_cast<ALuint>(mSourceIds.size());
+    stats.mSourcesUsed = mSourceIdCount - stats.mSourcesFree;
+    stats.mStreamsActive = mStats.mStreamsActive.load(std::memory_order_relaxed);
+    stats.mPendingBuffers = mStats.mPendingBuffers.load(std::memory_order_relaxed);
+    stats.mStreamUnderruns = mStats.mStreamUnderruns.load(std::memory_order_relaxed);
+    stats.mStreamFramesLost = mStats.mStreamFramesLost.load(std::memory_order_relaxed);
+    stats.mForceStops = mStats.mForceStops.load(std::memory_order_relaxed);
+    stats.mBytesDecoded = mStats.mBytesDecoded.load(std::memory_order_relaxed);
+    stats.mBufferMemory = mStats.mBufferMemory.load(std::memory_order_relaxed);
+    for(size_t i = 0;i < ContextStatistics::NumDecodeTimeBuckets;++i)
+    {
+        stats.mBufferDecodeTimes[i] = mStats.mBufferDecodeTimes[i].load(std::memory_order_relaxed);
+        stats.mStreamDecodeTimes[i] = mStats.mStreamDecodeTimes[i].load(std::memory_order_relaxed);
+    }
+    return stats;
+}
+
 DECL_THUNK0(Device, Context, getDevice,)
 DECL_THUNK0(std::chrono::milliseconds, Context, getAsyncWakeInterval, const)
+DECL_THUNK0(uint64_t, Context, getStreamingThreshold, const)
+DECL_THUNK0(bool, Context, getLoadResampling, const)
+DECL_THUNK0(bool, Context, getBufferDeduplication, const)
+DECL_THUNK0(String, Context, getDecodeCacheDirectory, const)
+DECL_THUNK0(BufferStorage, Context, getBufferStorage, const)
+DECL_THUNK0(SampleTypePolicy, Context, getSampleTypePolicy, const)
 DECL_THUNK0(Listener, Context, getListener,)
 DECL_THUNK0(SharedPtr<MessageHandler>, Context, getMessageHandler, const)
 
@@ -12,6 +12,8 @@
 
 #include "main.h"
 
+#include "allocator.h"
+
 #include "device.h"
 #include "source.h"
 
@@ -31,6 +33,10 @@ enum class AL {
     EXT_MULAW_MCFORMATS,
     EXT_MULAW_BFORMAT,
 
+    SOFT_MSADPCM,
+    SOFT_block_alignment,
+    SOFT_buffer_sub_data,
+
     SOFT_loop_points,
     SOFT_source_latency,
     SOFT_source_resampler,
@@ -91,6 +97,68 @@ public:
 using DecoderOrExceptT = std::variant<SharedPtr<Decoder>,std::exception_ptr>;
 using BufferOrExceptT = std::variant<Buffer,std::exception_ptr>;
 
+// Decoded audio from the start of a streamed file, so a stream can start
+// playing it without waiting on its decoder. The audio is either held in mData,
+// or resident in the OpenAL buffer mBufferId.
+struct StreamPreroll {
+    String mName;
+    size_t mNameHash{0};
+
+    ALuint mFrequency{0};
+    ChannelConfig mChannels{ChannelConfig::Mono};
+    SampleType mType{SampleType::UInt8};
+    std::pair<uint64_t,uint64_t> mLoopPts{0,0};
+    // Whether the stream is downmixed to mono, which a resident head's buffer
+    // already is.
+    bool mMono{false};
+
+    ALsizei mFrames{0};
+    HookVector<ALbyte> mData;
+    ALuint mBufferId{0};
+
+    StreamPreroll() = default;
+    StreamPreroll(const StreamPreroll&) = delete;
+    ~StreamPreroll() { if(mBufferId) alDeleteBuffers(1, &mBufferId); }
+
+    StreamPreroll& operator=(const StreamPreroll&) = delete;
+};
+
+// A decoder for the background thread to open, for a stream that plays from
+// a preroll in the mean time. mDecoder is set, or left empty if the file
+// couldn't be opened, before mDone is.
+struct DecoderRequest {
+    String mName;
+    SharedPtr<Decoder> mDecoder;
+    std::atomic<bool> mDone{false};
+};
+
+// Counters for Context::getStatistics. They're updated by both the main and
+// background threads, so they're atomic instead of locked.
+struct ContextStats {
+    using HistogramT = Array<std::atomic<uint64_t>,ContextStatistics::NumDecodeTimeBuckets>;
+
+    std::atomic<ALuint> mStreamsActive{0};
+    std::atomic<ALuint> mPendingBuffers{0};
+    std::atomic<uint64_t> mStreamUnderruns{0};
+    std::atomic<uint64_t> mStreamFramesLost{0};
+    std::atomic<uint64_t> mForceStops{0};
+    std::atomic<uint64_t> mBytesDecoded{0};
+    std::atomic<uint64_t> mBufferMemory{0};
+    HistogramT mBufferDecodeTimes{};
+    HistogramT mStreamDecodeTimes{};
+
+    // Records a decode of the given size, which took the given time.
+    void addDecode(HistogramT &hist, std::chrono::nanoseconds time, size_t bytes)
+    {
+        auto usecs = std::chrono::duration_cast<std::chrono::microseconds>(time).count();
+        size_t bucket = 0;
+        while(bucket < hist.size()-1 && usecs >= (1ll<<bucket))
+            ++bucket;
+        hist[bucket].fetch_add(1, std::memory_order_relaxed);
+        mBytesDecoded.fetch_add(bytes, std::memory_order_relaxed);
+    }
+};
+
 class ContextImpl {
     static ContextImpl *sCurrentCtx;
     static thread_local ContextImpl *sThreadCurrentCtx;
@@ -119,6 +187,15 @@ private:
 
     ContextPtr mContext;
     Vector<ALuint> mSourceIds;
+    // The number of OpenAL sources generated, free or in use.
+    ALuint mSourceIdCount{0};
+    // Buffers for queueing stream chunks, kept between streams so playing a
+    // sound decoded on play doesn't generate and delete buffers each time.
+    Vector<ALuint> mStreamBufferIds;
+
+    mutable ContextStats mStats;
+
+    DecodeArena mDecodeArena;
 
     struct PendingBuffer { BufferImpl *mBuffer;  SharedFuture<Buffer> mFuture; };
     struct PendingSource { SourceImpl *mSource;  SharedFuture<Buffer> mFuture; };
@@ -128,6 +205,42 @@ private:
     DeviceImpl &mDevice;
     FutureBufferListT mFutureBuffers;
     BufferListT mBuffers;
+    Vector<SharedPtr<const StreamPreroll>> mStreamPrerolls;
+    uint64_t mStreamingThreshold{0};
+    // Names of files to downmix to mono, sorted by hash.
+    struct MonoName { size_t mNameHash; String mName; };
+    Vector<MonoName> mMonoNames;
+
+    // AL buffers shared by buffers loaded with identical data, sorted by
+    // hash. Data is considered identical when the hash, size, and format
+    // match, without comparing the samples.
+    struct SharedBufferId {
+        uint64_t mHash;
+        ALenum mFormat;
+        ALuint mFrequency;
+        size_t mSize;
+        std::pair<uint64_t,uint64_t> mLoopPts;
+        ALuint mId;
+        ALuint mRefs;
+    };
+    Vector<SharedBufferId> mSharedBufferIds;
+    bool mBufferDedup{false};
+
+    // Directory of decoded audio cached across runs, or empty.
+    String mDecodeCacheDir;
+    bool mLoadResampling{false};
+    std::atomic<BufferStorage> mBufferStorage{BufferStorage::Native};
+    std::atomic<SampleTypePolicy> mSampleTypePolicy{SampleTypePolicy::Native};
+
+    // Files kept in memory in their original (compressed) form. Guarded by a
+    // mutex since the background thread may open decoders from them.
+    struct FileData {
+        String mName;
+        size_t mNameHash;
+        SharedPtr<const HookVector<char>> mData;
+    };
+    Vector<FileData> mFileData;
+    std::mutex mFileDataMutex;
     Vector<UniquePtr<SourceGroupImpl>> mSourceGroups;
     Vector<UniquePtr<AuxiliaryEffectSlotImpl>> mEffectSlots;
     Vector<UniquePtr<EffectImpl>> mEffects;
@@ -150,6 +263,7 @@ private:
 
     struct PendingPromise {
         BufferImpl *mBuffer{nullptr};
+        size_t mNameHash{0};
         SharedPtr<Decoder> mDecoder;
         ALenum mFormat{AL_NONE};
         ALuint mFrames{0};
@@ -158,16 +272,37 @@ private:
         std::atomic<PendingPromise*> mNext{nullptr};
 
         PendingPromise() = default;
-        PendingPromise(BufferImpl *buffer, SharedPtr<Decoder> decoder, ALenum format,
-                       ALuint frames, Promise<Buffer> promise)
-          : mBuffer(buffer), mDecoder(std::move(decoder)), mFormat(format), mFrames(frames)
-          , mPromise(std::move(promise))
+        PendingPromise(BufferImpl *buffer, size_t name_hash, SharedPtr<Decoder> decoder,
+                       ALenum format, ALuint frames, Promise<Buffer> promise)
+          : mBuffer(buffer), mNameHash(name_hash), mDecoder(std::move(decoder)), mFormat(format)
+          , mFrames(frames), mPromise(std::move(promise))
         { }
+
+        static void *operator new(size_t size)
+        { return HookAllocator<PendingPromise>().allocate(size/sizeof(PendingPromise)); }
+        static void operator delete(void *ptr, size_t size) noexcept
+        {
+            HookAllocator<PendingPromise>().deallocate(static_cast<PendingPromise*>(ptr),
+                                                       size/sizeof(PendingPromise));
+        }
     };
+    // The background thread works through the pending list from the tail,
+    // setting current to each promise it fulfills. Promises up to the swept
+    // one have had their mFutureBuffers entries removed, and can be reused.
     std::atomic<PendingPromise*> mPendingCurrent{nullptr};
+    PendingPromise *mPendingSwept{nullptr};
     PendingPromise *mPendingTail{nullptr};
     PendingPromise *mPendingHead{nullptr};
 
+    // Decoders for the background thread to open, in the order requested.
+    Vector<SharedPtr<DecoderRequest>> mDecoderRequests;
+    std::mutex mDecoderRequestMutex;
+    bool hasDecoderRequests()
+    {
+        std::lock_guard<std::mutex> lock(mDecoderRequestMutex);
+        return !mDecoderRequests.empty();
+    }
+
     std::atomic<bool> mQuitThread{false};
     std::thread mThread;
     void backgroundProc();
@@ -181,7 +316,7 @@ private:
     std::once_flag mSetExts;
     void setupExts();
 
-    DecoderOrExceptT findDecoder(StringView name);
+    void doPrecacheStream(StringView name, std::chrono::milliseconds duration, bool resident);
     BufferOrExceptT doCreateBuffer(StringView name, size_t name_hash, BufferListT::const_iterator iter, SharedPtr<Decoder> decoder);
     BufferOrExceptT doCreateBufferAsync(StringView name, size_t name_hash, BufferListT::const_iterator iter, SharedPtr<Decoder> decoder, Promise<Buffer> promise);
 
@@ -201,6 +336,7 @@ public:
     LPALGETSTRINGISOFT alGetStringiSOFT{nullptr};
     LPALGETSOURCEI64VSOFT alGetSourcei64vSOFT{nullptr};
     LPALGETSOURCEDVSOFT alGetSourcedvSOFT{nullptr};
+    PFNALBUFFERSUBDATASOFTPROC alBufferSubDataSOFT{nullptr};
 
     LPALGENEFFECTS alGenEffects{nullptr};
     LPALDELETEEFFECTS alDeleteEffects{nullptr};
@@ -239,10 +375,13 @@ public:
     LPALGETAUXILIARYEFFECTSLOTFV alGetAuxiliaryEffectSlotfv{nullptr};
 
     FutureBufferListT::const_iterator findFutureBufferName(StringView name, size_t name_hash) const;
+    void sweepFutureBuffers();
     BufferListT::const_iterator findBufferName(StringView name, size_t name_hash) const;
 
     ALuint getSourceId(ALuint maxprio);
     void insertSourceId(ALuint id) { mSourceIds.push_back(id); }
+    ALuint getStreamBufferId();
+    void insertStreamBufferId(ALuint id) { mStreamBufferIds.push_back(id); }
 
     void addPendingSource(SourceImpl *source, SharedFuture<Buffer> future);
     void removePendingSource(SourceImpl *source);
@@ -273,6 +412,12 @@ public:
     std::unique_lock<std::mutex> getSourceStreamLock()
     { return std::unique_lock<std::mutex>(mSourceStreamMutex); }
 
+    void wakeThread()
+    {
+        mWakeMutex.lock(); mWakeMutex.unlock();
+        mWakeThread.notify_all();
+    }
+
     template<typename R, typename... Args>
     void send(R MessageHandler::* func, Args&&... args)
     { if(mMessage.get()) (mMessage.get()->*func)(std::forward<Args>(args)...); }
@@ -289,10 +434,25 @@ public:
     SharedPtr<MessageHandler> setMessageHandler(SharedPtr<MessageHandler>&& handler);
     SharedPtr<MessageHandler> getMessageHandler() const { return mMessage; }
 
+    // Whether samples of the given type can be uploaded to a buffer in chunks
+    // as they're decoded, which needs AL_SOFT_buffer_sub_data, and for the
+    // samples to be stored as decoded. The message handler is given each chunk
+    // as it's uploaded.
+    bool canUploadChunked(SampleType type) const
+    {
+        return hasExtension(AL::SOFT_buffer_sub_data) &&
+               (getBufferStorage() == BufferStorage::Native || type == SampleType::Mulaw);
+    }
+
     void setAsyncWakeInterval(std::chrono::milliseconds interval);
     std::chrono::milliseconds getAsyncWakeInterval() const { return mWakeInterval.load(); }
 
+    // Opens a decoder for the named file. If substitute is true and the file
+    // can't be opened, the message handler is asked for a substitute.
+    DecoderOrExceptT findDecoder(StringView name, bool substitute=true);
     SharedPtr<Decoder> createDecoder(StringView name);
+    // Has the background thread open a decoder for the named file.
+    SharedPtr<DecoderRequest> requestDecoder(StringView name);
 
     bool isSupported(ChannelConfig channels, SampleType type) const;
 
@@ -309,6 +469,58 @@ public:
     void removeBuffer(StringView name);
     void removeBuffer(Buffer buffer) { removeBuffer(buffer.getName()); }
 
+    void precacheStreamPreroll(StringView name, std::chrono::milliseconds duration)
+    { doPrecacheStream(name, duration, false); }
+    void precacheStreamHead(StringView name, std::chrono::milliseconds duration)
+    { doPrecacheStream(name, duration, true); }
+    void removeStreamPreroll(StringView name);
+
+    void precacheFileData(StringView name);
+    void removeFileData(StringView name);
+
+    void setDecodeCacheDirectory(StringView path);
+    String getDecodeCacheDirectory() const { return mDecodeCacheDir; }
+
+    void setBufferDeduplication(bool enable);
+    bool getBufferDeduplication() const { return mBufferDedup; }
+    // Drops a buffer's reference to its AL buffer ID, given the buffer's data
+    // hash. Returns false if the ID is shared with another buffer, in which
+    // case it must not be deleted.
+    bool releaseBufferId(ALuint id, uint64_t data_hash);
+    bool isBufferIdShared(ALuint id, uint64_t data_hash) const;
+    // Updates the loop points a buffer's shared AL buffer ID is matched with,
+    // after they're changed on an ID that isn't shared yet.
+    void setSharedLoopPoints(ALuint id, uint64_t data_hash,
+                             std::pair<uint64_t,uint64_t> loop_pts);
+
+    void setDownmixToMono(StringView name, bool enable);
+    bool getDownmixToMono(StringView name) const;
+
+    void setBufferStorage(BufferStorage storage);
+    BufferStorage getBufferStorage() const { return mBufferStorage.load(std::memory_order_relaxed); }
+
+    void setSampleTypePolicy(SampleTypePolicy policy);
+    SampleTypePolicy getSampleTypePolicy() const
+    { return mSampleTypePolicy.load(std::memory_order_relaxed); }
+    // The sample type buffers loaded from a decoder of the given type are
+    // stored as.
+    SampleType getBufferSampleType(SampleType type) const
+    {
+        if(type == SampleType::Float32 && getSampleTypePolicy() == SampleTypePolicy::PreferInt16)
+            return SampleType::Int16;
+        return type;
+    }
+
+    void setStreamingThreshold(uint64_t size);
+    uint64_t getStreamingThreshold() const { return mStreamingThreshold; }
+
+    void setLoadResampling(bool enable);
+    bool getLoadResampling() const { return mLoadResampling; }
+    // The frequency to store samples decoded at the given frequency.
+    ALuint getLoadFrequency(ALuint srate) const;
+    SharedPtr<const StreamPreroll> findStreamPreroll(StringView name) const;
+    SharedPtr<const HookVector<char>> findFileData(StringView name);
+
     Source createSource();
 
     AuxiliaryEffectSlot createAuxiliaryEffectSlot();
@@ -324,6 +536,10 @@ public:
     void setDistanceModel(DistanceModel model);
 
     void update();
+
+    ContextStats &getStats() const { return mStats; }
+    DecodeArena &getDecodeArena() { return mDecodeArena; }
+    ContextStatistics getStatistics() const;
 };
 
 
@@ -51,8 +51,11 @@ class FlacDecoder final : public Decoder {
             else
                 return;
 
-            if(info.bitsPerSample > 16 &&
-               Context::GetCurrent().isSupported(self->mChannelConfig, SampleType::Float32))
+            Context context = Context::GetCurrent();
+            SampleTypePolicy policy = context.getSampleTypePolicy();
+            if((info.bitsPerSample > 16 || policy == SampleTypePolicy::PreferFloat32) &&
+               policy != SampleTypePolicy::PreferInt16 &&
+               context.isSupported(self->mChannelConfig, SampleType::Float32))
                 self->mSampleType = SampleType::Float32;
             else
                 self->mSampleType = SampleType::Int16;
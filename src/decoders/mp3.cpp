@@ -6,6 +6,7 @@
 #include <cassert>
 
 #include "context.h"
+#include "sampleconv.h"
 
 #define MINIMP3_IMPLEMENTATION
 #define MINIMP3_FLOAT_OUTPUT
@@ -285,7 +286,7 @@ ALuint Mp3Decoder::read(ALvoid *ptr, ALuint count) noexcept
             }
             else
             {
-                mp3dec_f32_to_s16(mSampleData.data(), dst.s, numspl);
+                ConvertF32ToS16(dst.s, mSampleData.data(), numspl);
                 dst.s += numspl;
             }
             mSampleData.erase(mSampleData.begin(), mSampleData.begin()+numspl);
@@ -388,7 +389,9 @@ SharedPtr<Decoder> Mp3DecoderFactory::createDecoder(UniquePtr<std::istream> &fil
         return nullptr;
 
     SampleType stype = SampleType::Int16;
-    if(ContextImpl::GetCurrent()->isSupported(chans, SampleType::Float32))
+    ContextImpl *context = ContextImpl::GetCurrent();
+    if(context->getSampleTypePolicy() != SampleTypePolicy::PreferInt16 &&
+       context->isSupported(chans, SampleType::Float32))
         stype = SampleType::Float32;
 
     return MakeShared<Mp3Decoder>(std::move(file), std::move(initial_data), mp3,
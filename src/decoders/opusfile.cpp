@@ -260,7 +260,9 @@ SharedPtr<Decoder> OpusFileDecoderFactory::createDecoder(UniquePtr<std::istream>
     else
         return nullptr;
 
-    if(Context::GetCurrent().isSupported(channels, SampleType::Float32))
+    Context context = Context::GetCurrent();
+    if(context.getSampleTypePolicy() != SampleTypePolicy::PreferInt16 &&
+       context.isSupported(channels, SampleType::Float32))
         return MakeShared<OpusFileDecoder>(std::move(file), std::move(oggfile), channels,
                                            SampleType::Float32, loop_points);
     return MakeShared<OpusFileDecoder>(std::move(file), std::move(oggfile), channels,
@@ -0,0 +1,94 @@
+#include "pack.hpp"
+
+#include <stdexcept>
+#include <iostream>
+#include <cstring>
+
+#include "packfile.h"
+
+
+namespace alure {
+
+class PackDecoder final : public Decoder {
+    UniquePtr<std::istream> mFile;
+
+    ChannelConfig mChannelConfig{ChannelConfig::Mono};
+    SampleType mSampleType{SampleType::UInt8};
+    ALuint mFrequency{0};
+    ALuint mFrameSize{0};
+    std::pair<uint64_t,uint64_t> mLoopPts{0, 0};
+
+    // In sample frames
+    uint64_t mLength{0};
+    uint64_t mCurrentPos{0};
+
+public:
+    PackDecoder(UniquePtr<std::istream> file, ChannelConfig channels, SampleType type,
+                ALuint frequency, uint64_t length, uint64_t loopstart, uint64_t loopend) noexcept
+      : mFile(std::move(file)), mChannelConfig(channels), mSampleType(type), mFrequency(frequency)
+      , mFrameSize(FramesToBytes(1, channels, type)), mLoopPts{loopstart,loopend}, mLength(length)
+    { }
+    ~PackDecoder() override { }
+
+    ALuint getFrequency() const noexcept override { return mFrequency; }
+    ChannelConfig getChannelConfig() const noexcept override { return mChannelConfig; }
+    SampleType getSampleType() const noexcept override { return mSampleType; }
+
+    uint64_t getLength() const noexcept override { return mLength; }
+    bool seek(uint64_t pos) noexcept override;
+
+    std::pair<uint64_t,uint64_t> getLoopPoints() const noexcept override { return mLoopPts; }
+
+    ALuint read(ALvoid *ptr, ALuint count) noexcept override;
+};
+
+bool PackDecoder::seek(uint64_t pos) noexcept
+{
+    if(pos > mLength) return false;
+    mFile->clear();
+    if(!mFile->seekg(sizeof(PackPcmHeader) + pos*mFrameSize))
+        return false;
+    mCurrentPos = pos;
+    return true;
+}
+
+ALuint PackDecoder::read(ALvoid *ptr, ALuint count) noexcept
+{
+    mFile->clear();
+
+    count = static_cast<ALuint>(std::min<uint64_t>(count, mLength-mCurrentPos));
+    mFile->read(reinterpret_cast<char*>(ptr), count*mFrameSize);
+    ALuint got = static_cast<ALuint>(mFile->gcount()) / mFrameSize;
+
+    mCurrentPos += got;
+    return got;
+}
+
+
+SharedPtr<Decoder> PackDecoderFactory::createDecoder(UniquePtr<std::istream> &file) noexcept
+{
+    PackPcmHeader header;
+    if(!file->read(reinterpret_cast<char*>(&header), sizeof(header)) ||
+       file->gcount() != sizeof(header) ||
+       std::memcmp(header.mMagic, PackPcmMagic, sizeof(PackPcmMagic)) != 0)
+        return nullptr;
+
+    if(header.mChannels > static_cast<uint32_t>(ChannelConfig::BFormat3D) ||
+       header.mType > static_cast<uint32_t>(SampleType::Mulaw) || header.mFrequency == 0)
+        return nullptr;
+    auto channels = static_cast<ChannelConfig>(header.mChannels);
+    auto type = static_cast<SampleType>(header.mType);
+
+    // Make sure the entry actually holds all the frames it claims to.
+    if(!file->seekg(0, std::ios::end))
+        return nullptr;
+    uint64_t datasize = static_cast<uint64_t>(file->tellg()) - sizeof(header);
+    if(datasize / FramesToBytes(1, channels, type) < header.mNumFrames ||
+       !file->seekg(sizeof(header)))
+        return nullptr;
+
+    return MakeShared<PackDecoder>(std::move(file), channels, type, header.mFrequency,
+                                   header.mNumFrames, header.mLoopStart, header.mLoopEnd);
+}
+
+} // namespace alure
@@ -0,0 +1,15 @@
+#ifndef DECODERS_PACK_HPP
+#define DECODERS_PACK_HPP
+
+#include "alure2.h"
+
+namespace alure {
+
+// Reads the PCM entries of pack files.
+class PackDecoderFactory final : public DecoderFactory {
+    SharedPtr<Decoder> createDecoder(UniquePtr<std::istream> &file) noexcept override;
+};
+
+} // namespace alure
+
+#endif /* DECODERS_PACK_HPP */
@@ -234,6 +234,8 @@ SharedPtr<Decoder> SndFileDecoderFactory::createDecoder(UniquePtr<std::istream>
     else
         return nullptr;
 
+    Context context = Context::GetCurrent();
+    SampleTypePolicy policy = context.getSampleTypePolicy();
     SampleType stype = SampleType::Int16;
     switch(sndinfo.format&SF_FORMAT_SUBMASK)
     {
@@ -241,13 +243,20 @@ SharedPtr<Decoder> SndFileDecoderFactory::createDecoder(UniquePtr<std::istream>
             stype = SampleType::UInt8;
             break;
         case SF_FORMAT_ULAW:
-            if(Context::GetCurrent().isSupported(sconfig, SampleType::Mulaw))
+            if(context.isSupported(sconfig, SampleType::Mulaw))
                 stype = SampleType::Mulaw;
             break;
         case SF_FORMAT_FLOAT:
         case SF_FORMAT_DOUBLE:
         case SF_FORMAT_VORBIS:
-            if(Context::GetCurrent().isSupported(sconfig, SampleType::Float32))
+            if(policy != SampleTypePolicy::PreferInt16 &&
+               context.isSupported(sconfig, SampleType::Float32))
+                stype = SampleType::Float32;
+            break;
+        case SF_FORMAT_PCM_24:
+        case SF_FORMAT_PCM_32:
+            if(policy == SampleTypePolicy::PreferFloat32 &&
+               context.isSupported(sconfig, SampleType::Float32))
                 stype = SampleType::Float32;
             break;
         default:
@@ -4,6 +4,7 @@
 #include <iostream>
 
 #include "context.h"
+#include "sampleconv.h"
 
 #include "vorbis/vorbisfile.h"
 
@@ -64,16 +65,39 @@ class VorbisFileDecoder final : public Decoder {
     int mOggBitstream{0};
 
     ChannelConfig mChannelConfig{ChannelConfig::Mono};
+    SampleType mSampleType{SampleType::Int16};
+
+    // The Vorbis channel each OpenAL channel is read from. 1, 2, and 4
+    // channel files decode into the same channel order as OpenAL, however 6
+    // (5.1), 7 (6.1), and 8 (7.1) channel files need to be re-ordered.
+    Array<int,8> mChannelMap{{0, 1, 2, 3, 4, 5, 6, 7}};
+
+    // Interleaved float samples, before converting to 16-bit.
+    static constexpr ALuint MaxReadFrames{1024};
+    Array<float,MaxReadFrames*8> mSampleData;
 
     std::pair<uint64_t,uint64_t> mLoopPoints{0, 0};
 
 public:
     VorbisFileDecoder(UniquePtr<std::istream> file, OggVorbisfilePtr oggfile,
-                      vorbis_info *vorbisinfo, ChannelConfig sconfig,
+                      vorbis_info *vorbisinfo, ChannelConfig sconfig, SampleType stype,
                       std::pair<uint64_t,uint64_t> loop_points) noexcept
       : mFile(std::move(file)), mOggFile(std::move(oggfile)), mVorbisInfo(vorbisinfo)
-      , mChannelConfig(sconfig), mLoopPoints(loop_points)
-    { }
+      , mChannelConfig(sconfig), mSampleType(stype), mLoopPoints(loop_points)
+    {
+        // OpenAL : FL, FR, FC, LFE, RL, RR
+        // Vorbis : FL, FC, FR,  RL, RR, LFE
+        if(mChannelConfig == ChannelConfig::X51)
+            mChannelMap = {{0, 2, 1, 5, 3, 4}};
+        // OpenAL : FL, FR, FC, LFE, RC, SL, SR
+        // Vorbis : FL, FC, FR,  SL, SR, RC, LFE
+        else if(mChannelConfig == ChannelConfig::X61)
+            mChannelMap = {{0, 2, 1, 6, 5, 3, 4}};
+        // OpenAL : FL, FR, FC, LFE, RL, RR, SL, SR
+        // Vorbis : FL, FC, FR,  SL, SR, RL, RR, LFE
+        else if(mChannelConfig == ChannelConfig::X71)
+            mChannelMap = {{0, 2, 1, 7, 5, 6, 3, 4}};
+    }
     ~VorbisFileDecoder() override { }
 
     ALuint getFrequency() const noexcept override;
@@ -88,9 +112,11 @@ public:
     ALuint read(ALvoid *ptr, ALuint count) noexcept override;
 };
 
+constexpr ALuint VorbisFileDecoder::MaxReadFrames;
+
 ALuint VorbisFileDecoder::getFrequency() const noexcept { return mVorbisInfo->rate; }
 ChannelConfig VorbisFileDecoder::getChannelConfig() const noexcept { return mChannelConfig; }
-SampleType VorbisFileDecoder::getSampleType() const noexcept { return SampleType::Int16; }
+SampleType VorbisFileDecoder::getSampleType() const noexcept { return mSampleType; }
 
 uint64_t VorbisFileDecoder::getLength() const noexcept
 {
@@ -110,65 +136,28 @@ std::pair<uint64_t,uint64_t> VorbisFileDecoder::getLoopPoints() const noexcept
 
 ALuint VorbisFileDecoder::read(ALvoid *ptr, ALuint count) noexcept
 {
+    const int numchans = mVorbisInfo->channels;
+    const float *chanptrs[8];
+
     ALuint total = 0;
-    ALshort *samples = (ALshort*)ptr;
     while(total < count)
     {
-        int len = (count-total) * mVorbisInfo->channels * 2;
-#ifdef __BIG_ENDIAN__
-        long got = ov_read(mOggFile.get(), reinterpret_cast<char*>(samples), len, 1, 2, 1, &mOggBitstream);
-#else
-        long got = ov_read(mOggFile.get(), reinterpret_cast<char*>(samples), len, 0, 2, 1, &mOggBitstream);
-#endif
+        float **pcm;
+        int todo = static_cast<int>(std::min<ALuint>(count-total, MaxReadFrames));
+        long got = ov_read_float(mOggFile.get(), &pcm, todo, &mOggBitstream);
         if(got <= 0) break;
 
-        got /= 2;
-        samples += got;
-        got /= mVorbisInfo->channels;
-        total += got;
-    }
-
-    // 1, 2, and 4 channel files decode into the same channel order as
-    // OpenAL, however 6 (5.1), 7 (6.1), and 8 (7.1) channel files need to be
-    // re-ordered.
-    if(mChannelConfig == ChannelConfig::X51)
-    {
-        samples = (ALshort*)ptr;
-        for(ALuint i = 0;i < total;++i)
+        for(int c = 0;c < numchans;++c)
+            chanptrs[c] = pcm[mChannelMap[c]];
+        if(mSampleType == SampleType::Float32)
+            InterleaveF32(static_cast<float*>(ptr) + total*numchans, chanptrs, numchans, got);
+        else
         {
-            // OpenAL : FL, FR, FC, LFE, RL, RR
-            // Vorbis : FL, FC, FR,  RL, RR, LFE
-            std::swap(samples[i*6 + 1], samples[i*6 + 2]);
-            std::swap(samples[i*6 + 3], samples[i*6 + 5]);
-            std::swap(samples[i*6 + 4], samples[i*6 + 5]);
-        }
-    }
-    else if(mChannelConfig == ChannelConfig::X61)
-    {
-        samples = (ALshort*)ptr;
-        for(ALuint i = 0;i < total;++i)
-        {
-            // OpenAL : FL, FR, FC, LFE, RC, SL, SR
-            // Vorbis : FL, FC, FR,  SL, SR, RC, LFE
-            std::swap(samples[i*7 + 1], samples[i*7 + 2]);
-            std::swap(samples[i*7 + 3], samples[i*7 + 6]);
-            std::swap(samples[i*7 + 4], samples[i*7 + 5]);
-            std::swap(samples[i*7 + 5], samples[i*7 + 6]);
-        }
-    }
-    else if(mChannelConfig == ChannelConfig::X71)
-    {
-        samples = (ALshort*)ptr;
-        for(ALuint i = 0;i < total;++i)
-        {
-            // OpenAL : FL, FR, FC, LFE, RL, RR, SL, SR
-            // Vorbis : FL, FC, FR,  SL, SR, RL, RR, LFE
-            std::swap(samples[i*8 + 1], samples[i*8 + 2]);
-            std::swap(samples[i*8 + 3], samples[i*8 + 7]);
-            std::swap(samples[i*8 + 4], samples[i*8 + 5]);
-            std::swap(samples[i*8 + 5], samples[i*8 + 6]);
-            std::swap(samples[i*8 + 6], samples[i*8 + 7]);
+            InterleaveF32(mSampleData.data(), chanptrs, numchans, got);
+            ConvertF32ToS16(static_cast<int16_t*>(ptr) + total*numchans, mSampleData.data(),
+                            got*numchans);
         }
+        total += got;
     }
 
     return total;
@@ -243,8 +232,16 @@ SharedPtr<Decoder> VorbisFileDecoderFactory::createDecoder(UniquePtr<std::istrea
     else
         return nullptr;
 
+    // Vorbis decodes to float, so 16-bit output is a conversion that can be
+    // skipped when float is preferred.
+    SampleType stype = SampleType::Int16;
+    Context context = Context::GetCurrent();
+    if(context.getSampleTypePolicy() == SampleTypePolicy::PreferFloat32 &&
+       context.isSupported(channels, SampleType::Float32))
+        stype = SampleType::Float32;
+
     return MakeShared<VorbisFileDecoder>(
-        std::move(file), std::move(oggfile), vorbisinfo, channels, loop_points
+        std::move(file), std::move(oggfile), vorbisinfo, channels, stype, loop_points
     );
 }
 
@@ -37,6 +37,37 @@ void LoadPauseDevice(DeviceImpl *device)
 
 void LoadNothing(DeviceImpl*) { }
 
+ALCenum GetLoopbackChannels(alure::ChannelConfig chans)
+{
+    switch(chans)
+    {
+        case alure::ChannelConfig::Mono: return ALC_MONO_SOFT;
+        case alure::ChannelConfig::Stereo: return ALC_STEREO_SOFT;
+        case alure::ChannelConfig::Quad: return ALC_QUAD_SOFT;
+        case alure::ChannelConfig::X51: return ALC_5POINT1_SOFT;
+        case alure::ChannelConfig::X61: return ALC_6POINT1_SOFT;
+        case alure::ChannelConfig::X71: return ALC_7POINT1_SOFT;
+        case alure::ChannelConfig::Rear:
+        case alure::ChannelConfig::BFormat2D:
+        case alure::ChannelConfig::BFormat3D:
+            break;
+    }
+    return 0;
+}
+
+ALCenum GetLoopbackType(alure::SampleType type)
+{
+    switch(type)
+    {
+        case alure::SampleType::UInt8: return ALC_UNSIGNED_BYTE_SOFT;
+        case alure::SampleType::Int16: return ALC_SHORT_SOFT;
+        case alure::SampleType::Float32: return ALC_FLOAT_SOFT;
+        case alure::SampleType::Mulaw:
+            break;
+    }
+    return 0;
+}
+
 static const struct {
     ALC extension;
     const char name[32];
@@ -74,6 +105,36 @@ DeviceImpl::DeviceImpl(const char *name)
     mPauseTime = mTimeBase = std::chrono::steady_clock::now().time_since_epoch();
 }
 
+DeviceImpl::DeviceImpl(ChannelConfig chans, SampleType type, ALCuint frequency)
+{
+    mLoopbackChannels = GetLoopbackChannels(chans);
+    mLoopbackType = GetLoopbackType(type);
+    if(!mLoopbackChannels || !mLoopbackType || frequency == 0)
+        throw std::runtime_error(String("Unsupported loopback format (")+
+            GetSampleTypeName(type)+", "+GetChannelConfigName(chans)+", "+
+            std::to_string(frequency)+"hz)");
+
+    mDevice = DeviceManagerImpl::LoopbackOpenDevice(nullptr);
+    if(!mDevice) throw alc_error(alcGetError(nullptr), "alcLoopbackOpenDeviceSOFT failed");
+
+    LoadALCFunc(mDevice, &alcIsRenderFormatSupportedSOFT, "alcIsRenderFormatSupportedSOFT");
+    LoadALCFunc(mDevice, &alcRenderSamplesSOFT, "alcRenderSamplesSOFT");
+    if(!alcIsRenderFormatSupportedSOFT || !alcRenderSamplesSOFT ||
+       !alcIsRenderFormatSupportedSOFT(mDevice, frequency, mLoopbackChannels, mLoopbackType))
+    {
+        alcCloseDevice(mDevice);
+        mDevice = nullptr;
+        throw std::runtime_error(String("Unsupported loopback format (")+
+            GetSampleTypeName(type)+", "+GetChannelConfigName(chans)+", "+
+            std::to_string(frequency)+"hz)");
+    }
+    mIsLoopback = true;
+    mLoopbackFrequency = frequency;
+
+    setupExts();
+    mPauseTime = mTimeBase = std::chrono::steady_clock::now().time_since_epoch();
+}
+
 DeviceImpl::~DeviceImpl()
 {
     mContexts.clear();
@@ -144,6 +205,9 @@ Version DeviceImpl::getEFXVersion() const
 DECL_THUNK0(ALCuint, Device, getFrequency, const)
 ALCuint DeviceImpl::getFrequency() const
 {
+    if(mIsLoopback)
+        return mLoopbackFrequency;
+
     ALCint freq = -1;
     alcGetIntegerv(mDevice, ALC_FREQUENCY, 1, &freq);
     if(freq < 0)
@@ -242,7 +306,25 @@ Context DeviceImpl::createContext(ArrayView<AttributePair> attributes)
 {
     auto cur_time = std::chrono::steady_clock::now().time_since_epoch();
     Vector<AttributePair> attrs;
-    if(!attributes.empty())
+    if(mIsLoopback)
+    {
+        /* Loopback contexts need the output format, which is the one the
+         * device was opened with.
+         */
+        for(const AttributePair &attr : attributes)
+        {
+            if(attr.mAttribute == 0) break;
+            if(attr.mAttribute != ALC_FORMAT_CHANNELS_SOFT &&
+               attr.mAttribute != ALC_FORMAT_TYPE_SOFT && attr.mAttribute != ALC_FREQUENCY)
+                attrs.push_back(attr);
+        }
+        attrs.push_back(AttributePair{ALC_FORMAT_CHANNELS_SOFT, mLoopbackChannels});
+        attrs.push_back(AttributePair{ALC_FORMAT_TYPE_SOFT, mLoopbackType});
+        attrs.push_back(AttributePair{ALC_FREQUENCY, static_cast<ALCint>(mLoopbackFrequency)});
+        attrs.push_back(AttributesEnd());
+        attributes = attrs;
+    }
+    else if(!attributes.empty())
     {
         auto attr_end = std::find_if(attributes.rbegin(), attributes.rend(),
             [](const AttributePair &attr) -> bool
@@ -282,6 +364,23 @@ Context Device::createContext(ArrayView<AttributePair> attrs, const std::nothrow
 }
 
 
+DECL_THUNK0(bool, Device, isLoopback, const)
+
+DECL_THUNK2(void, Device, render,, ALvoid*, ALCsizei)
+void DeviceImpl::render(ALvoid *buffer, ALCsizei frames)
+{
+    if(!mIsLoopback)
+        throw std::runtime_error("Rendering a non-loopback device");
+    if(mContexts.empty())
+        throw std::runtime_error("Rendering a device without a context");
+    if(frames < 0)
+        throw std::domain_error("Invalid frame count");
+
+    alcRenderSamplesSOFT(mDevice, buffer, frames);
+    if(!mIsPaused)
+        mRenderedFrames += frames;
+}
+
 DECL_THUNK0(void, Device, pauseDSP,)
 void DeviceImpl::pauseDSP()
 {
@@ -310,6 +409,15 @@ void DeviceImpl::resumeDSP()
 DECL_THUNK0(std::chrono::nanoseconds, Device, getClockTime,)
 std::chrono::nanoseconds DeviceImpl::getClockTime()
 {
+    if(mIsLoopback)
+    {
+        // Loopback devices are only as far along as they've been rendered.
+        return std::chrono::seconds(mRenderedFrames / mLoopbackFrequency) +
+            std::chrono::nanoseconds(
+                (mRenderedFrames%mLoopbackFrequency) * 1000000000 / mLoopbackFrequency
+            );
+    }
+
     std::chrono::nanoseconds cur_time = std::chrono::steady_clock::now().time_since_epoch();
     if(UNLIKELY(mPauseTime != mPauseTime.zero()))
     {
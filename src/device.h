@@ -24,6 +24,14 @@ class DeviceImpl {
     std::chrono::nanoseconds mTimeBase, mPauseTime;
     bool mIsPaused{false};
 
+    // The output format of loopback devices, and the number of sample frames
+    // rendered which drives the clock.
+    bool mIsLoopback{false};
+    ALCint mLoopbackChannels{0};
+    ALCint mLoopbackType{0};
+    ALCuint mLoopbackFrequency{0};
+    uint64_t mRenderedFrames{0};
+
     Vector<UniquePtr<ContextImpl>> mContexts;
 
     Bitfield<static_cast<size_t>(ALC::EXTENSION_MAX)> mHasExt;
@@ -33,6 +41,7 @@ class DeviceImpl {
 
 public:
     DeviceImpl(const char *name);
+    DeviceImpl(ChannelConfig chans, SampleType type, ALCuint frequency);
     ~DeviceImpl();
 
     ALCdevice *getALCdevice() const { return mDevice; }
@@ -45,6 +54,9 @@ public:
     LPALCGETSTRINGISOFT alcGetStringiSOFT{nullptr};
     LPALCRESETDEVICESOFT alcResetDeviceSOFT{nullptr};
 
+    LPALCISRENDERFORMATSUPPORTEDSOFT alcIsRenderFormatSupportedSOFT{nullptr};
+    LPALCRENDERSAMPLESSOFT alcRenderSamplesSOFT{nullptr};
+
     void removeContext(ContextImpl *ctx);
 
     String getName(PlaybackName type) const;
@@ -64,6 +76,9 @@ public:
 
     Context createContext(ArrayView<AttributePair> attributes);
 
+    bool isLoopback() const { return mIsLoopback; }
+    void render(ALvoid *buffer, ALCsizei frames);
+
     void pauseDSP();
     void resumeDSP();
 
@@ -54,6 +54,7 @@ static inline void GetDeviceProc(T *&func, ALCdevice *device, const char *name)
 
 WeakPtr<DeviceManagerImpl> DeviceManagerImpl::sInstance;
 ALCboolean (ALC_APIENTRY*DeviceManagerImpl::SetThreadContext)(ALCcontext*);
+LPALCLOOPBACKOPENDEVICESOFT DeviceManagerImpl::LoopbackOpenDevice;
 
 DeviceManager::DeviceManager(SharedPtr<DeviceManagerImpl>&& impl) noexcept
   : pImpl(std::move(impl))
@@ -79,6 +80,8 @@ DeviceManagerImpl::DeviceManagerImpl()
 {
     if(alcIsExtensionPresent(nullptr, "ALC_EXT_thread_local_context"))
         GetDeviceProc(SetThreadContext, nullptr, "alcSetThreadContext");
+    if(alcIsExtensionPresent(nullptr, "ALC_SOFT_loopback"))
+        GetDeviceProc(LoopbackOpenDevice, nullptr, "alcLoopbackOpenDeviceSOFT");
 }
 
 DeviceManagerImpl::~DeviceManagerImpl()
@@ -143,6 +146,15 @@ Device DeviceManagerImpl::openPlayback(const char *name, const std::nothrow_t&)
     return Device();
 }
 
+DECL_THUNK3(Device, DeviceManager, openLoopback,, ChannelConfig, SampleType, ALCuint)
+Device DeviceManagerImpl::openLoopback(ChannelConfig chans, SampleType type, ALCuint frequency)
+{
+    if(!LoopbackOpenDevice)
+        throw std::runtime_error("ALC_SOFT_loopback not supported");
+    mDevices.emplace_back(MakeUnique<DeviceImpl>(chans, type, frequency));
+    return Device(mDevices.back().get());
+}
+
 void DeviceManagerImpl::removeDevice(DeviceImpl *dev)
 {
     auto iter = std::find_if(mDevices.begin(), mDevices.end(),
@@ -12,6 +12,7 @@ class DeviceManagerImpl {
 
 public:
     static ALCboolean (ALC_APIENTRY*SetThreadContext)(ALCcontext*);
+    static LPALCLOOPBACKOPENDEVICESOFT LoopbackOpenDevice;
 
     static SharedPtr<DeviceManagerImpl> getInstance();
 
@@ -27,6 +28,8 @@ public:
 
     Device openPlayback(const char *name);
     Device openPlayback(const char *name, const std::nothrow_t&) noexcept;
+
+    Device openLoopback(ChannelConfig chans, SampleType type, ALCuint frequency);
 };
 
 } // namespace alure
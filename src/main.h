@@ -56,9 +56,25 @@ template<typename T>
 inline std::future_status GetFutureState(const SharedFuture<T> &future)
 { return future.wait_for(std::chrono::seconds::zero()); }
 
+// Gets the value of a ready future, or a default value if it holds an error.
+template<typename T>
+inline T GetFutureValue(const SharedFuture<T> &future)
+{
+    try {
+        return future.get();
+    }
+    catch(...) {
+        return T();
+    }
+}
+
 // This variant is a poor man's optional
 std::variant<std::monostate,uint64_t> ParseTimeval(StringView strval, double srate) noexcept;
 
+// Opens a file with the current FileIOFactory. Calls into the factory are
+// serialized, since the background thread opens files too.
+UniquePtr<std::istream> OpenFile(const String &name);
+
 template<size_t N>
 struct Bitfield {
 private:
@@ -0,0 +1,82 @@
+#include "mappedfile.h"
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+namespace alure {
+
+bool MappedFile::open(const String &filename)
+{
+    close();
+
+#ifdef _WIN32
+    // Names are UTF-8, so convert to use the Unicode-aware functions.
+    int wnamelen = MultiByteToWideChar(CP_UTF8, 0, filename.c_str(), -1, NULL, 0);
+    if(wnamelen <= 0) return false;
+    Vector<wchar_t> wname(wnamelen);
+    MultiByteToWideChar(CP_UTF8, 0, filename.c_str(), -1, wname.data(), wnamelen);
+
+    HANDLE file = CreateFileW(wname.data(), GENERIC_READ, FILE_SHARE_READ, nullptr,
+                              OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if(file == INVALID_HANDLE_VALUE)
+        return false;
+    LARGE_INTEGER size;
+    if(!GetFileSizeEx(file, &size) || size.QuadPart <= 0)
+    {
+        CloseHandle(file);
+        return false;
+    }
+    HANDLE mapping = CreateFileMappingW(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    CloseHandle(file);
+    if(!mapping)
+        return false;
+    void *ptr = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+    if(!ptr)
+    {
+        CloseHandle(mapping);
+        return false;
+    }
+    mMapHandle = mapping;
+    mMapping = ptr;
+    mSize = static_cast<size_t>(size.QuadPart);
+#else
+    int fd = ::open(filename.c_str(), O_RDONLY);
+    if(fd < 0) return false;
+    struct stat st;
+    if(fstat(fd, &st) != 0 || st.st_size <= 0)
+    {
+        ::close(fd);
+        return false;
+    }
+    void *ptr = mmap(nullptr, static_cast<size_t>(st.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+    ::close(fd);
+    if(ptr == MAP_FAILED)
+        return false;
+    mMapping = ptr;
+    mSize = static_cast<size_t>(st.st_size);
+#endif
+    return true;
+}
+
+void MappedFile::close()
+{
+    if(!mMapping) return;
+#ifdef _WIN32
+    UnmapViewOfFile(mMapping);
+    CloseHandle(mMapHandle);
+    mMapHandle = nullptr;
+#else
+    munmap(mMapping, mSize);
+#endif
+    mMapping = nullptr;
+    mSize = 0;
+}
+
+} // namespace alure
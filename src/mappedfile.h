@@ -0,0 +1,36 @@
+#ifndef MAPPEDFILE_H
+#define MAPPEDFILE_H
+
+#include "main.h"
+
+namespace alure {
+
+/**
+ * A read-only memory mapping of a whole file.
+ */
+class MappedFile {
+    void *mMapping{nullptr};
+    size_t mSize{0};
+#ifdef _WIN32
+    void *mMapHandle{nullptr};
+#endif
+
+public:
+    MappedFile() = default;
+    MappedFile(const MappedFile&) = delete;
+    ~MappedFile() { close(); }
+
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    /** Maps the named file, returning false if it can't be opened. */
+    bool open(const String &filename);
+    void close();
+
+    bool isOpen() const { return mMapping != nullptr; }
+    const ALbyte *data() const { return static_cast<const ALbyte*>(mMapping); }
+    size_t size() const { return mSize; }
+};
+
+} // namespace alure
+
+#endif /* MAPPEDFILE_H */
@@ -0,0 +1,68 @@
+#ifndef MEMSTREAM_H
+#define MEMSTREAM_H
+
+#include <streambuf>
+#include <istream>
+
+#include "main.h"
+
+namespace alure {
+
+/**
+ * A read-only streambuf over data held in memory. The owner of the data is
+ * kept alive along with the streambuf, so it stays valid as long as a decoder
+ * is reading it.
+ */
+class MemoryStreamBuf final : public std::streambuf {
+    SharedPtr<const void> mOwner;
+
+    int_type underflow() override
+    {
+        if(gptr() == egptr())
+            return traits_type::eof();
+        return traits_type::to_int_type(*gptr());
+    }
+
+    pos_type seekoff(off_type offset, std::ios_base::seekdir whence, std::ios_base::openmode mode) override
+    {
+        if((mode&std::ios_base::out) || !(mode&std::ios_base::in))
+            return traits_type::eof();
+
+        switch(whence)
+        {
+            case std::ios_base::beg: break;
+            case std::ios_base::cur: offset += off_type(gptr()-eback()); break;
+            case std::ios_base::end: offset += off_type(egptr()-eback()); break;
+            default: return traits_type::eof();
+        }
+        if(offset < 0 || offset > off_type(egptr()-eback()))
+            return traits_type::eof();
+
+        setg(eback(), eback()+offset, egptr());
+        return offset;
+    }
+
+    pos_type seekpos(pos_type pos, std::ios_base::openmode mode) override
+    { return seekoff(off_type(pos), std::ios_base::beg, mode); }
+
+public:
+    MemoryStreamBuf(SharedPtr<const void> owner, ArrayView<ALbyte> data)
+      : mOwner(std::move(owner))
+    {
+        char *start = const_cast<char*>(reinterpret_cast<const char*>(data.data()));
+        setg(start, start, start+data.size());
+    }
+};
+
+class MemoryStream final : public std::istream {
+    MemoryStreamBuf mStreamBuf;
+
+public:
+    MemoryStream(SharedPtr<const void> owner, ArrayView<ALbyte> data)
+      : std::istream(nullptr), mStreamBuf(std::move(owner), data)
+    { init(&mStreamBuf); }
+};
+
+} // namespace alure
+
+#endif /* MEMSTREAM_H */
@@ -0,0 +1,260 @@
+#include "config.h"
+
+#include "packfile.h"
+
+#include <stdexcept>
+#include <algorithm>
+#include <fstream>
+#include <cstring>
+#include <cstdio>
+#include <limits>
+
+#include "mappedfile.h"
+#include "memstream.h"
+
+namespace {
+
+using alure::String;
+using alure::StringView;
+using alure::Vector;
+using alure::PackHeader;
+using alure::PackEntryHeader;
+
+// A memory-mapped pack file, shared between the factory and the files opened
+// from it.
+class PackData {
+    alure::MappedFile mFile;
+    PackHeader mHeader;
+
+    PackEntryHeader getEntry(size_t idx) const
+    {
+        PackEntryHeader entry;
+        std::memcpy(&entry, mFile.data() + mHeader.mEntriesOffset + idx*sizeof(entry),
+                    sizeof(entry));
+        return entry;
+    }
+
+public:
+    PackData(const String &filename)
+    {
+        if(!mFile.open(filename))
+            throw std::runtime_error("Failed to open pack file");
+
+        const uint64_t size = mFile.size();
+        if(size < sizeof(mHeader))
+            throw std::runtime_error("Invalid pack file");
+        std::memcpy(&mHeader, mFile.data(), sizeof(mHeader));
+        if(std::memcmp(mHeader.mMagic, alure::PackMagic, sizeof(alure::PackMagic)) != 0)
+            throw std::runtime_error("Invalid pack file");
+        if(mHeader.mByteOrder != alure::PackByteOrderMark)
+            throw std::runtime_error("Pack file byte order mismatch");
+        if(mHeader.mVersion != alure::PackVersion)
+            throw std::runtime_error("Unsupported pack file version");
+
+        // The table size must be a power of two, with at least one empty slot
+        // so lookups of missing names terminate.
+        if(mHeader.mTableSize == 0 || (mHeader.mTableSize&(mHeader.mTableSize-1)) != 0 ||
+           mHeader.mNumEntries >= mHeader.mTableSize ||
+           mHeader.mTableOffset > size ||
+           size-mHeader.mTableOffset < uint64_t{mHeader.mTableSize}*sizeof(uint32_t) ||
+           mHeader.mEntriesOffset > size ||
+           size-mHeader.mEntriesOffset < uint64_t{mHeader.mNumEntries}*sizeof(PackEntryHeader))
+            throw std::runtime_error("Invalid pack file");
+
+        for(size_t i = 0;i < mHeader.mNumEntries;++i)
+        {
+            PackEntryHeader entry = getEntry(i);
+            if(entry.mNameOffset > size || size-entry.mNameOffset < entry.mNameLength ||
+               entry.mDataOffset > size || size-entry.mDataOffset < entry.mDataSize)
+                throw std::runtime_error("Invalid pack file");
+        }
+    }
+
+    /** Looks up the named entry's data, returning an empty view if not found. */
+    alure::ArrayView<ALbyte> find(StringView name) const
+    {
+        const uint64_t hash = alure::HashPackName(name);
+        const uint32_t mask = mHeader.mTableSize - 1;
+        const ALbyte *table = mFile.data() + mHeader.mTableOffset;
+        for(uint32_t slot = static_cast<uint32_t>(hash)&mask;;slot = (slot+1)&mask)
+        {
+            uint32_t idx;
+            std::memcpy(&idx, table + slot*sizeof(idx), sizeof(idx));
+            if(idx == 0 || idx > mHeader.mNumEntries)
+                break;
+
+            PackEntryHeader entry = getEntry(idx-1);
+            if(entry.mNameHash == hash && entry.mNameLength == name.size() &&
+               std::memcmp(mFile.data()+entry.mNameOffset, name.data(), name.size()) == 0)
+                return alure::ArrayView<ALbyte>(mFile.data()+entry.mDataOffset,
+                                                static_cast<size_t>(entry.mDataSize));
+        }
+        return alure::ArrayView<ALbyte>();
+    }
+};
+
+class PackFileIOFactory final : public alure::FileIOFactory {
+    alure::SharedPtr<const PackData> mPack;
+    alure::UniquePtr<alure::FileIOFactory> mFallback;
+
+public:
+    PackFileIOFactory(alure::SharedPtr<const PackData> pack,
+                      alure::UniquePtr<alure::FileIOFactory> fallback)
+      : mPack(std::move(pack)), mFallback(std::move(fallback))
+    { }
+
+    alure::UniquePtr<std::istream> openFile(const String &name) noexcept override
+    {
+        alure::ArrayView<ALbyte> data = mPack->find(name);
+        if(data.data() != nullptr)
+        {
+            // Read the entry directly from the mapped pack file.
+            return alure::MakeUnique<alure::MemoryStream>(mPack, data);
+        }
+        if(mFallback)
+            return mFallback->openFile(name);
+        return nullptr;
+    }
+};
+
+size_t AlignUp(size_t value)
+{ return (value + alure::PackDataAlignment-1) & ~(alure::PackDataAlignment-1); }
+
+} // namespace
+
+namespace alure {
+
+uint64_t HashPackName(StringView name) noexcept
+{
+    // 64-bit FNV-1a, which is plenty for short names.
+    uint64_t hash = 14695981039346656037ull;
+    for(char ch : name)
+    {
+        hash ^= static_cast<unsigned char>(ch);
+        hash *= 1099511628211ull;
+    }
+    return hash;
+}
+
+
+void WritePackFile(StringView filename, ArrayView<PackFileEntry> entries)
+{
+    if(entries.size() >= std::numeric_limits<uint32_t>::max()/2)
+        throw std::runtime_error("Too many pack entries");
+
+    PackHeader header{};
+    std::memcpy(header.mMagic, PackMagic, sizeof(PackMagic));
+    header.mVersion = PackVersion;
+    header.mByteOrder = PackByteOrderMark;
+    header.mNumEntries = static_cast<uint32_t>(entries.size());
+    // Keep the table at most half full.
+    header.mTableSize = 16;
+    while(header.mTableSize < header.mNumEntries*2)
+        header.mTableSize <<= 1;
+    header.mTableOffset = sizeof(PackHeader);
+    header.mEntriesOffset = header.mTableOffset + header.mTableSize*sizeof(uint32_t);
+
+    // Lay out the names then the data, filling in the entry headers and the
+    // hash table.
+    Vector<uint32_t> table(header.mTableSize, 0);
+    Vector<PackEntryHeader> headers(entries.size());
+    Vector<PackPcmHeader> pcmheaders(entries.size());
+    uint64_t offset = header.mEntriesOffset + entries.size()*sizeof(PackEntryHeader);
+    for(size_t i = 0;i < entries.size();++i)
+    {
+        const PackFileEntry &entry = entries[i];
+        PackEntryHeader &entryhdr = headers[i];
+        entryhdr.mNameHash = HashPackName(entry.mName);
+        entryhdr.mNameOffset = offset;
+        entryhdr.mNameLength = static_cast<uint32_t>(entry.mName.size());
+        entryhdr.mCodec = static_cast<uint32_t>(entry.mCodec);
+        offset += entry.mName.size();
+
+        const uint32_t mask = header.mTableSize - 1;
+        uint32_t slot = static_cast<uint32_t>(entryhdr.mNameHash)&mask;
+        while(table[slot] != 0)
+        {
+            const PackFileEntry &other = entries[table[slot]-1];
+            if(other.mName == entry.mName)
+                throw std::runtime_error("Duplicate pack entry \""+entry.mName+"\"");
+            slot = (slot+1)&mask;
+        }
+        table[slot] = static_cast<uint32_t>(i+1);
+    }
+    for(size_t i = 0;i < entries.size();++i)
+    {
+        const PackFileEntry &entry = entries[i];
+        PackEntryHeader &entryhdr = headers[i];
+        offset = AlignUp(offset);
+        entryhdr.mDataOffset = offset;
+        entryhdr.mDataSize = entry.mData.size();
+        if(entry.mCodec == PackCodec::PCM)
+        {
+            const ALuint framesize = FramesToBytes(1, entry.mChannels, entry.mSampleType);
+            if(entry.mFrequency == 0 || entry.mData.size()%framesize != 0)
+                throw std::runtime_error("Invalid PCM data for pack entry \""+entry.mName+"\"");
+
+            PackPcmHeader &pcmhdr = pcmheaders[i];
+            std::memcpy(pcmhdr.mMagic, PackPcmMagic, sizeof(PackPcmMagic));
+            pcmhdr.mChannels = static_cast<uint32_t>(entry.mChannels);
+            pcmhdr.mType = static_cast<uint32_t>(entry.mSampleType);
+            pcmhdr.mFrequency = entry.mFrequency;
+            pcmhdr.mLoopStart = entry.mLoopPoints.first;
+            pcmhdr.mLoopEnd = entry.mLoopPoints.second;
+            pcmhdr.mNumFrames = entry.mData.size() / framesize;
+            entryhdr.mDataSize += sizeof(PackPcmHeader);
+        }
+        offset += entryhdr.mDataSize;
+    }
+
+    // Write to a temporary file and rename it into place, so a failed write
+    // doesn't leave a truncated pack.
+    String path(filename);
+    String tmppath = path + ".tmp";
+    {
+        std::ofstream file(tmppath.c_str(), std::ios::binary | std::ios::trunc);
+        if(!file.is_open())
+            throw std::runtime_error("Failed to create \""+tmppath+"\"");
+
+        file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        file.write(reinterpret_cast<const char*>(table.data()), table.size()*sizeof(uint32_t));
+        file.write(reinterpret_cast<const char*>(headers.data()),
+                   headers.size()*sizeof(PackEntryHeader));
+        for(const PackFileEntry &entry : entries)
+            file.write(entry.mName.data(), entry.mName.size());
+        for(size_t i = 0;i < entries.size();++i)
+        {
+            static const char padding[PackDataAlignment]{};
+            uint64_t pos = static_cast<uint64_t>(file.tellp());
+            file.write(padding, static_cast<std::streamsize>(headers[i].mDataOffset - pos));
+            if(entries[i].mCodec == PackCodec::PCM)
+                file.write(reinterpret_cast<const char*>(&pcmheaders[i]), sizeof(PackPcmHeader));
+            file.write(reinterpret_cast<const char*>(entries[i].mData.data()),
+                       static_cast<std::streamsize>(entries[i].mData.size()));
+        }
+        if(!file.good())
+        {
+            file.close();
+            std::remove(tmppath.c_str());
+            throw std::runtime_error("Failed to write \""+tmppath+"\"");
+        }
+    }
+#ifdef _WIN32
+    // Windows can't rename over an existing file.
+    std::remove(path.c_str());
+#endif
+    if(std::rename(tmppath.c_str(), path.c_str()) != 0)
+    {
+        std::remove(tmppath.c_str());
+        throw std::runtime_error("Failed to rename \""+tmppath+"\" to \""+path+"\"");
+    }
+}
+
+UniquePtr<FileIOFactory> CreatePackFileIOFactory(StringView filename,
+                                                 UniquePtr<FileIOFactory> fallback)
+{
+    auto pack = MakeShared<const PackData>(String(filename));
+    return MakeUnique<PackFileIOFactory>(std::move(pack), std::move(fallback));
+}
+
+} // namespace alure
@@ -0,0 +1,56 @@
+#ifndef PACKFILE_H
+#define PACKFILE_H
+
+#include "main.h"
+
+namespace alure {
+
+// The layout of a pack file is a PackHeader, an open-addressed hash table of
+// TableSize uint32 slots (each an entry index plus one, or 0 if empty), the
+// NumEntries PackEntryHeaders, the entry names, then the entry data. Fields
+// are in the byte order of the host that wrote it, and all offsets are from
+// the start of the file.
+constexpr char PackMagic[8]{'A','L','U','R','E','P','A','K'};
+constexpr uint32_t PackVersion{1};
+constexpr uint32_t PackByteOrderMark{0x01020304};
+constexpr size_t PackDataAlignment{16};
+
+struct PackHeader {
+    char mMagic[8];
+    uint32_t mVersion;
+    uint32_t mByteOrder;
+    uint32_t mNumEntries;
+    uint32_t mTableSize;
+    uint64_t mTableOffset;
+    uint64_t mEntriesOffset;
+};
+
+struct PackEntryHeader {
+    uint64_t mNameHash;
+    uint64_t mNameOffset;
+    uint32_t mNameLength;
+    uint32_t mCodec;
+    uint64_t mDataOffset;
+    uint64_t mDataSize;
+};
+
+// PCM entries start with this header, followed by the sample frames.
+constexpr char PackPcmMagic[8]{'A','L','U','R','E','P','K','P'};
+
+struct PackPcmHeader {
+    char mMagic[8];
+    uint32_t mChannels;
+    uint32_t mType;
+    uint32_t mFrequency;
+    uint32_t mPadding;
+    uint64_t mLoopStart;
+    uint64_t mLoopEnd;
+    uint64_t mNumFrames;
+};
+
+/** Hashes an entry name for the pack index. */
+uint64_t HashPackName(StringView name) noexcept;
+
+} // namespace alure
+
+#endif /* PACKFILE_H */
@@ -0,0 +1,218 @@
+#include "pcmcache.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+
+#include <sys/stat.h>
+
+#include "buffer.h"
+
+namespace {
+
+using alure::String;
+using alure::Vector;
+
+constexpr char CacheMagic[8]{'A','L','U','R','E','P','C','M'};
+constexpr uint32_t CacheVersion{3};
+
+// How much of the start and end of a file is hashed for its key.
+constexpr size_t KeySampleSize{65536};
+
+// Gets the modification time of the named file, if it's on the filesystem.
+bool GetModifiedTime(const String &name, uint64_t &mtime)
+{
+#ifdef _WIN32
+    struct _stat64 st;
+    if(_stat64(name.c_str(), &st) != 0)
+        return false;
+#else
+    struct stat st;
+    if(stat(name.c_str(), &st) != 0)
+        return false;
+#endif
+    mtime = static_cast<uint64_t>(st.st_mtime);
+    return true;
+}
+
+// The header at the start of each cache file. The data follows immediately
+// after. Entries are only read back on the machine that wrote them, so
+// fields are in native byte order.
+struct CacheHeader {
+    char mMagic[8];
+    uint32_t mVersion;
+    uint32_t mHeaderSize;
+    uint64_t mKey;
+    uint32_t mChannels;
+    uint32_t mType;
+    uint32_t mFrequency;
+    uint32_t mPadding;
+    uint64_t mLoopStart;
+    uint64_t mLoopEnd;
+    uint64_t mDataSize;
+};
+
+String GetCachePath(const String &dir, uint64_t key)
+{
+    char name[32];
+    std::snprintf(name, sizeof(name), "%016llx.pcm", static_cast<unsigned long long>(key));
+
+    String path = dir;
+    if(!path.empty() && path.back() != '/' && path.back() != '\\')
+        path += '/';
+    return path + name;
+}
+
+} // namespace
+
+namespace alure {
+
+uint64_t GetPcmCacheKey(StringView name, const Decoder &decoder, ChannelConfig chans,
+                        SampleType type, ALuint srate)
+{
+    String fname(name);
+    UniquePtr<std::istream> file = OpenFile(fname);
+    if(!file) return 0;
+
+    // To avoid reading the whole file for every load, the key is made from
+    // its size and modification time, and a sample from the start and end,
+    // along with the name and the decoded and loaded formats. Files that
+    // aren't on the filesystem, like ones opened by an application's
+    // FileIOFactory, have no modification time, so they're hashed in full.
+    if(!file->seekg(0, std::ios::end)) return 0;
+    std::streamoff size = file->tellg();
+    if(size < 0) return 0;
+    uint64_t mtime = 0;
+    bool whole = !GetModifiedTime(fname, mtime);
+
+    Vector<uint64_t> hashes{
+        HashBufferData(ArrayView<ALbyte>(reinterpret_cast<const ALbyte*>(name.data()),
+                                         name.size())),
+        static_cast<uint64_t>(size), mtime,
+        decoder.getFrequency(), static_cast<uint64_t>(decoder.getChannelConfig()),
+        static_cast<uint64_t>(decoder.getSampleType()), decoder.getLength(),
+        static_cast<uint64_t>(chans), static_cast<uint64_t>(type), srate,
+        CacheVersion
+    };
+    Vector<ALbyte> block(static_cast<size_t>(
+        std::min<std::streamoff>(size, static_cast<std::streamoff>(KeySampleSize))
+    ));
+    auto hash_block = [&file,&block,&hashes](std::streamoff offset) -> bool
+    {
+        if(!file->seekg(offset) ||
+           !file->read(reinterpret_cast<char*>(block.data()), block.size()))
+            return false;
+        hashes.push_back(HashBufferData(block));
+        return true;
+    };
+    if(!whole)
+    {
+        if(!hash_block(0)) return 0;
+        if(size > static_cast<std::streamoff>(block.size()) &&
+           !hash_block(size - static_cast<std::streamoff>(block.size())))
+            return 0;
+    }
+    else
+    {
+        // The last block may be partial.
+        for(std::streamoff offset = 0;offset < size;)
+        {
+            std::streamoff todo = std::min<std::streamoff>(size - offset,
+                static_cast<std::streamoff>(block.size()));
+            block.resize(static_cast<size_t>(todo));
+            if(!hash_block(offset)) return 0;
+            offset += todo;
+        }
+    }
+
+    uint64_t key = HashBufferData(ArrayView<ALbyte>(
+        reinterpret_cast<const ALbyte*>(hashes.data()), hashes.size()*sizeof(uint64_t)
+    ));
+    // 0 is reserved for no key.
+    return key ? key : 1;
+}
+
+
+bool PcmCacheFile::open(const String &dir, uint64_t key)
+{
+    close();
+    if(!mFile.open(GetCachePath(dir, key)) || mFile.size() < sizeof(CacheHeader))
+    {
+        mFile.close();
+        return false;
+    }
+
+    CacheHeader header;
+    std::memcpy(&header, mFile.data(), sizeof(header));
+    if(std::memcmp(header.mMagic, CacheMagic, sizeof(CacheMagic)) != 0 ||
+       header.mVersion != CacheVersion || header.mHeaderSize != sizeof(CacheHeader) ||
+       header.mKey != key || header.mDataSize != mFile.size()-sizeof(CacheHeader) ||
+       header.mChannels > static_cast<uint32_t>(ChannelConfig::BFormat3D) ||
+       header.mType > static_cast<uint32_t>(SampleType::Mulaw))
+    {
+        close();
+        return false;
+    }
+
+    mInfo.mChannels = static_cast<ChannelConfig>(header.mChannels);
+    mInfo.mType = static_cast<SampleType>(header.mType);
+    mInfo.mFrequency = header.mFrequency;
+    mInfo.mLoopPts = std::make_pair(header.mLoopStart, header.mLoopEnd);
+    mData = ArrayView<ALbyte>(mFile.data() + sizeof(CacheHeader),
+                              static_cast<size_t>(header.mDataSize));
+    if(mData.empty() || mData.size()%FramesToBytes(1, mInfo.mChannels, mInfo.mType) != 0)
+    {
+        close();
+        return false;
+    }
+    return true;
+}
+
+void PcmCacheFile::close()
+{
+    mFile.close();
+    mData = ArrayView<ALbyte>();
+}
+
+
+void WritePcmCache(const String &dir, uint64_t key, const PcmCacheInfo &info,
+                   ArrayView<ALbyte> data)
+{
+    CacheHeader header{};
+    std::memcpy(header.mMagic, CacheMagic, sizeof(CacheMagic));
+    header.mVersion = CacheVersion;
+    header.mHeaderSize = sizeof(CacheHeader);
+    header.mKey = key;
+    header.mChannels = static_cast<uint32_t>(info.mChannels);
+    header.mType = static_cast<uint32_t>(info.mType);
+    header.mFrequency = info.mFrequency;
+    header.mLoopStart = info.mLoopPts.first;
+    header.mLoopEnd = info.mLoopPts.second;
+    header.mDataSize = data.size();
+
+    // Write to a temporary file and rename it into place, so a concurrent or
+    // interrupted load never sees a partial entry.
+    String path = GetCachePath(dir, key);
+    String tmppath = path + ".tmp";
+    {
+        std::ofstream file(tmppath.c_str(), std::ios::binary | std::ios::trunc);
+        if(!file.is_open()) return;
+        file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        file.write(reinterpret_cast<const char*>(data.data()), static_cast<std::streamsize>(data.size()));
+        if(!file.good())
+        {
+            file.close();
+            std::remove(tmppath.c_str());
+            return;
+        }
+    }
+#ifdef _WIN32
+    // Windows can't rename over an existing file.
+    std::remove(path.c_str());
+#endif
+    if(std::rename(tmppath.c_str(), path.c_str()) != 0)
+        std::remove(tmppath.c_str());
+}
+
+} // namespace alure
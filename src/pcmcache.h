@@ -0,0 +1,61 @@
+#ifndef PCMCACHE_H
+#define PCMCACHE_H
+
+#include "main.h"
+#include "mappedfile.h"
+
+namespace alure {
+
+// The format of decoded audio in the on-disk cache. The audio is stored as
+// it's given to the bufferLoading message, after format conversion and
+// resampling but before any BufferStorage encoding.
+struct PcmCacheInfo {
+    ChannelConfig mChannels{ChannelConfig::Mono};
+    SampleType mType{SampleType::UInt8};
+    ALuint mFrequency{0};
+    std::pair<uint64_t,uint64_t> mLoopPts{0, 0};
+};
+
+/**
+ * Gets the key identifying a file's decoded audio in the cache, when loaded
+ * with the given format. The key includes the file's size and a hash of its
+ * first and last 64KB, so most modifications to a file won't match old cache
+ * entries, but an edit that leaves those unchanged will. Returns 0 if the file
+ * can't be opened.
+ */
+uint64_t GetPcmCacheKey(StringView name, const Decoder &decoder, ChannelConfig chans,
+                        SampleType type, ALuint srate);
+
+/**
+ * A memory-mapped cache entry.
+ */
+class PcmCacheFile {
+    MappedFile mFile;
+
+    PcmCacheInfo mInfo;
+    ArrayView<ALbyte> mData;
+
+public:
+    PcmCacheFile() = default;
+    PcmCacheFile(const PcmCacheFile&) = delete;
+    ~PcmCacheFile() { close(); }
+
+    PcmCacheFile& operator=(const PcmCacheFile&) = delete;
+
+    /** Opens the entry for the key, returning false if there's no valid one. */
+    bool open(const String &dir, uint64_t key);
+    void close();
+
+    const PcmCacheInfo &getInfo() const { return mInfo; }
+    ArrayView<ALbyte> getData() const { return mData; }
+};
+
+/**
+ * Writes a cache entry. Failures are ignored, leaving the audio uncached.
+ */
+void WritePcmCache(const String &dir, uint64_t key, const PcmCacheInfo &info,
+                   ArrayView<ALbyte> data);
+
+} // namespace alure
+
+#endif /* PCMCACHE_H */
@@ -0,0 +1,177 @@
+#include "resampler.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+namespace {
+
+// Number of filter phases per input sample. Fractional positions between
+// phases are linearly interpolated.
+constexpr size_t NumPhases{256};
+constexpr int PhaseBits{8};
+constexpr int FracBits{32};
+
+constexpr size_t BaseTaps{32};
+constexpr size_t MaxTaps{128};
+constexpr double KaiserBeta{8.0};
+
+// Zeroth-order modified Bessel function of the first kind, for the Kaiser
+// window.
+double BesselI0(double x)
+{
+    double term = 1.0;
+    double sum = 1.0;
+    double x2 = x*x / 4.0;
+    for(int k = 1;k < 64;++k)
+    {
+        term *= x2 / (double(k)*double(k));
+        sum += term;
+        if(term < sum*1e-12) break;
+    }
+    return sum;
+}
+
+double Sinc(double x)
+{
+    if(std::abs(x) < 1e-9) return 1.0;
+    const double pix = x * 3.14159265358979323846;
+    return std::sin(pix) / pix;
+}
+
+} // namespace
+
+namespace alure {
+
+void Resampler::init(ALuint srcrate, ALuint dstrate, size_t numchans)
+{
+    mSrcRate = srcrate;
+    mDstRate = dstrate;
+    mNumChans = numchans;
+    mCoeffs.clear();
+    mTaps = 0;
+    if(srcrate == dstrate || srcrate == 0 || dstrate == 0)
+    {
+        mSrcRate = mDstRate = dstrate;
+        return;
+    }
+
+    // When downsampling, the filter cutoff drops below the source's Nyquist
+    // frequency and gets proportionally more taps to keep the same
+    // transition width.
+    const double scale = std::min(1.0, double(dstrate) / double(srcrate));
+    const double cutoff = scale * 0.95;
+    mTaps = std::min<size_t>(MaxTaps, static_cast<size_t>(std::ceil(BaseTaps/scale/2.0)) * 2);
+
+    const double halfwidth = double(mTaps/2);
+    const double besselbeta = BesselI0(KaiserBeta);
+    mCoeffs.resize((NumPhases+1) * mTaps);
+    for(size_t p = 0;p <= NumPhases;++p)
+    {
+        float *coeffs = &mCoeffs[p*mTaps];
+        const double frac = double(p) / double(NumPhases);
+        double sum = 0.0;
+        for(size_t k = 0;k < mTaps;++k)
+        {
+            // Tap k is applied to the input frame (k - (mTaps/2-1)) relative
+            // to the output's integer position.
+            const double x = double(k) - (halfwidth-1.0) - frac;
+            const double r = x / halfwidth;
+            double w = 0.0;
+            if(std::abs(r) <= 1.0)
+                w = BesselI0(KaiserBeta * std::sqrt(1.0 - r*r)) / besselbeta;
+            const double h = cutoff * Sinc(cutoff * x) * w;
+            coeffs[k] = static_cast<float>(h);
+            sum += h;
+        }
+        // Normalize each phase for unity gain at DC.
+        for(size_t k = 0;k < mTaps;++k)
+            coeffs[k] = static_cast<float>(coeffs[k] / sum);
+    }
+
+    mIncrement = (uint64_t{srcrate} << FracBits) / dstrate;
+    reset();
+}
+
+void Resampler::reset()
+{
+    mInput.assign((mTaps > 0) ? (mTaps/2 - 1)*mNumChans : 0, 0.0f);
+    mPos = 0;
+    mTotalIn = 0;
+    mTotalOut = 0;
+}
+
+void Resampler::resample(HookVector<float> &out, uint64_t maxout)
+{
+    const size_t inframes = mInput.size() / mNumChans;
+    float coeffs[MaxTaps];
+
+    while(mTotalOut < maxout && (mPos>>FracBits) + mTaps <= inframes)
+    {
+        const size_t ipos = static_cast<size_t>(mPos >> FracBits);
+        const uint32_t frac = static_cast<uint32_t>(mPos);
+        const size_t phase = frac >> (FracBits-PhaseBits);
+        const float mu = static_cast<float>((frac >> (FracBits-PhaseBits-16)) & 0xffff) *
+                         (1.0f/65536.0f);
+
+        const float *c0 = &mCoeffs[phase*mTaps];
+        const float *c1 = c0 + mTaps;
+        for(size_t k = 0;k < mTaps;++k)
+            coeffs[k] = c0[k] + (c1[k]-c0[k])*mu;
+
+        const float *in = &mInput[ipos*mNumChans];
+        for(size_t c = 0;c < mNumChans;++c)
+        {
+            float sum = 0.0f;
+            for(size_t k = 0;k < mTaps;++k)
+                sum += coeffs[k] * in[k*mNumChans + c];
+            out.push_back(sum);
+        }
+
+        mPos += mIncrement;
+        ++mTotalOut;
+    }
+
+    // Drop the input that's no longer needed.
+    const size_t consumed = std::min<size_t>(static_cast<size_t>(mPos >> FracBits), inframes);
+    mInput.erase(mInput.begin(), mInput.begin() + consumed*mNumChans);
+    mPos -= uint64_t{consumed} << FracBits;
+}
+
+void Resampler::process(const float *src, size_t frames, HookVector<float> &out)
+{
+    if(!isActive())
+    {
+        out.insert(out.end(), src, src + frames*mNumChans);
+        return;
+    }
+
+    mInput.insert(mInput.end(), src, src + frames*mNumChans);
+    mTotalIn += frames;
+    out.reserve(out.size() + static_cast<size_t>(toDstFrames(frames)+1)*mNumChans);
+    resample(out, toDstFrames(mTotalIn));
+}
+
+void Resampler::flush(HookVector<float> &out)
+{
+    if(!isActive() || mTotalOut >= toDstFrames(mTotalIn))
+        return;
+
+    mInput.resize(mInput.size() + (mTaps/2 + 1)*mNumChans, 0.0f);
+    resample(out, toDstFrames(mTotalIn));
+}
+
+
+HookVector<float> ResampleSamples(const HookVector<float> &samples, size_t numchans,
+                                  ALuint srcrate, ALuint dstrate)
+{
+    Resampler resampler;
+    resampler.init(srcrate, dstrate, numchans);
+
+    HookVector<float> out;
+    resampler.process(samples.data(), samples.size()/numchans, out);
+    resampler.flush(out);
+    return out;
+}
+
+} // namespace alure
@@ -0,0 +1,78 @@
+#ifndef RESAMPLER_H
+#define RESAMPLER_H
+
+#include <cstddef>
+#include <cstdint>
+
+#include "main.h"
+#include "allocator.h"
+
+namespace alure {
+
+/**
+ * A windowed-sinc resampler for interleaved float samples, used to convert
+ * decoded audio to the device's rate ahead of time. Input can be given in
+ * pieces, with the filter history carried over between calls so a stream
+ * resamples the same as if it was given all at once.
+ */
+class Resampler {
+    ALuint mSrcRate{0};
+    ALuint mDstRate{0};
+    size_t mNumChans{0};
+
+    // Filter taps per output sample, and a table of (NumPhases+1)*mTaps
+    // coefficients for interpolating between phases.
+    size_t mTaps{0};
+    HookVector<float> mCoeffs;
+
+    // The source position of the next output, in 32.32 fixed-point relative
+    // to the start of mInput.
+    uint64_t mPos{0};
+    uint64_t mIncrement{0};
+    // Buffered input frames, including the history needed for the filter.
+    HookVector<float> mInput;
+
+    uint64_t mTotalIn{0};
+    uint64_t mTotalOut{0};
+
+    void resample(HookVector<float> &out, uint64_t maxout);
+
+public:
+    void init(ALuint srcrate, ALuint dstrate, size_t numchans);
+    /** Clears the filter history, as when seeking. */
+    void reset();
+
+    bool isActive() const { return mSrcRate != mDstRate; }
+    /** Returns true if flushing would output more frames. */
+    bool hasPending() const { return isActive() && mTotalOut < toDstFrames(mTotalIn); }
+    ALuint getSrcRate() const { return mSrcRate; }
+    ALuint getDstRate() const { return mDstRate; }
+
+    /**
+     * Resamples the given interleaved frames, appending to out. Outputs lag
+     * behind the input by half the filter length, until flushed.
+     */
+    void process(const float *src, size_t frames, HookVector<float> &out);
+    /**
+     * Pads the end of the input with silence to output the remaining frames,
+     * so the total output length matches the input length at the new rate.
+     */
+    void flush(HookVector<float> &out);
+
+    /** Converts a frame count or offset at the source rate to the new rate. */
+    uint64_t toDstFrames(uint64_t frames) const
+    { return (frames*mDstRate + mSrcRate-1) / mSrcRate; }
+    /** Converts a frame count or offset at the new rate to the source rate. */
+    uint64_t toSrcFrames(uint64_t frames) const
+    { return frames*mSrcRate / mDstRate; }
+};
+
+/**
+ * Resamples a complete block of interleaved float samples.
+ */
+HookVector<float> ResampleSamples(const HookVector<float> &samples, size_t numchans,
+                                  ALuint srcrate, ALuint dstrate);
+
+} // namespace alure
+
+#endif /* RESAMPLER_H */
@@ -0,0 +1,518 @@
+#include "sampleconv.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define HAVE_SSE2_KERNELS 1
+#include <emmintrin.h>
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+#define HAVE_NEON_KERNELS 1
+#include <arm_neon.h>
+#endif
+
+namespace {
+
+inline int16_t FloatToShort(float val)
+{
+    val = std::min(std::max(val*32768.0f, -32768.0f), 32767.0f);
+    return static_cast<int16_t>(std::lrint(val));
+}
+
+int16_t MulawToShort(uint8_t val)
+{
+    val = ~val;
+    int t = ((val&0x0f) << 3) + 0x84;
+    t <<= (val&0x70) >> 4;
+    return static_cast<int16_t>((val&0x80) ? (0x84 - t) : (t - 0x84));
+}
+
+struct MulawTable {
+    int16_t mValues[256];
+
+    MulawTable()
+    {
+        for(int i = 0;i < 256;++i)
+            mValues[i] = MulawToShort(static_cast<uint8_t>(i));
+    }
+};
+const MulawTable gMulawTable;
+
+uint8_t ShortToMulaw(int16_t sample)
+{
+    static constexpr int Bias = 0x84;
+    static constexpr int Clip = 32635;
+
+    int sign = (sample >> 8) & 0x80;
+    int val = sign ? -static_cast<int>(sample) : sample;
+    val = std::min(val, Clip) + Bias;
+
+    int exponent = 7;
+    for(int mask = 0x4000;!(val&mask) && exponent > 0;mask >>= 1)
+        --exponent;
+    int mantissa = (val >> (exponent+3)) & 0x0f;
+    return static_cast<uint8_t>(~(sign | (exponent<<4) | mantissa));
+}
+
+} // namespace
+
+namespace alure {
+
+namespace Scalar {
+
+void ConvertF32ToS16(int16_t *dst, const float *src, size_t count)
+{
+    for(size_t i = 0;i < count;++i)
+        dst[i] = FloatToShort(src[i]);
+}
+
+void ConvertS16ToF32(float *dst, const int16_t *src, size_t count)
+{
+    for(size_t i = 0;i < count;++i)
+        dst[i] = static_cast<float>(src[i]) * (1.0f/32768.0f);
+}
+
+void ConvertU8ToS16(int16_t *dst, const uint8_t *src, size_t count)
+{
+    for(size_t i = 0;i < count;++i)
+        dst[i] = static_cast<int16_t>((src[i]-128) * 256);
+}
+
+void DecodeMulaw(int16_t *dst, const uint8_t *src, size_t count)
+{
+    for(size_t i = 0;i < count;++i)
+        dst[i] = MulawToShort(src[i]);
+}
+
+void EncodeMulaw(uint8_t *dst, const int16_t *src, size_t count)
+{
+    for(size_t i = 0;i < count;++i)
+        dst[i] = ShortToMulaw(src[i]);
+}
+
+void InterleaveF32(float *dst, const float *const *src, size_t numchans, size_t frames)
+{
+    for(size_t c = 0;c < numchans;++c)
+    {
+        const float *in = src[c];
+        float *out = dst + c;
+        for(size_t i = 0;i < frames;++i)
+            out[i*numchans] = in[i];
+    }
+}
+
+void DeinterleaveF32(float *const *dst, const float *src, size_t numchans, size_t frames)
+{
+    for(size_t c = 0;c < numchans;++c)
+    {
+        const float *in = src + c;
+        float *out = dst[c];
+        for(size_t i = 0;i < frames;++i)
+            out[i] = in[i*numchans];
+    }
+}
+
+void ApplyGainF32(float *samples, size_t count, float gain)
+{
+    for(size_t i = 0;i < count;++i)
+        samples[i] *= gain;
+}
+
+void ApplyGainS16(int16_t *samples, size_t count, float gain)
+{
+    for(size_t i = 0;i < count;++i)
+        samples[i] = FloatToShort(samples[i] * (1.0f/32768.0f) * gain);
+}
+
+void MixF32(float *dst, const float *src, size_t count, float gain)
+{
+    for(size_t i = 0;i < count;++i)
+        dst[i] += src[i] * gain;
+}
+
+void MSADPCMTrialErrors(uint32_t *errors, const int16_t *samples, size_t step, size_t frames,
+                        const int32_t *deltas)
+{
+    for(int c = 0;c < 7;++c)
+    {
+        int delta = deltas[c];
+        int sample1 = samples[step];
+        int sample2 = samples[0];
+        uint32_t err = 0;
+        for(size_t i = 2;i < frames;++i)
+        {
+            int sample = samples[i*step];
+            int predicted = (sample1*MSADPCMCoeffs[c][0] + sample2*MSADPCMCoeffs[c][1]) / 256;
+
+            int diff = sample - predicted;
+            int nibble = (diff >= 0) ? (diff + delta/2) / delta : (diff - delta/2) / delta;
+            nibble = std::min(std::max(nibble, -8), 7);
+
+            int decoded = std::min(std::max(predicted + nibble*delta, -32768), 32767);
+            sample2 = sample1;
+            sample1 = decoded;
+            delta = std::max(MSADPCMAdaption[nibble&0x0f] * delta / 256, 16);
+            err += static_cast<uint32_t>(std::abs(sample - decoded));
+        }
+        errors[c] = err;
+    }
+}
+
+} // namespace Scalar
+
+
+#if defined(HAVE_SSE2_KERNELS)
+
+void ConvertF32ToS16(int16_t *dst, const float *src, size_t count)
+{
+    const __m128 scale = _mm_set1_ps(32768.0f);
+    const __m128 lo = _mm_set1_ps(-32768.0f);
+    const __m128 hi = _mm_set1_ps(32767.0f);
+    size_t i = 0;
+    for(;i+8 <= count;i += 8)
+    {
+        __m128 a = _mm_mul_ps(_mm_loadu_ps(src+i), scale);
+        __m128 b = _mm_mul_ps(_mm_loadu_ps(src+i+4), scale);
+        a = _mm_min_ps(_mm_max_ps(a, lo), hi);
+        b = _mm_min_ps(_mm_max_ps(b, lo), hi);
+        __m128i packed = _mm_packs_epi32(_mm_cvtps_epi32(a), _mm_cvtps_epi32(b));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dst+i), packed);
+    }
+    Scalar::ConvertF32ToS16(dst+i, src+i, count-i);
+}
+
+void ConvertS16ToF32(float *dst, const int16_t *src, size_t count)
+{
+    const __m128 scale = _mm_set1_ps(1.0f/32768.0f);
+    size_t i = 0;
+    for(;i+8 <= count;i += 8)
+    {
+        __m128i smps = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src+i));
+        // Sign-extend by unpacking into the upper halves and shifting down.
+        __m128i a = _mm_srai_epi32(_mm_unpacklo_epi16(smps, smps), 16);
+        __m128i b = _mm_srai_epi32(_mm_unpackhi_epi16(smps, smps), 16);
+        _mm_storeu_ps(dst+i, _mm_mul_ps(_mm_cvtepi32_ps(a), scale));
+        _mm_storeu_ps(dst+i+4, _mm_mul_ps(_mm_cvtepi32_ps(b), scale));
+    }
+    Scalar::ConvertS16ToF32(dst+i, src+i, count-i);
+}
+
+void ConvertU8ToS16(int16_t *dst, const uint8_t *src, size_t count)
+{
+    const __m128i signbit = _mm_set1_epi8(static_cast<char>(0x80));
+    const __m128i zero = _mm_setzero_si128();
+    size_t i = 0;
+    for(;i+16 <= count;i += 16)
+    {
+        // Flipping the sign bit and moving to the upper byte gives
+        // (val-128)*256.
+        __m128i smps = _mm_xor_si128(
+            _mm_loadu_si128(reinterpret_cast<const __m128i*>(src+i)), signbit);
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dst+i), _mm_unpacklo_epi8(zero, smps));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dst+i+8), _mm_unpackhi_epi8(zero, smps));
+    }
+    Scalar::ConvertU8ToS16(dst+i, src+i, count-i);
+}
+
+void ApplyGainF32(float *samples, size_t count, float gain)
+{
+    const __m128 g = _mm_set1_ps(gain);
+    size_t i = 0;
+    for(;i+4 <= count;i += 4)
+        _mm_storeu_ps(samples+i, _mm_mul_ps(_mm_loadu_ps(samples+i), g));
+    Scalar::ApplyGainF32(samples+i, count-i, gain);
+}
+
+void ApplyGainS16(int16_t *samples, size_t count, float gain)
+{
+    const __m128 g = _mm_set1_ps(gain);
+    const __m128 lo = _mm_set1_ps(-32768.0f);
+    const __m128 hi = _mm_set1_ps(32767.0f);
+    size_t i = 0;
+    for(;i+8 <= count;i += 8)
+    {
+        __m128i smps = _mm_loadu_si128(reinterpret_cast<const __m128i*>(samples+i));
+        __m128 a = _mm_cvtepi32_ps(_mm_srai_epi32(_mm_unpacklo_epi16(smps, smps), 16));
+        __m128 b = _mm_cvtepi32_ps(_mm_srai_epi32(_mm_unpackhi_epi16(smps, smps), 16));
+        a = _mm_min_ps(_mm_max_ps(_mm_mul_ps(a, g), lo), hi);
+        b = _mm_min_ps(_mm_max_ps(_mm_mul_ps(b, g), lo), hi);
+        __m128i packed = _mm_packs_epi32(_mm_cvtps_epi32(a), _mm_cvtps_epi32(b));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(samples+i), packed);
+    }
+    Scalar::ApplyGainS16(samples+i, count-i, gain);
+}
+
+void MixF32(float *dst, const float *src, size_t count, float gain)
+{
+    const __m128 g = _mm_set1_ps(gain);
+    size_t i = 0;
+    for(;i+4 <= count;i += 4)
+    {
+        __m128 smps = _mm_mul_ps(_mm_loadu_ps(src+i), g);
+        _mm_storeu_ps(dst+i, _mm_add_ps(_mm_loadu_ps(dst+i), smps));
+    }
+    Scalar::MixF32(dst+i, src+i, count-i, gain);
+}
+
+namespace {
+
+// SSE2 lacks a 32-bit multiply, so it's done as two 32x32->64-bit multiplies
+// of the even and odd elements.
+inline __m128i MulLo32(__m128i a, __m128i b)
+{
+    __m128i even = _mm_mul_epu32(a, b);
+    __m128i odd = _mm_mul_epu32(_mm_srli_epi64(a, 32), _mm_srli_epi64(b, 32));
+    return _mm_unpacklo_epi32(_mm_shuffle_epi32(even, _MM_SHUFFLE(0,0,2,0)),
+                              _mm_shuffle_epi32(odd, _MM_SHUFFLE(0,0,2,0)));
+}
+
+inline __m128i Select32(__m128i mask, __m128i a, __m128i b)
+{ return _mm_or_si128(_mm_and_si128(mask, a), _mm_andnot_si128(mask, b)); }
+
+inline __m128i Abs32(__m128i val)
+{
+    __m128i sign = _mm_srai_epi32(val, 31);
+    return _mm_sub_epi32(_mm_xor_si128(val, sign), sign);
+}
+
+} // namespace
+
+void MSADPCMTrialErrors(uint32_t *errors, const int16_t *samples, size_t step, size_t frames,
+                        const int32_t *deltas)
+{
+    // The predictors are run side by side, four to a vector, with the eighth
+    // lane unused. Each 32-bit lane holds the previous two decoded samples as
+    // 16-bit pairs, to be multiplied with the coefficient pairs by madd.
+    // Dividing by delta is done with floats, which gives the same quotient
+    // for the magnitudes involved.
+    const __m128i s1s2 = _mm_set1_epi32(static_cast<int>(
+        static_cast<uint16_t>(samples[step]) | (static_cast<uint32_t>(samples[0])<<16)));
+    const __m128i lomask = _mm_set1_epi32(0xffff);
+    const __m128 nibmin = _mm_set1_ps(-8.0f);
+    const __m128 nibmax = _mm_set1_ps(7.0f);
+    const __m128i mindelta = _mm_set1_epi32(16);
+
+    __m128i coeffs[2], history[2], delta[2], err[2];
+    for(int v = 0;v < 2;++v)
+    {
+        alignas(16) int16_t pairs[8];
+        alignas(16) int32_t init[4];
+        for(int l = 0;l < 4;++l)
+        {
+            int c = v*4 + l;
+            pairs[l*2 + 0] = static_cast<int16_t>((c < 7) ? MSADPCMCoeffs[c][0] : 0);
+            pairs[l*2 + 1] = static_cast<int16_t>((c < 7) ? MSADPCMCoeffs[c][1] : 0);
+            init[l] = (c < 7) ? deltas[c] : 16;
+        }
+        coeffs[v] = _mm_load_si128(reinterpret_cast<const __m128i*>(pairs));
+        delta[v] = _mm_load_si128(reinterpret_cast<const __m128i*>(init));
+        history[v] = s1s2;
+        err[v] = _mm_setzero_si128();
+    }
+
+    for(size_t i = 2;i < frames;++i)
+    {
+        const __m128i sample = _mm_set1_epi32(samples[i*step]);
+        for(int v = 0;v < 2;++v)
+        {
+            // Divide the prediction by 256, rounding toward 0.
+            __m128i predicted = _mm_madd_epi16(history[v], coeffs[v]);
+            predicted = _mm_srai_epi32(_mm_add_epi32(predicted,
+                _mm_srli_epi32(_mm_srai_epi32(predicted, 31), 24)), 8);
+
+            __m128i diff = _mm_sub_epi32(sample, predicted);
+            __m128i sign = _mm_srai_epi32(diff, 31);
+            __m128i half = _mm_srai_epi32(delta[v], 1);
+            diff = _mm_add_epi32(diff, _mm_sub_epi32(_mm_xor_si128(half, sign), sign));
+            __m128 quot = _mm_div_ps(_mm_cvtepi32_ps(diff), _mm_cvtepi32_ps(delta[v]));
+            __m128i nibble = _mm_cvttps_epi32(_mm_min_ps(_mm_max_ps(quot, nibmin), nibmax));
+
+            // Packing to 16-bit clamps the decoded sample.
+            __m128i decoded = _mm_add_epi32(predicted, MulLo32(nibble, delta[v]));
+            decoded = _mm_packs_epi32(decoded, decoded);
+            decoded = _mm_srai_epi32(_mm_unpacklo_epi16(decoded, decoded), 16);
+            history[v] = _mm_or_si128(_mm_and_si128(decoded, lomask),
+                                      _mm_slli_epi32(history[v], 16));
+            err[v] = _mm_add_epi32(err[v], Abs32(_mm_sub_epi32(sample, decoded)));
+
+            // The adaption table is symmetric around 0, except for -8.
+            __m128i mag = Abs32(nibble);
+            __m128i adapt = _mm_set1_epi32(230);
+            for(int n = 4;n <= 8;++n)
+                adapt = Select32(_mm_cmpeq_epi32(mag, _mm_set1_epi32(n)),
+                                 _mm_set1_epi32(MSADPCMAdaption[n]), adapt);
+            __m128i newdelta = _mm_srai_epi32(MulLo32(adapt, delta[v]), 8);
+            delta[v] = Select32(_mm_cmpgt_epi32(newdelta, mindelta), newdelta, mindelta);
+        }
+    }
+
+    alignas(16) uint32_t out[8];
+    _mm_store_si128(reinterpret_cast<__m128i*>(out), err[0]);
+    _mm_store_si128(reinterpret_cast<__m128i*>(out+4), err[1]);
+    std::copy_n(out, 7, errors);
+}
+
+#elif defined(HAVE_NEON_KERNELS)
+
+void ConvertF32ToS16(int16_t *dst, const float *src, size_t count)
+{
+    const float32x4_t lo = vdupq_n_f32(-32768.0f);
+    const float32x4_t hi = vdupq_n_f32(32767.0f);
+    size_t i = 0;
+    for(;i+8 <= count;i += 8)
+    {
+        float32x4_t a = vmulq_n_f32(vld1q_f32(src+i), 32768.0f);
+        float32x4_t b = vmulq_n_f32(vld1q_f32(src+i+4), 32768.0f);
+        a = vminq_f32(vmaxq_f32(a, lo), hi);
+        b = vminq_f32(vmaxq_f32(b, lo), hi);
+        int16x8_t packed = vcombine_s16(vqmovn_s32(vcvtnq_s32_f32(a)),
+                                        vqmovn_s32(vcvtnq_s32_f32(b)));
+        vst1q_s16(dst+i, packed);
+    }
+    Scalar::ConvertF32ToS16(dst+i, src+i, count-i);
+}
+
+void ConvertS16ToF32(float *dst, const int16_t *src, size_t count)
+{
+    size_t i = 0;
+    for(;i+8 <= count;i += 8)
+    {
+        int16x8_t smps = vld1q_s16(src+i);
+        float32x4_t a = vcvtq_f32_s32(vmovl_s16(vget_low_s16(smps)));
+        float32x4_t b = vcvtq_f32_s32(vmovl_s16(vget_high_s16(smps)));
+        vst1q_f32(dst+i, vmulq_n_f32(a, 1.0f/32768.0f));
+        vst1q_f32(dst+i+4, vmulq_n_f32(b, 1.0f/32768.0f));
+    }
+    Scalar::ConvertS16ToF32(dst+i, src+i, count-i);
+}
+
+void ConvertU8ToS16(int16_t *dst, const uint8_t *src, size_t count)
+{
+    const uint8x8_t signbit = vdup_n_u8(0x80);
+    size_t i = 0;
+    for(;i+8 <= count;i += 8)
+    {
+        uint16x8_t smps = vshll_n_u8(veor_u8(vld1_u8(src+i), signbit), 8);
+        vst1q_s16(dst+i, vreinterpretq_s16_u16(smps));
+    }
+    Scalar::ConvertU8ToS16(dst+i, src+i, count-i);
+}
+
+void ApplyGainF32(float *samples, size_t count, float gain)
+{
+    size_t i = 0;
+    for(;i+4 <= count;i += 4)
+        vst1q_f32(samples+i, vmulq_n_f32(vld1q_f32(samples+i), gain));
+    Scalar::ApplyGainF32(samples+i, count-i, gain);
+}
+
+void ApplyGainS16(int16_t *samples, size_t count, float gain)
+{
+    const float32x4_t lo = vdupq_n_f32(-32768.0f);
+    const float32x4_t hi = vdupq_n_f32(32767.0f);
+    size_t i = 0;
+    for(;i+8 <= count;i += 8)
+    {
+        int16x8_t smps = vld1q_s16(samples+i);
+        float32x4_t a = vcvtq_f32_s32(vmovl_s16(vget_low_s16(smps)));
+        float32x4_t b = vcvtq_f32_s32(vmovl_s16(vget_high_s16(smps)));
+        a = vminq_f32(vmaxq_f32(vmulq_n_f32(a, gain), lo), hi);
+        b = vminq_f32(vmaxq_f32(vmulq_n_f32(b, gain), lo), hi);
+        vst1q_s16(samples+i, vcombine_s16(vqmovn_s32(vcvtnq_s32_f32(a)),
+                                          vqmovn_s32(vcvtnq_s32_f32(b))));
+    }
+    Scalar::ApplyGainS16(samples+i, count-i, gain);
+}
+
+void MixF32(float *dst, const float *src, size_t count, float gain)
+{
+    size_t i = 0;
+    for(;i+4 <= count;i += 4)
+    {
+        float32x4_t smps = vmulq_n_f32(vld1q_f32(src+i), gain);
+        vst1q_f32(dst+i, vaddq_f32(vld1q_f32(dst+i), smps));
+    }
+    Scalar::MixF32(dst+i, src+i, count-i, gain);
+}
+
+#else
+
+void ConvertF32ToS16(int16_t *dst, const float *src, size_t count)
+{ Scalar::ConvertF32ToS16(dst, src, count); }
+void ConvertS16ToF32(float *dst, const int16_t *src, size_t count)
+{ Scalar::ConvertS16ToF32(dst, src, count); }
+void ConvertU8ToS16(int16_t *dst, const uint8_t *src, size_t count)
+{ Scalar::ConvertU8ToS16(dst, src, count); }
+void ApplyGainF32(float *samples, size_t count, float gain)
+{ Scalar::ApplyGainF32(samples, count, gain); }
+void ApplyGainS16(int16_t *samples, size_t count, float gain)
+{ Scalar::ApplyGainS16(samples, count, gain); }
+void MixF32(float *dst, const float *src, size_t count, float gain)
+{ Scalar::MixF32(dst, src, count, gain); }
+
+#endif
+
+#if !defined(HAVE_SSE2_KERNELS)
+// Only SSE2 has a version of this so far.
+void MSADPCMTrialErrors(uint32_t *errors, const int16_t *samples, size_t step, size_t frames,
+                        const int32_t *deltas)
+{ Scalar::MSADPCMTrialErrors(errors, samples, step, frames, deltas); }
+#endif
+
+// Mu-law is table driven for decoding, and the encoder's branches don't map
+// well to SIMD, so these are shared by all targets.
+void DecodeMulaw(int16_t *dst, const uint8_t *src, size_t count)
+{
+    for(size_t i = 0;i < count;++i)
+        dst[i] = gMulawTable.mValues[src[i]];
+}
+
+void EncodeMulaw(uint8_t *dst, const int16_t *src, size_t count)
+{ Scalar::EncodeMulaw(dst, src, count); }
+
+void InterleaveF32(float *dst, const float *const *src, size_t numchans, size_t frames)
+{
+    if(numchans == 2)
+    {
+        // Stereo is by far the most common, so handle both channels in one
+        // pass.
+        const float *left = src[0];
+        const float *right = src[1];
+        for(size_t i = 0;i < frames;++i)
+        {
+            dst[i*2 + 0] = left[i];
+            dst[i*2 + 1] = right[i];
+        }
+        return;
+    }
+    if(numchans == 1)
+    {
+        std::copy_n(src[0], frames, dst);
+        return;
+    }
+    Scalar::InterleaveF32(dst, src, numchans, frames);
+}
+
+void DeinterleaveF32(float *const *dst, const float *src, size_t numchans, size_t frames)
+{
+    if(numchans == 2)
+    {
+        float *left = dst[0];
+        float *right = dst[1];
+        for(size_t i = 0;i < frames;++i)
+        {
+            left[i] = src[i*2 + 0];
+            right[i] = src[i*2 + 1];
+        }
+        return;
+    }
+    if(numchans == 1)
+    {
+        std::copy_n(src, frames, dst[0]);
+        return;
+    }
+    Scalar::DeinterleaveF32(dst, src, numchans, frames);
+}
+
+} // namespace alure
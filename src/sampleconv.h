@@ -0,0 +1,75 @@
+#ifndef SAMPLECONV_H
+#define SAMPLECONV_H
+
+#include <cstddef>
+#include <cstdint>
+
+namespace alure {
+
+// Sample conversion kernels shared by the decoders and buffer loading. Where
+// available these use SSE2 or NEON, otherwise they fall back to the scalar
+// reference versions below. Float samples are normalized to [-1, 1), and
+// conversions to integer types round to nearest and saturate.
+
+void ConvertF32ToS16(int16_t *dst, const float *src, size_t count);
+void ConvertS16ToF32(float *dst, const int16_t *src, size_t count);
+void ConvertU8ToS16(int16_t *dst, const uint8_t *src, size_t count);
+
+void DecodeMulaw(int16_t *dst, const uint8_t *src, size_t count);
+void EncodeMulaw(uint8_t *dst, const int16_t *src, size_t count);
+
+// Interleaves numchans planar channels into dst, or the reverse. The source
+// (or destination) channel pointers may be given in any order to remap the
+// channels at the same time.
+void InterleaveF32(float *dst, const float *const *src, size_t numchans, size_t frames);
+void DeinterleaveF32(float *const *dst, const float *src, size_t numchans, size_t frames);
+
+void ApplyGainF32(float *samples, size_t count, float gain);
+void ApplyGainS16(int16_t *samples, size_t count, float gain);
+
+// Adds src, scaled by gain, to dst. Used for channel downmixing.
+void MixF32(float *dst, const float *src, size_t count, float gain);
+
+// The MS-ADPCM predictor coefficients, and the step size adaption for each
+// encoded nibble.
+constexpr int MSADPCMCoeffs[7][2]{
+    { 256, 0 }, { 512, -256 }, { 0, 0 }, { 192, 64 }, { 240, 0 }, { 460, -208 }, { 392, -232 }
+};
+constexpr int MSADPCMAdaption[16]{
+    230, 230, 230, 230, 307, 409, 512, 614, 768, 614, 512, 409, 307, 230, 230, 230
+};
+
+// Encodes frames [2, frames) of one MS-ADPCM channel with each of the seven
+// predictors, starting from the given deltas and the first two samples, and
+// writes the total absolute error each gives to errors. samples are step
+// apart. Used to pick a block's predictor.
+void MSADPCMTrialErrors(uint32_t *errors, const int16_t *samples, size_t step, size_t frames,
+                        const int32_t *deltas);
+
+// Plain C++ versions of the above, used as the reference for testing and
+// benchmarking the optimized kernels.
+namespace Scalar {
+
+void ConvertF32ToS16(int16_t *dst, const float *src, size_t count);
+void ConvertS16ToF32(float *dst, const int16_t *src, size_t count);
+void ConvertU8ToS16(int16_t *dst, const uint8_t *src, size_t count);
+
+void DecodeMulaw(int16_t *dst, const uint8_t *src, size_t count);
+void EncodeMulaw(uint8_t *dst, const int16_t *src, size_t count);
+
+void InterleaveF32(float *dst, const float *const *src, size_t numchans, size_t frames);
+void DeinterleaveF32(float *const *dst, const float *src, size_t numchans, size_t frames);
+
+void ApplyGainF32(float *samples, size_t count, float gain);
+void ApplyGainS16(int16_t *samples, size_t count, float gain);
+
+void MixF32(float *dst, const float *src, size_t count, float gain);
+
+void MSADPCMTrialErrors(uint32_t *errors, const int16_t *samples, size_t step, size_t frames,
+                        const int32_t *deltas);
+
+} // namespace Scalar
+
+} // namespace alure
+
+#endif /* SAMPLECONV_H */
@@ -6,13 +6,16 @@
 #include <cstring>
 
 #include <stdexcept>
+#include <algorithm>
 #include <memory>
 #include <limits>
 
 #include "context.h"
 #include "buffer.h"
+#include "resampler.h"
 #include "auxeffectslot.h"
 #include "sourcegroup.h"
+#include "trace.h"
 
 namespace alure
 {
@@ -27,9 +30,23 @@ class ALBufferStream {
     ALuint mFrequency{0};
     ALuint mFrameSize{0};
 
-    Vector<ALbyte> mData;
+    HookVector<ALbyte> mData;
     ALbyte mSilence{0};
 
+    // The decoded format, when it has to be converted to mFormat's.
+    bool mConvert{false};
+    ChannelConfig mSrcChannels{ChannelConfig::Mono};
+    SampleType mSrcType{SampleType::UInt8};
+    ChannelConfig mDstChannels{ChannelConfig::Mono};
+    SampleType mDstType{SampleType::UInt8};
+
+    // Downmixes chunks to mono, for spatializing.
+    bool mMono{false};
+
+    // Resamples chunks to the device frequency as they're queued. Buffer
+    // lengths and positions are still tracked at the decoder's frequency.
+    Resampler mResampler;
+
     struct BufferLengthPair { ALuint mId; ALsizei mFrameLength; };
     Vector<BufferLengthPair> mBuffers;
     ALuint mWriteIdx{0};
@@ -41,14 +58,318 @@ class ALBufferStream {
     bool mHasLooped{false};
     std::atomic<bool> mDone{false};
 
+    // Offset requested by setSeekTarget, to be handled by the background
+    // thread.
+    std::atomic<uint64_t> mSeekTarget{NoSeekTarget};
+
+    // Decoded frames starting at the loop start, so looping can be served
+    // from memory instead of seeking the decoder. Filled as the decoder reads
+    // through the loop start, up to mLoopCacheSize frames.
+    ALsizei mLoopCacheSize{0};
+    ALsizei mLoopCacheFrames{0};
+    HookVector<ALbyte> mLoopCache;
+    bool mFromCache{false};
+
+    // Decoded audio from the start of the stream, played while the
+    // background thread opens the decoder. The decoder is skipped past it when
+    // first read from.
+    SharedPtr<const StreamPreroll> mPreroll;
+    SharedPtr<DecoderRequest> mDecoderRequest;
+    bool mDecoderFailed{false};
+    bool mFromPreroll{false};
+    bool mSkipPreroll{false};
+    // A resident preroll's buffer is queued ahead of the streamed chunks.
+    bool mHeadPending{false};
+    bool mHeadQueued{false};
+
+    ContextImpl *mContext{nullptr};
+    ContextStats *mStats{nullptr};
+
+    void clearLoopCache()
+    {
+        mLoopCache.clear();
+        mLoopCacheFrames = 0;
+        mFromCache = false;
+    }
+
+    void cacheLoopFrames(const ALbyte *src, ALuint count)
+    {
+        if(mLoopCacheFrames >= mLoopCacheSize)
+            return;
+
+        // The next frame to cache may be partway into the read, if the loop
+        // start isn't on a chunk boundary.
+        uint64_t next = mLoopPts.first + mLoopCacheFrames;
+        if(next < mSamplePos || next >= mSamplePos+count || next >= mLoopPts.second)
+            return;
+
+        ALuint offset = static_cast<ALuint>(next - mSamplePos);
+        ALuint tocache = static_cast<ALuint>(std::min<uint64_t>(
+            std::min<ALuint>(count-offset, mLoopCacheSize-mLoopCacheFrames),
+            mLoopPts.second - next
+        ));
+        mLoopCache.insert(mLoopCache.end(), src + offset*mFrameSize,
+                          src + (offset+tocache)*mFrameSize);
+        mLoopCacheFrames += tocache;
+    }
+
+    ALuint readFrames(ALbyte *dst, ALuint count)
+    {
+        ALuint total = 0;
+        if(mFromPreroll)
+        {
+            if(mSamplePos < static_cast<ALuint>(mPreroll->mFrames))
+            {
+                ALuint got = static_cast<ALuint>(
+                    std::min<uint64_t>(count, mPreroll->mFrames - mSamplePos)
+                );
+                std::copy_n(&mPreroll->mData[mSamplePos*mFrameSize], got*mFrameSize, dst);
+                cacheLoopFrames(dst, got);
+                mSamplePos += got;
+                dst += got*mFrameSize;
+                count -= got;
+                total += got;
+                if(count == 0) return total;
+            }
+
+            // The preroll is all there is until the decoder is opened.
+            if(!mDecoder) return total;
+            mFromPreroll = false;
+        }
+        if(!mDecoder) return total;
+        if(mSkipPreroll)
+        {
+            mSkipPreroll = false;
+            if(!skipPreroll())
+                return total;
+        }
+        if(mFromCache)
+        {
+            uint64_t cachepos = mSamplePos - mLoopPts.first;
+            if(cachepos < static_cast<ALuint>(mLoopCacheFrames))
+            {
+                ALuint got = static_cast<ALuint>(
+                    std::min<uint64_t>(count, mLoopCacheFrames - cachepos)
+                );
+                std::copy_n(&mLoopCache[cachepos*mFrameSize], got*mFrameSize, dst);
+                mSamplePos += got;
+                dst += got*mFrameSize;
+                count -= got;
+                total += got;
+                if(count == 0) return total;
+            }
+
+            // Past the end of the cache, so continue from the decoder.
+            TraceSpan span("Decoder::seek");
+            if(!mDecoder->seek(mSamplePos))
+                return total;
+            mFromCache = false;
+        }
+
+        ALuint got;
+        {
+            TraceSpan span("Decoder::read");
+            got = mDecoder->read(dst, count);
+        }
+        cacheLoopFrames(dst, got);
+        mSamplePos += got;
+        return total + got;
+    }
+
+    // Takes the decoder opened by the background thread, if it's ready.
+    void takeDecoder()
+    {
+        if(!mDecoderRequest->mDone.load(std::memory_order_acquire))
+            return;
+        SharedPtr<Decoder> decoder = std::move(mDecoderRequest->mDecoder);
+        mDecoderRequest = nullptr;
+
+        // The file may have changed since the preroll was cached.
+        if(!decoder || decoder->getFrequency() != mPreroll->mFrequency ||
+           decoder->getChannelConfig() != mPreroll->mChannels ||
+           decoder->getSampleType() != mPreroll->mType)
+        {
+            mDecoderFailed = true;
+            return;
+        }
+        mDecoder = std::move(decoder);
+        mSkipPreroll = true;
+    }
+
+    bool skipPreroll()
+    {
+        TraceSpan span("Decoder::seek");
+        if(mDecoder->seek(mPreroll->mFrames))
+            return true;
+
+        // Can't seek, so decode past it.
+        HookVector<ALbyte> scratch(mData.size());
+        ALuint todo = mPreroll->mFrames;
+        while(todo > 0)
+        {
+            ALuint got = mDecoder->read(scratch.data(), std::min<ALuint>(todo, mUpdateLen));
+            if(got == 0) return false;
+            todo -= got;
+        }
+        return true;
+    }
+
+    bool seekLoopStart()
+    {
+        if(mLoopCacheFrames > 0)
+            mFromCache = true;
+        else
+        {
+            TraceSpan span("Decoder::seek");
+            if(!mDecoder->seek(mLoopPts.first))
+                return false;
+        }
+        mSamplePos = mLoopPts.first;
+        return true;
+    }
+
+    // Reads the next chunk, recording the time taken in the statistics.
+    ALsizei decodeChunk(bool loop)
+    {
+        auto start = std::chrono::steady_clock::now();
+        ALsizei frames = readChunk(loop);
+        mStats->addDecode(mStats->mStreamDecodeTimes, std::chrono::steady_clock::now() - start,
+                          frames * mFrameSize);
+        return frames;
+    }
+
+    ALsizei readChunk(bool loop)
+    {
+        if(UNLIKELY(mDecoderRequest))
+            takeDecoder();
+
+        ALsizei len = mUpdateLen;
+        if(loop && mSamplePos < mLoopPts.second)
+            len = static_cast<ALsizei>(std::min<uint64_t>(len, mLoopPts.second - mSamplePos));
+        else
+            loop = false;
+
+        if(!mDecoder)
+        {
+            // Only the preroll is available until the decoder is opened. The
+            // preroll ends before the loop end, so there's no looping to
+            // handle yet.
+            ALsizei frames = readFrames(mData.data(), len);
+            if(frames < len && mDecoderFailed)
+                mDone.store(true, std::memory_order_release);
+            return frames;
+        }
+
+        ALsizei frames = readFrames(mData.data(), len);
+        if(loop && ((frames < mUpdateLen && mSamplePos > 0) || (mSamplePos == mLoopPts.second)))
+        {
+            if(mSamplePos < mLoopPts.second)
+            {
+                mLoopPts.second = mSamplePos;
+                if(mLoopPts.first >= mLoopPts.second)
+                {
+                    mLoopPts.first = 0;
+                    clearLoopCache();
+                }
+                else if(mLoopPts.first+mLoopCacheFrames > mLoopPts.second)
+                {
+                    mLoopCacheFrames = static_cast<ALsizei>(mLoopPts.second - mLoopPts.first);
+                    mLoopCache.resize(mLoopCacheFrames * mFrameSize);
+                }
+            }
+
+            do {
+                if(!seekLoopStart())
+                {
+                    len = mUpdateLen-frames;
+                    if(len > 0)
+                        frames += readFrames(&mData[frames*mFrameSize], len);
+                    break;
+                }
+                mHasLooped = true;
+
+                len = static_cast<ALsizei>(
+                    std::min<uint64_t>(mUpdateLen-frames, mLoopPts.second-mLoopPts.first)
+                );
+                if(len == 0) break;
+                ALuint got = readFrames(&mData[frames*mFrameSize], len);
+                if(got == 0) break;
+                frames += got;
+            } while(frames < mUpdateLen);
+        }
+        if(frames < mUpdateLen)
+            mDone.store(true, std::memory_order_release);
+        return frames;
+    }
+
+    void queueChunk(ALuint srcid, ALsizei frames)
+    {
+        if(mResampler.isActive())
+        {
+            HookVector<ALbyte> fdata = ConvertFormatData(
+                ArrayView<ALbyte>(mData.data(), frames * mFrameSize), mSrcChannels, mSrcType,
+                mDstChannels, SampleType::Float32
+            );
+            HookVector<float> samples;
+            mResampler.process(reinterpret_cast<const float*>(fdata.data()), frames, samples);
+            if(mDone.load(std::memory_order_acquire))
+                mResampler.flush(samples);
+
+            HookVector<ALbyte> data = ConvertFormatData(
+                ArrayView<ALbyte>(reinterpret_cast<const ALbyte*>(samples.data()),
+                                  samples.size() * sizeof(float)),
+                mDstChannels, SampleType::Float32, mDstChannels, mDstType
+            );
+            alBufferData(mBuffers[mWriteIdx].mId,
+                mFormat, data.data(), static_cast<ALsizei>(data.size()),
+                mResampler.getDstRate()
+            );
+        }
+        else if(mConvert)
+        {
+            HookVector<ALbyte> data = ConvertFormatData(
+                ArrayView<ALbyte>(mData.data(), frames * mFrameSize), mSrcChannels, mSrcType,
+                mDstChannels, mDstType
+            );
+            alBufferData(mBuffers[mWriteIdx].mId,
+                mFormat, data.data(), static_cast<ALsizei>(data.size()), mFrequency
+            );
+        }
+        else
+            alBufferData(mBuffers[mWriteIdx].mId,
+                mFormat, mData.data(), frames * mFrameSize, mFrequency
+            );
+        alSourceQueueBuffers(srcid, 1, &mBuffers[mWriteIdx].mId);
+        mBuffers[mWriteIdx].mFrameLength = frames;
+        mTotalBuffered += frames;
+
+        mWriteIdx = (mWriteIdx+1) % mBuffers.size();
+    }
+
 public:
-    ALBufferStream(SharedPtr<Decoder> decoder, ALsizei updatelen, ALsizei numupdates)
+    static constexpr uint64_t NoSeekTarget{std::numeric_limits<uint64_t>::max()};
+
+    ALBufferStream(SharedPtr<Decoder> decoder, ALsizei updatelen, ALsizei numupdates,
+                   ALsizei loopcachelen)
       : mDecoder(decoder), mUpdateLen(updatelen), mNumUpdates(numupdates)
+      , mLoopCacheSize(loopcachelen)
     { }
+    ALBufferStream(SharedPtr<DecoderRequest> request, SharedPtr<const StreamPreroll> preroll,
+                   ALsizei updatelen, ALsizei numupdates, ALsizei loopcachelen)
+      : mUpdateLen(updatelen), mNumUpdates(numupdates), mLoopCacheSize(loopcachelen)
+      , mPreroll(std::move(preroll)), mDecoderRequest(std::move(request))
+    {
+        if(mPreroll->mBufferId)
+            mHeadPending = true;
+        else
+            mFromPreroll = true;
+    }
     ~ALBufferStream()
     {
+        // The source has been rewound and detached from the buffers by now,
+        // so they can go back to the context for the next stream.
         for(auto &buflen : mBuffers)
-            alDeleteBuffers(1, &buflen.mId);
+            mContext->insertStreamBufferId(buflen.mId);
         mBuffers.clear();
     }
 
@@ -59,24 +380,51 @@ public:
     ALsizei getUpdateLength() const { return mUpdateLen; }
 
     ALuint getFrequency() const { return mFrequency; }
+    // Converts a source's sample offset to the decoder's frequency.
+    uint64_t toStreamFrames(ALint srcpos) const
+    { return mResampler.isActive() ? mResampler.toSrcFrames(srcpos) : srcpos; }
 
     bool seek(uint64_t pos)
     {
-        if(!mDecoder->seek(pos))
+        if(UNLIKELY(mDecoderRequest))
+            takeDecoder();
+
+        TraceSpan span("Decoder::seek");
+        if(!mDecoder || !mDecoder->seek(pos))
             return false;
         mSamplePos = pos;
+        mResampler.reset();
         mHasLooped = false;
+        mFromCache = false;
+        mFromPreroll = false;
+        mSkipPreroll = false;
+        mHeadPending = false;
         mDone.store(false, std::memory_order_release);
         return true;
     }
 
-    void prepare()
+    void prepare(ContextImpl &context)
     {
-        ALuint srate = mDecoder->getFrequency();
-        ChannelConfig chans = mDecoder->getChannelConfig();
-        SampleType type = mDecoder->getSampleType();
+        mContext = &context;
+        mStats = &context.getStats();
 
-        mLoopPts = mDecoder->getLoopPoints();
+        ALuint srate;
+        ChannelConfig chans;
+        SampleType type;
+        if(mDecoder)
+        {
+            srate = mDecoder->getFrequency();
+            chans = mDecoder->getChannelConfig();
+            type = mDecoder->getSampleType();
+            mLoopPts = mDecoder->getLoopPoints();
+        }
+        else
+        {
+            srate = mPreroll->mFrequency;
+            chans = mPreroll->mChannels;
+            type = mPreroll->mType;
+            mLoopPts = mPreroll->mLoopPts;
+        }
         if(mLoopPts.first >= mLoopPts.second)
         {
             mLoopPts.first = 0;
@@ -85,30 +433,58 @@ public:
 
         mFrequency = srate;
         mFrameSize = FramesToBytes(1, chans, type);
-        mFormat = GetFormat(chans, type);
+        mDstChannels = mMono ? ChannelConfig::Mono : chans;
+        mDstType = type;
+        mFormat = GetFallbackFormat(mDstChannels, mDstType);
         if(UNLIKELY(mFormat == AL_NONE))
         {
             auto str = String("Unsupported format (")+GetSampleTypeName(type)+", "+
                        GetChannelConfigName(chans)+")";
             throw std::runtime_error(str);
         }
+        // Chunks are decoded and cached in the decoder's format, and converted
+        // as they're queued.
+        mSrcChannels = chans;
+        mSrcType = type;
+        mConvert = (mDstChannels != chans || mDstType != type);
+
+        // A resident head's buffer is already at the file's frequency, which
+        // the rest of the stream needs to match.
+        ALuint outrate = srate;
+        if(!mHeadPending)
+            outrate = context.getLoadFrequency(srate);
+        mResampler.init(srate, outrate, FramesToBytes(1, mDstChannels, SampleType::UInt8));
 
         mData.resize(mUpdateLen * mFrameSize);
+        clearLoopCache();
+        if(mLoopCacheSize > 0)
+        {
+            uint64_t looplen = mLoopPts.second - mLoopPts.first;
+            mLoopCache.reserve(static_cast<size_t>(
+                std::min<uint64_t>(mLoopCacheSize, looplen) * mFrameSize
+            ));
+        }
         if(type == SampleType::UInt8) mSilence = -128;
         else if(type == SampleType::Mulaw) mSilence = 127;
         else mSilence = 0;
 
         mBuffers.assign(mNumUpdates, {0,0});
         for(auto &buflen : mBuffers)
-            alGenBuffers(1, &buflen.mId);
+            buflen.mId = context.getStreamBufferId();
     }
 
+    void setDownmixToMono(bool mono) { mMono = mono; }
+
+    bool hasPreroll() const { return mPreroll != nullptr; }
+    bool needsDecoder() const { return !mDecoder && !mDecoderFailed; }
+
     int64_t getLoopStart() const { return mLoopPts.first; }
     int64_t getLoopEnd() const { return mLoopPts.second; }
 
     ALsizei resetQueue(ALuint srcid, bool looping)
     {
         alSourcei(srcid, AL_BUFFER, 0);
+        mHeadQueued = false;
         mTotalBuffered = 0;
         mReadIdx = mWriteIdx = 0;
 
@@ -126,6 +502,12 @@ public:
         ALuint bid;
         alSourceUnqueueBuffers(srcid, 1, &bid);
 
+        if(mHeadQueued)
+        {
+            mTotalBuffered -= mPreroll->mFrames;
+            mHeadQueued = false;
+            return;
+        }
         mTotalBuffered -= mBuffers[mReadIdx].mFrameLength;
         mReadIdx = (mReadIdx+1) % mBuffers.size();
     }
@@ -134,66 +516,70 @@ public:
     bool hasMoreData() const { return !mDone.load(std::memory_order_acquire); }
     bool streamMoreData(ALuint srcid, bool loop)
     {
+        if(mHeadPending)
+        {
+            alSourceQueueBuffers(srcid, 1, &mPreroll->mBufferId);
+            mTotalBuffered += mPreroll->mFrames;
+            mSamplePos = mPreroll->mFrames;
+            mHeadPending = false;
+            mHeadQueued = true;
+            return true;
+        }
         if(mDone.load(std::memory_order_acquire))
             return false;
 
-        ALsizei len = mUpdateLen;
-        if(loop && mSamplePos < mLoopPts.second)
-            len = static_cast<ALsizei>(std::min<uint64_t>(len, mLoopPts.second - mSamplePos));
-        else
-            loop = false;
+        ALsizei frames = decodeChunk(loop);
+        // The resampler may still have the end of the stream to output.
+        if(frames == 0 && !mResampler.hasPending())
+            return false;
 
-        ALsizei frames = mDecoder->read(mData.data(), len);
-        mSamplePos += frames;
-        if(loop && ((frames < mUpdateLen && mSamplePos > 0) || (mSamplePos == mLoopPts.second)))
-        {
-            if(mSamplePos < mLoopPts.second)
-            {
-                mLoopPts.second = mSamplePos;
-                if(mLoopPts.first >= mLoopPts.second)
-                    mLoopPts.first = 0;
-            }
+        queueChunk(srcid, frames);
+        return true;
+    }
 
-            do {
-                if(!mDecoder->seek(mLoopPts.first))
-                {
-                    len = mUpdateLen-frames;
-                    if(len > 0)
-                    {
-                        ALuint got = mDecoder->read(&mData[frames*mFrameSize], len);
-                        mSamplePos += got;
-                        frames += got;
-                    }
-                    break;
-                }
-                mSamplePos = mLoopPts.first;
-                mHasLooped = true;
+    void setSeekTarget(uint64_t pos) { mSeekTarget.store(pos, std::memory_order_release); }
+    uint64_t getSeekTarget() const { return mSeekTarget.load(std::memory_order_acquire); }
 
-                len = static_cast<ALsizei>(
-                    std::min<uint64_t>(mUpdateLen-frames, mLoopPts.second-mLoopPts.first)
-                );
-                if(len == 0) break;
-                ALuint got = mDecoder->read(&mData[frames*mFrameSize], len);
-                if(got == 0) break;
-                mSamplePos += got;
-                frames += got;
-            } while(frames < mUpdateLen);
-        }
-        if(frames < mUpdateLen)
-        {
-            mDone.store(true, std::memory_order_release);
-            if(frames == 0) return false;
-        }
+    /**
+     * Handles a pending seek request. The currently queued buffers keep
+     * playing while the decoder seeks and decodes the first chunk at the new
+     * offset, after which the queue is swapped out. Returns the number of
+     * buffers queued, or -1 if there was no seek request or it failed (in
+     * which case the current queue is left alone).
+     */
+    ALsizei applySeekTarget(ALuint srcid, bool looping, bool paused)
+    {
+        if(mSeekTarget.load(std::memory_order_relaxed) == NoSeekTarget)
+            return -1;
+        // Leave the request pending until the decoder is opened.
+        if(UNLIKELY(mDecoderRequest))
+            takeDecoder();
+        if(needsDecoder())
+            return -1;
 
-        alBufferData(mBuffers[mWriteIdx].mId,
-            mFormat, mData.data(), frames * mFrameSize, mFrequency
-        );
-        alSourceQueueBuffers(srcid, 1, &mBuffers[mWriteIdx].mId);
-        mBuffers[mWriteIdx].mFrameLength = frames;
-        mTotalBuffered += frames;
+        uint64_t pos = mSeekTarget.exchange(NoSeekTarget, std::memory_order_acq_rel);
+        if(pos == NoSeekTarget || !seek(pos))
+            return -1;
 
-        mWriteIdx = (mWriteIdx+1) % mBuffers.size();
-        return true;
+        ALsizei frames = decodeChunk(looping);
+
+        alSourceRewind(srcid);
+        alSourcei(srcid, AL_BUFFER, 0);
+        mHeadQueued = false;
+        mTotalBuffered = 0;
+        mReadIdx = mWriteIdx = 0;
+        if(frames == 0) return 0;
+
+        queueChunk(srcid, frames);
+        if(!paused) alSourcePlay(srcid);
+
+        ALsizei queued = 1;
+        for(;queued < mNumUpdates;queued++)
+        {
+            if(!streamMoreData(srcid, looping))
+                break;
+        }
+        return queued;
     }
 };
 
@@ -238,6 +624,7 @@ void SourceImpl::resetProperties()
 
     mPaused.store(false, std::memory_order_release);
     mOffset = 0;
+    mLoopCacheLen = 0;
     mPitch = 1.0f;
     mGain = 1.0f;
     mMinGain = 0.0f;
@@ -398,12 +785,74 @@ void SourceImpl::play(SharedPtr<Decoder>&& decoder, ALsizei chunk_len, ALsizei q
         throw std::domain_error("Queue size out of range");
     CheckContext(mContext);
 
-    auto stream = MakeUnique<ALBufferStream>(decoder, chunk_len, queue_size);
-    stream->prepare();
+    auto stream = MakeUnique<ALBufferStream>(decoder, chunk_len, queue_size, mLoopCacheLen);
+    stream->prepare(mContext);
+
+    playStream(std::move(stream));
+}
+
+DECL_THUNK3(void, Source, play,, StringView, ALsizei, ALsizei)
+void SourceImpl::play(StringView name, ALsizei chunk_len, ALsizei queue_size)
+{
+    if(chunk_len < 64)
+        throw std::domain_error("Update length out of range");
+    if(queue_size < 2)
+        throw std::domain_error("Queue size out of range");
+    CheckContext(mContext);
+
+    if(Buffer buffer = mContext.findBuffer(name))
+    {
+        play(buffer);
+        return;
+    }
+
+    // The preroll is only useful when starting from the beginning. It plays
+    // while the background thread opens the decoder, which is dropped if the
+    // file no longer decodes to the preroll's format.
+    SharedPtr<const StreamPreroll> preroll;
+    if(mOffset == 0)
+        preroll = mContext.findStreamPreroll(name);
+    if(preroll)
+    {
+        bool mono = preroll->mMono;
+        auto stream = MakeUnique<ALBufferStream>(mContext.requestDecoder(name),
+            std::move(preroll), chunk_len, queue_size, mLoopCacheLen
+        );
+        stream->setDownmixToMono(mono);
+        stream->prepare(mContext);
+
+        playStream(std::move(stream));
+        return;
+    }
+
+    // Files kept in memory with precacheFileData are always decoded as they
+    // play, so only their compressed data stays resident.
+    SharedPtr<Decoder> decoder = mContext.createDecoder(name);
+    uint64_t length = decoder->getLength();
+    uint64_t threshold = mContext.getStreamingThreshold();
+    if(length > 0 && length <= threshold && !mContext.findFileData(name) &&
+       length*FramesToBytes(1, decoder->getChannelConfig(), decoder->getSampleType()) <= threshold)
+    {
+        play(mContext.createBufferFrom(name, std::move(decoder)));
+        return;
+    }
+
+    auto stream = MakeUnique<ALBufferStream>(std::move(decoder), chunk_len, queue_size,
+                                             mLoopCacheLen);
+    stream->setDownmixToMono(mContext.getDownmixToMono(name));
+    stream->prepare(mContext);
 
+    playStream(std::move(stream));
+}
+
+void SourceImpl::playStream(UniquePtr<ALBufferStream> stream)
+{
     if(mStream)
         mContext.removeStream(this);
     mIsAsync.store(false, std::memory_order_release);
+    mStreamQueueEnd = std::chrono::steady_clock::time_point{};
+    mUnderrunFrames = 0;
+    mUnderrunPending.store(false, std::memory_order_relaxed);
 
     if(mId == 0)
     {
@@ -426,7 +875,10 @@ void SourceImpl::play(SharedPtr<Decoder>&& decoder, ALsizei chunk_len, ALsizei q
 
     mStream = std::move(stream);
 
-    mStream->seek(mOffset);
+    // A stream starting from a preroll is already at the beginning, and
+    // seeking would drop the preroll.
+    if(mOffset != 0 || !mStream->hasPreroll())
+        mStream->seek(mOffset);
     mOffset = 0;
 
     for(ALsizei i = 0;i < mStream->getNumUpdates();i++)
@@ -656,7 +1108,7 @@ bool SourceImpl::checkPending(SharedFuture<Buffer> &future)
     if(GetFutureState(future) != std::future_status::ready)
         return true;
 
-    BufferImpl *buffer = future.get().getHandle();
+    BufferImpl *buffer = GetFutureValue(future).getHandle();
     if(UNLIKELY(!buffer || &(buffer->getContext()) != &mContext))
         return false;
 
@@ -728,6 +1180,18 @@ bool SourceImpl::playUpdate(ALuint id)
 
 bool SourceImpl::playUpdate()
 {
+    if(UNLIKELY(mUnderrunPending.load(std::memory_order_acquire)))
+    {
+        uint64_t frames;
+        {
+            std::lock_guard<std::mutex> lock(mMutex);
+            frames = mUnderrunFrames;
+            mUnderrunFrames = 0;
+            mUnderrunPending.store(false, std::memory_order_relaxed);
+        }
+        mContext.send(&MessageHandler::sourceUnderrun, Source(this), frames);
+    }
+
     if(LIKELY(mIsAsync.load(std::memory_order_acquire)))
         return true;
 
@@ -758,13 +1222,40 @@ ALint SourceImpl::refillBufferStream()
     return queued;
 }
 
+void SourceImpl::noteUnderrun(std::chrono::steady_clock::time_point now)
+{
+    // The audio that should have played between the queue running out and
+    // now was lost. This is an estimate, since the queue end assumes the
+    // first queued buffer had just started when it was last refilled, and
+    // that it plays at normal pitch.
+    uint64_t frames = 0;
+    if(mStreamQueueEnd != std::chrono::steady_clock::time_point{} && now > mStreamQueueEnd)
+        frames = static_cast<uint64_t>(
+            std::chrono::duration<double>(now - mStreamQueueEnd).count() *
+            mStream->getFrequency()
+        );
+
+    ContextStats &stats = mContext.getStats();
+    stats.mStreamUnderruns.fetch_add(1, std::memory_order_relaxed);
+    stats.mStreamFramesLost.fetch_add(frames, std::memory_order_relaxed);
+
+    mUnderrunFrames += frames;
+    mUnderrunPending.store(true, std::memory_order_release);
+}
+
 bool SourceImpl::updateAsync()
 {
+    TraceSpan span("SourceImpl::updateAsync");
     std::lock_guard<std::mutex> lock(mMutex);
 
-    ALint queued = refillBufferStream();
+    ALint queued = mStream->applySeekTarget(mId, mLooping, mPaused.load(std::memory_order_acquire));
+    if(queued < 0) queued = refillBufferStream();
     if(queued == 0)
     {
+        // A stream can play out its preroll before the decoder is opened, so
+        // keep it going until there's nothing more to play.
+        if(mStream->needsDecoder())
+            return true;
         mIsAsync.store(false, std::memory_order_release);
         return false;
     }
@@ -773,9 +1264,17 @@ bool SourceImpl::updateAsync()
     alGetSourcei(mId, AL_SOURCE_STATE, &state);
     if(!mPaused.load(std::memory_order_acquire))
     {
-        // Make sure the source is still playing if it's not paused.
+        auto now = std::chrono::steady_clock::now();
+        // Make sure the source is still playing if it's not paused. If it
+        // stopped, it ran out of queued audio before it could be refilled.
+        if(state == AL_STOPPED)
+            noteUnderrun(now);
         if(state != AL_PLAYING)
             alSourcePlay(mId);
+        mStreamQueueEnd = now + std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+            std::chrono::duration<double>(static_cast<double>(mStream->getTotalBuffered()) /
+                                          mStream->getFrequency())
+        );
     }
     else
     {
@@ -783,6 +1282,7 @@ bool SourceImpl::updateAsync()
         // paused.
         if(state == AL_STOPPED)
             alSourceRewind(mId);
+        mStreamQueueEnd = std::chrono::steady_clock::time_point{};
     }
     return true;
 }
@@ -815,7 +1315,21 @@ void SourceImpl::setOffset(uint64_t offset)
     }
     else
     {
-        std::lock_guard<std::mutex> lock(mMutex);
+        // Hold the lock while checking if the stream is still being serviced,
+        // so the background thread can't give it up before it sees the target.
+        std::unique_lock<std::mutex> lock(mMutex);
+        if(mIsAsync.load(std::memory_order_acquire))
+        {
+            // Decoder seeks can be slow, so leave it for the background thread
+            // to seek and refill the queue while the current one keeps playing.
+            mStream->setSeekTarget(offset);
+            lock.unlock();
+            mContext.wakeThread();
+            return;
+        }
+
+        // The stream already finished and is no longer being serviced by the
+        // background thread, so seek and restart it here.
         if(!mStream->seek(offset))
             throw std::domain_error("Failed to seek to offset");
         alSourceRewind(mId);
@@ -834,6 +1348,15 @@ std::pair<uint64_t,std::chrono::nanoseconds> SourceImpl::getSampleOffsetLatency(
 
     if(mStream)
     {
+        // Report a pending seek's offset until the background thread gets to
+        // it.
+        uint64_t seekpos = mStream->getSeekTarget();
+        if(seekpos != ALBufferStream::NoSeekTarget)
+        {
+            ret.first = seekpos;
+            return ret;
+        }
+
         std::lock_guard<std::mutex> lock(mMutex);
         ALint state = -1, srcpos = 0;
 
@@ -847,6 +1370,7 @@ std::pair<uint64_t,std::chrono::nanoseconds> SourceImpl::getSampleOffsetLatency(
         else
             alGetSourcei(mId, AL_SAMPLE_OFFSET, &srcpos);
         alGetSourcei(mId, AL_SOURCE_STATE, &state);
+        srcpos = static_cast<ALint>(mStream->toStreamFrames(srcpos));
 
         int64_t streampos = mStream->getPosition();
         if(state != AL_STOPPED)
@@ -895,6 +1419,13 @@ std::pair<Seconds,Seconds> SourceImpl::getSecOffsetLatency() const
 
     if(mStream)
     {
+        uint64_t seekpos = mStream->getSeekTarget();
+        if(seekpos != ALBufferStream::NoSeekTarget)
+        {
+            ret.first = Seconds(static_cast<double>(seekpos) / mStream->getFrequency());
+            return ret;
+        }
+
         std::lock_guard<std::mutex> lock(mMutex);
         ALdouble srcpos = 0;
         ALint state = -1;
@@ -970,6 +1501,15 @@ void SourceImpl::setLooping(bool looping)
 }
 
 
+DECL_THUNK1(void, Source, setLoopCacheLength,, ALsizei)
+void SourceImpl::setLoopCacheLength(ALsizei length)
+{
+    if(length < 0)
+        throw std::domain_error("Loop cache length out of range");
+    mLoopCacheLen = length;
+}
+
+
 DECL_THUNK1(void, Source, setPitch,, ALfloat)
 void SourceImpl::setPitch(ALfloat pitch)
 {
@@ -1503,6 +2043,7 @@ void SourceImpl::destroy()
 DECL_THUNK0(SourceGroup, Source, getGroup, const)
 DECL_THUNK0(ALuint, Source, getPriority, const)
 DECL_THUNK0(bool, Source, getLooping, const)
+DECL_THUNK0(ALsizei, Source, getLoopCacheLength, const)
 DECL_THUNK0(ALfloat, Source, getPitch, const)
 DECL_THUNK0(ALfloat, Source, getGain, const)
 DECL_THUNK0(ALfloatPair, Source, getGainRange, const)
@@ -58,8 +58,17 @@ class SourceImpl {
     mutable std::mutex mMutex;
     std::atomic<bool> mIsAsync;
 
+    // When the queued stream buffers will run out, as of the last refill.
+    // Used to estimate how much was lost when a stream underruns.
+    std::chrono::steady_clock::time_point mStreamQueueEnd;
+    // Frames lost to underruns not yet reported by the update thread. Guarded
+    // by mMutex, with the flag to check it cheaply.
+    uint64_t mUnderrunFrames{0};
+    std::atomic<bool> mUnderrunPending{false};
+
     std::atomic<bool> mPaused;
     uint64_t mOffset;
+    ALsizei mLoopCacheLen;
     ALfloat mPitch;
     ALfloat mGain;
     ALfloat mMinGain, mMaxGain;
@@ -92,6 +101,8 @@ class SourceImpl {
     void applyProperties(bool looping) const;
 
     ALint refillBufferStream();
+    void noteUnderrun(std::chrono::steady_clock::time_point now);
+    void playStream(UniquePtr<ALBufferStream> stream);
 
     void setFilterParams(ALuint &filterid, const FilterParams &params);
 
@@ -115,6 +126,7 @@ public:
 
     void play(Buffer buffer);
     void play(SharedPtr<Decoder>&& decoder, ALsizei chunk_len, ALsizei queue_size);
+    void play(StringView name, ALsizei chunk_len, ALsizei queue_size);
     void play(SharedFuture<Buffer>&& future_buffer);
     void stop();
     void makeStopped(bool dolock=true);
@@ -140,6 +152,9 @@ public:
     void setLooping(bool looping);
     bool getLooping() const { return mLooping; }
 
+    void setLoopCacheLength(ALsizei length);
+    ALsizei getLoopCacheLength() const { return mLoopCacheLen; }
+
     void setPitch(ALfloat pitch);
     ALfloat getPitch() const { return mPitch; }
 
@@ -0,0 +1,128 @@
+
+#include "config.h"
+
+#include "trace.h"
+
+#include <stdexcept>
+#include <fstream>
+#include <mutex>
+
+namespace {
+
+using clock_type = std::chrono::steady_clock;
+
+struct TraceEvent {
+    const char *mName;
+    ALuint mThread;
+    clock_type::time_point mStart;
+    clock_type::time_point mEnd;
+};
+
+struct TraceThread {
+    ALuint mId;
+    const char *mName;
+};
+
+// Events past this many are dropped, to bound the memory used by a trace
+// that's left running.
+constexpr size_t MaxTraceEvents = 1<<20;
+
+// Guards all of the following. Spans are coarse (whole updates, loads, and
+// decoder calls), so a lock is cheap enough while tracing.
+std::mutex gTraceMutex;
+std::ofstream gTraceFile;
+clock_type::time_point gTraceStart;
+alure::Vector<TraceEvent> gTraceEvents;
+alure::Vector<TraceThread> gTraceThreads;
+ALuint gTraceGeneration{0};
+ALuint gNextThreadId{1};
+
+thread_local ALuint tThreadId{0};
+thread_local ALuint tThreadGeneration{0};
+thread_local const char *tThreadName{nullptr};
+
+double ToMicroseconds(clock_type::duration time)
+{ return std::chrono::duration<double,std::micro>(time).count(); }
+
+} // namespace
+
+namespace alure {
+
+std::atomic<bool> gTraceEnabled{false};
+
+void AddTraceSpan(const char *name, clock_type::time_point start, clock_type::time_point end)
+{
+    std::lock_guard<std::mutex> lock(gTraceMutex);
+    if(!gTraceEnabled.load(std::memory_order_relaxed) || gTraceEvents.size() >= MaxTraceEvents)
+        return;
+
+    if(tThreadGeneration != gTraceGeneration)
+    {
+        if(!tThreadId) tThreadId = gNextThreadId++;
+        tThreadGeneration = gTraceGeneration;
+        gTraceThreads.push_back(TraceThread{tThreadId, tThreadName});
+    }
+    gTraceEvents.push_back(TraceEvent{name, tThreadId, start, end});
+}
+
+void SetTraceThreadName(const char *name)
+{ tThreadName = name; }
+
+
+void StartTrace(StringView filename)
+{
+    std::lock_guard<std::mutex> lock(gTraceMutex);
+    gTraceEnabled.store(false, std::memory_order_relaxed);
+    if(gTraceFile.is_open())
+        gTraceFile.close();
+    gTraceEvents.clear();
+    gTraceThreads.clear();
+
+    gTraceFile.open(String(filename).c_str(), std::ios::binary | std::ios::trunc);
+    if(!gTraceFile.is_open())
+        throw std::runtime_error("Failed to open trace file");
+
+    ++gTraceGeneration;
+    gTraceStart = clock_type::now();
+    gTraceEnabled.store(true, std::memory_order_relaxed);
+}
+
+void StopTrace()
+{
+    std::lock_guard<std::mutex> lock(gTraceMutex);
+    gTraceEnabled.store(false, std::memory_order_relaxed);
+    if(!gTraceFile.is_open())
+        return;
+
+    // Written in the Chrome trace event format, as complete events with
+    // microsecond timestamps.
+    gTraceFile<< "{\"displayTimeUnit\": \"ms\", \"traceEvents\": [\n";
+    const char *sep = "";
+    for(const TraceThread &thread : gTraceThreads)
+    {
+        if(!thread.mName) continue;
+        gTraceFile<< sep<<"{\"ph\": \"M\", \"name\": \"thread_name\", \"pid\": 1, \"tid\": "
+                  << thread.mId<<", \"args\": {\"name\": \""<<thread.mName<<"\"}}";
+        sep = ",\n";
+    }
+    gTraceFile.setf(std::ios::fixed);
+    gTraceFile.precision(3);
+    for(const TraceEvent &event : gTraceEvents)
+    {
+        gTraceFile<< sep<<"{\"ph\": \"X\", \"cat\": \"alure\", \"name\": \""<<event.mName
+                  << "\", \"pid\": 1, \"tid\": "<<event.mThread
+                  << ", \"ts\": "<<ToMicroseconds(event.mStart - gTraceStart)
+                  << ", \"dur\": "<<ToMicroseconds(event.mEnd - event.mStart)<<"}";
+        sep = ",\n";
+    }
+    gTraceFile<< "\n]}\n";
+
+    bool failed = !gTraceFile.good();
+    gTraceFile.close();
+    gTraceEvents.clear();
+    gTraceThreads.clear();
+    if(failed)
+        throw std::runtime_error("Failed to write trace file");
+}
+
+} // namespace alure
@@ -0,0 +1,43 @@
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <atomic>
+#include <chrono>
+
+#include "main.h"
+
+namespace alure {
+
+extern std::atomic<bool> gTraceEnabled;
+
+// Records a span on the calling thread in the current trace.
+void AddTraceSpan(const char *name, std::chrono::steady_clock::time_point start,
+                  std::chrono::steady_clock::time_point end);
+
+// Sets the name the calling thread is shown with in traces. The name must
+// outlive the thread.
+void SetTraceThreadName(const char *name);
+
+/**
+ * Records its lifetime as a span in the trace started by StartTrace. When no
+ * trace is running, this only checks a flag. The name must be a string
+ * literal.
+ */
+class TraceSpan {
+    const char *mName;
+    std::chrono::steady_clock::time_point mStart;
+
+public:
+    explicit TraceSpan(const char *name) noexcept
+      : mName(gTraceEnabled.load(std::memory_order_relaxed) ? name : nullptr)
+    { if(UNLIKELY(mName)) mStart = std::chrono::steady_clock::now(); }
+    TraceSpan(const TraceSpan&) = delete;
+    ~TraceSpan()
+    { if(UNLIKELY(mName)) AddTraceSpan(mName, mStart, std::chrono::steady_clock::now()); }
+
+    TraceSpan& operator=(const TraceSpan&) = delete;
+};
+
+} // namespace alure
+
+#endif /* TRACE_H */
@@ -0,0 +1,260 @@
+/*
+ * Checks what gets queued for streams started from a cached preroll or head,
+ * using the mock OpenAL library (built with ALURE_USE_MOCK_AL). The test
+ * decoder's factory blocks when the background thread opens it, until the
+ * checks are done, so anything queued by then had to come from the preroll.
+ */
+
+#include <algorithm>
+#include <condition_variable>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <chrono>
+#include <thread>
+#include <vector>
+#include <atomic>
+#include <mutex>
+
+#include "alure2.h"
+#include "mockal.h"
+
+namespace {
+
+constexpr ALuint RampFrequency = 44100;
+constexpr char RampName[] = "alure-test-ramp";
+constexpr char RampMagic[] = "RAMP";
+
+std::thread::id gMainThread;
+std::atomic<int> gMainOpens{0};
+std::atomic<int> gBackgroundOpens{0};
+
+// Holds back decoders opened by the background thread until it's opened.
+std::mutex gGateMutex;
+std::condition_variable gGateCond;
+bool gGateOpen{false};
+
+void SetGate(bool open)
+{
+    std::unique_lock<std::mutex> lock(gGateMutex);
+    gGateOpen = open;
+    lock.unlock();
+    gGateCond.notify_all();
+}
+
+int16_t RampSample(uint64_t pos) { return static_cast<int16_t>(pos % 32768); }
+
+// A decoder generating two seconds of a mono ramp, so each sample's position
+// can be told from its value.
+class RampDecoder final : public alure::Decoder {
+    uint64_t mPos{0};
+
+public:
+    ALuint getFrequency() const noexcept override { return RampFrequency; }
+    alure::ChannelConfig getChannelConfig() const noexcept override
+    { return alure::ChannelConfig::Mono; }
+    alure::SampleType getSampleType() const noexcept override
+    { return alure::SampleType::Int16; }
+
+    uint64_t getLength() const noexcept override { return RampFrequency*2; }
+    bool seek(uint64_t pos) noexcept override
+    {
+        if(pos > getLength()) return false;
+        mPos = pos;
+        return true;
+    }
+
+    std::pair<uint64_t,uint64_t> getLoopPoints() const noexcept override
+    { return {0, 0}; }
+
+    ALuint read(ALvoid *ptr, ALuint count) noexcept override
+    {
+        count = static_cast<ALuint>(std::min<uint64_t>(count, getLength()-mPos));
+        int16_t *samples = static_cast<int16_t*>(ptr);
+        for(ALuint i = 0;i < count;++i)
+            samples[i] = RampSample(mPos+i);
+        mPos += count;
+        return count;
+    }
+};
+
+class RampDecoderFactory final : public alure::DecoderFactory {
+    alure::SharedPtr<alure::Decoder> createDecoder(alure::UniquePtr<std::istream> &file) noexcept override
+    {
+        char magic[sizeof(RampMagic)-1];
+        if(!file->read(magic, sizeof(magic)) || !std::equal(magic, magic+sizeof(magic), RampMagic))
+            return nullptr;
+
+        if(std::this_thread::get_id() == gMainThread)
+            ++gMainOpens;
+        else
+        {
+            ++gBackgroundOpens;
+            std::unique_lock<std::mutex> lock(gGateMutex);
+            gGateCond.wait(lock, []{ return gGateOpen; });
+        }
+        return alure::MakeShared<RampDecoder>();
+    }
+};
+
+class RampFileFactory final : public alure::FileIOFactory {
+    alure::UniquePtr<std::istream> openFile(const alure::String &name) noexcept override
+    {
+        if(name != RampName) return nullptr;
+        return alure::MakeUnique<std::istringstream>(RampMagic);
+    }
+};
+
+
+int gFailures{0};
+
+void Check(bool passed, const std::string &what)
+{
+    std::cout<< (passed ? "PASS: " : "FAIL: ")<<what <<std::endl;
+    if(!passed) ++gFailures;
+}
+
+// Waits for the background thread to start opening a decoder.
+bool WaitForBackgroundOpen(int count)
+{
+    auto end = std::chrono::steady_clock::now() + std::chrono::seconds(5);
+    while(gBackgroundOpens.load() < count)
+    {
+        if(std::chrono::steady_clock::now() > end)
+            return false;
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    return true;
+}
+
+// Plays the ramp from its name, returning the source's AL ID.
+ALuint PlayRamp(alure::Source source, ALsizei chunk_len, ALsizei queue_size)
+{
+    mockal::ResetCalls();
+    source.play(RampName, chunk_len, queue_size);
+    std::vector<mockal::Call> calls = mockal::GetCalls();
+    auto iter = std::find_if(calls.rbegin(), calls.rend(),
+        [](const mockal::Call &call) -> bool
+        { return call.mName == std::string("alSourcePlay"); }
+    );
+    return (iter != calls.rend()) ? static_cast<ALuint>(std::stoul(iter->mArgs)) : 0;
+}
+
+// Checks that the data holds the ramp's samples from the given position.
+bool IsRampAt(const std::vector<char> &data, uint64_t pos, size_t frames)
+{
+    if(data.size() != frames*sizeof(int16_t))
+        return false;
+    const int16_t *samples = reinterpret_cast<const int16_t*>(data.data());
+    for(size_t i = 0;i < frames;++i)
+    {
+        if(samples[i] != RampSample(pos+i))
+            return false;
+    }
+    return true;
+}
+
+
+void TestPreroll(alure::Context &ctx)
+{
+    constexpr ALsizei ChunkLen = 1024;
+    constexpr ALsizei QueueSize = 4;
+
+    // A 200ms preroll covers more than the whole queue.
+    ctx.precacheStreamPreroll(RampName, std::chrono::milliseconds(200));
+    int main_opens = gMainOpens.load();
+    int bg_opens = gBackgroundOpens.load();
+
+    SetGate(false);
+    alure::Source source = ctx.createSource();
+    ALuint srcid = PlayRamp(source, ChunkLen, QueueSize);
+
+    Check(gMainOpens.load() == main_opens, "preroll: play doesn't open the decoder itself");
+    Check(WaitForBackgroundOpen(bg_opens+1), "preroll: the background thread opens the decoder");
+
+    std::vector<unsigned int> queue = mockal::GetSourceQueue(srcid);
+    Check(queue.size() == QueueSize, "preroll: the queue is filled from the preroll");
+    Check(!queue.empty() && IsRampAt(mockal::GetBufferData(queue.front()), 0, ChunkLen),
+          "preroll: the first queued buffer holds the preroll's samples");
+    Check(source.isPlaying(), "preroll: the source is playing");
+
+    SetGate(true);
+    source.destroy();
+    ctx.removeStreamPreroll(RampName);
+}
+
+void TestHead(alure::Context &ctx)
+{
+    constexpr ALsizei ChunkLen = 1024;
+    constexpr ALsizei QueueSize = 4;
+    constexpr ALsizei HeadFrames = RampFrequency / 10;
+
+    // The head's buffer is the one given data while caching it.
+    mockal::ResetCalls();
+    ctx.precacheStreamHead(RampName, std::chrono::milliseconds(100));
+    ALuint headid = 0;
+    for(const mockal::Call &call : mockal::GetCalls())
+    {
+        if(call.mName == std::string("alBufferData"))
+            headid = static_cast<ALuint>(std::stoul(call.mArgs));
+    }
+    Check(IsRampAt(mockal::GetBufferData(headid), 0, HeadFrames),
+          "head: the head's buffer holds the start of the file");
+    int bg_opens = gBackgroundOpens.load();
+
+    SetGate(false);
+    alure::Source source = ctx.createSource();
+    ALuint srcid = PlayRamp(source, ChunkLen, QueueSize);
+    Check(WaitForBackgroundOpen(bg_opens+1), "head: the background thread opens the decoder");
+
+    std::vector<unsigned int> queue = mockal::GetSourceQueue(srcid);
+    Check(queue.size() == 1 && queue.front() == headid,
+          "head: only the head's buffer is queued until the decoder is opened");
+    Check(source.isPlaying(), "head: the source is playing");
+
+    // Once the decoder is opened, the stream continues after the head.
+    SetGate(true);
+    auto end = std::chrono::steady_clock::now() + std::chrono::seconds(5);
+    while(queue.size() < QueueSize && std::chrono::steady_clock::now() < end)
+    {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        ctx.update();
+        queue = mockal::GetSourceQueue(srcid);
+    }
+    Check(queue.size() == QueueSize && queue.front() == headid,
+          "head: the queue is filled from the decoder after the head");
+    Check(queue.size() > 1 && IsRampAt(mockal::GetBufferData(queue[1]), HeadFrames, ChunkLen),
+          "head: the decoder continues from the end of the head");
+
+    source.destroy();
+    ctx.removeStreamPreroll(RampName);
+}
+
+} // namespace
+
+int main()
+{
+    gMainThread = std::this_thread::get_id();
+    alure::FileIOFactory::set(alure::MakeUnique<RampFileFactory>());
+    alure::RegisterDecoder("alure-test-ramp", alure::MakeUnique<RampDecoderFactory>());
+
+    alure::DeviceManager devMgr = alure::DeviceManager::getInstance();
+    alure::Device dev = devMgr.openLoopback(alure::ChannelConfig::Stereo,
+                                            alure::SampleType::Float32, RampFrequency);
+    alure::Context ctx = dev.createContext();
+    alure::Context::MakeCurrent(ctx);
+
+    TestPreroll(ctx);
+    TestHead(ctx);
+
+    alure::Context::MakeCurrent(nullptr);
+    ctx.destroy();
+    dev.close();
+
+    alure::UnregisterDecoder("alure-test-ramp");
+    alure::FileIOFactory::set(nullptr);
+
+    if(gFailures > 0)
+        std::cerr<< gFailures<<" check(s) failed" <<std::endl;
+    return (gFailures > 0) ? 1 : 0;
+}
@@ -0,0 +1,122 @@
+/*
+ * A tool to build an alure pack file from a set of sound files. Files are
+ * stored as-is by default, or decoded to PCM with -decode so they can be
+ * loaded without decoding. Entries are named by the paths given on the
+ * command line.
+ */
+
+#include <string.h>
+
+#include <algorithm>
+#include <iostream>
+#include <fstream>
+#include <iterator>
+
+#include "alure2.h"
+
+int main(int argc, char *argv[])
+{
+    alure::ArrayView<const char*> args(argv, argc);
+
+    if(args.size() < 3)
+    {
+        std::cerr<< "Usage: "<<args.front()<<" [-decode] output.pak files..." <<std::endl;
+        return 1;
+    }
+    args = args.slice(1);
+
+    bool decode = false;
+    if(args[0] == alure::StringView("-decode"))
+    {
+        decode = true;
+        args = args.slice(1);
+    }
+    if(args.size() < 2)
+    {
+        std::cerr<< "No input files given" <<std::endl;
+        return 1;
+    }
+    alure::StringView packname = args.front();
+    args = args.slice(1);
+
+    // Decoding uses a context's decoders, which needs a device. A loopback
+    // device avoids needing audio hardware.
+    alure::DeviceManager devMgr = alure::DeviceManager::getInstance();
+    alure::Device dev;
+    alure::Context ctx;
+    if(decode)
+    {
+        dev = devMgr.openLoopback(alure::ChannelConfig::Stereo, alure::SampleType::Float32,
+                                  48000);
+        ctx = dev.createContext();
+        alure::Context::MakeCurrent(ctx);
+    }
+
+    alure::Vector<alure::PackFileEntry> entries;
+    int ret = 0;
+    for(;!args.empty();args = args.slice(1))
+    {
+        alure::PackFileEntry entry;
+        entry.mName = args.front();
+        if(decode)
+        {
+            try {
+                alure::SharedPtr<alure::Decoder> decoder = ctx.createDecoder(entry.mName);
+                entry.mCodec = alure::PackCodec::PCM;
+                entry.mChannels = decoder->getChannelConfig();
+                entry.mSampleType = decoder->getSampleType();
+                entry.mFrequency = decoder->getFrequency();
+                entry.mLoopPoints = decoder->getLoopPoints();
+
+                const ALuint framesize = alure::FramesToBytes(1, entry.mChannels,
+                                                              entry.mSampleType);
+                alure::Vector<ALbyte> chunk(framesize * 4096);
+                while(ALuint got = decoder->read(chunk.data(), 4096))
+                    entry.mData.insert(entry.mData.end(), chunk.begin(),
+                                       chunk.begin() + got*framesize);
+            }
+            catch(std::exception &e) {
+                std::cerr<< "Failed to decode "<<entry.mName<<": "<<e.what() <<std::endl;
+                ret = 1;
+                continue;
+            }
+        }
+        else
+        {
+            std::ifstream file(entry.mName.c_str(), std::ios::binary);
+            if(!file.is_open())
+            {
+                std::cerr<< "Failed to open "<<entry.mName <<std::endl;
+                ret = 1;
+                continue;
+            }
+            std::transform(std::istreambuf_iterator<char>(file),
+                std::istreambuf_iterator<char>(), std::back_inserter(entry.mData),
+                [](char ch) -> ALbyte { return static_cast<ALbyte>(ch); }
+            );
+        }
+
+        std::cout<< "Added "<<entry.mName<<" ("<<entry.mData.size()<<" bytes)" <<std::endl;
+        entries.push_back(std::move(entry));
+    }
+
+    if(ctx)
+    {
+        alure::Context::MakeCurrent(nullptr);
+        ctx.destroy();
+        dev.close();
+    }
+
+    if(ret != 0)
+        return ret;
+
+    try {
+        alure::WritePackFile(packname, entries);
+    }
+    catch(std::exception &e) {
+        std::cerr<< "Failed to write "<<packname<<": "<<e.what() <<std::endl;
+        return 1;
+    }
+    std::cout<< "Wrote "<<entries.size()<<" entries to "<<packname <<std::endl;
+    return 0;
+}